@@ -0,0 +1,213 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* libFuzzer harness for the rogg page parser */
+
+/* build with 'make fuzz', or by hand
+   clang -g -O1 -fsanitize=fuzzer,address -I. -o rogg_fuzz \
+	fuzz/rogg_fuzz.c rogg.c rogg_reader.c -lpthread
+   then run ./rogg_fuzz on a directory of sample files. Building with
+   -DROGG_FUZZ_MAIN and without -fsanitize=fuzzer instead gives a
+   program which replays the files named on its command line, for
+   checking a crash found elsewhere. */
+
+/* Each input is handed to the parser as an untrusted buffer of
+   exactly its own size, so the sanitizer catches any read past
+   either end. Besides not crashing, the scans have to agree with
+   each other: every page they return lies inside the buffer and
+   passes rogg_page_check, a walk accounts for every byte after the
+   first page exactly once, and the framer finds the same pages
+   whatever size the buffers it is fed are. The first input byte
+   picks those buffer sizes. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <rogg.h>
+
+#define FUZZ_PAGES_MAX 4096
+
+typedef struct {
+  const unsigned char *p;
+  long len;
+  long long pos;		/* where the walk should be next */
+  long long offsets[FUZZ_PAGES_MAX];
+  int count;
+} fuzz_state;
+
+#define fuzz_assert(x) do { if (!(x)) { \
+  fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+  abort(); } } while (0)
+
+/* a page the library handed back, which must be real */
+static void fuzz_page(fuzz_state *f, long long offset,
+	rogg_page_header *header)
+{
+  fuzz_assert(offset >= 0 && offset + header->length <= f->len);
+  fuzz_assert(header->length >= ROGG_OFFSET_LACING + header->segments);
+  fuzz_assert(rogg_page_check((unsigned char *)f->p + offset,
+	f->len - offset) == header->length);
+}
+
+static void walk_skip(void *data, long long offset, long long len)
+{
+  fuzz_state *f = data;
+
+  fuzz_assert(len > 0);
+  fuzz_assert(f->count == 0 ? offset == 0 : offset == f->pos);
+  f->pos = offset + len;
+}
+
+static void walk_page(void *data, long long offset, rogg_page_header *header)
+{
+  fuzz_state *f = data;
+
+  fuzz_page(f, offset, header);
+  fuzz_assert(f->count == 0 || offset == f->pos);
+  f->pos = offset + header->length;
+  f->count++;
+}
+
+static int framer_page(void *data, long long offset, rogg_page_header *header)
+{
+  fuzz_state *f = data;
+
+  fuzz_page(f, offset, header);
+  fuzz_assert(!memcmp(header->capture, f->p + offset, header->length));
+  if (f->count < FUZZ_PAGES_MAX) f->offsets[f->count] = offset;
+  f->count++;
+
+  return 0;
+}
+
+/* frame the whole buffer, fed in pieces of the given size */
+static void fuzz_framer(fuzz_state *f, unsigned char *p, long len, long step)
+{
+  rogg_framer framer;
+  long i, n;
+
+  f->count = 0;
+  if (rogg_framer_init(&framer, framer_page, f)) abort();
+  for (i = 0; i < len; i += n) {
+    n = (len - i < step) ? len - i : step;
+    rogg_framer_feed(&framer, p + i, n);
+  }
+  rogg_framer_finish(&framer);
+  fuzz_assert(framer.pages == f->count);
+  fuzz_assert(framer.offset == len);
+  rogg_framer_clear(&framer);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static fuzz_state whole, pieces;
+  rogg_page_header header;
+  rogg_hooks hooks;
+  unsigned char *p, *e, *q;
+  long len = size;
+  long long last;
+  int i, pages = 0;
+
+  /* a private copy, since the library takes writable buffers */
+  p = malloc(size ? size : 1);
+  if (p == NULL) return 0;
+  memcpy(p, data, size);
+  e = p + len;
+  whole.p = pieces.p = p;
+  whole.len = pieces.len = len;
+
+  /* forward scan, without crcs */
+  for (q = p; (q = rogg_page_next(q, e, &header)) != NULL;
+	q += header.length) {
+    fuzz_page(&whole, q - p, &header);
+    pages++;
+  }
+
+  /* the same walk, accounting for everything in between */
+  whole.count = 0;
+  whole.pos = 0;
+  memset(&hooks, 0, sizeof(hooks));
+  hooks.skip = walk_skip;
+  hooks.page = walk_page;
+  hooks.data = &whole;
+  for (q = p; (q = rogg_page_walk(p, q, e, &header, &hooks)) != NULL;
+	q += header.length);
+  fuzz_assert(whole.count == pages);
+  fuzz_assert(whole.pos == (pages ? len : 0));
+
+  /* backwards over the pages with good crcs */
+  last = len;
+  for (q = e; (q = rogg_page_find_back(p, q, e, &header)) != NULL; ) {
+    fuzz_page(&whole, q - p, &header);
+    fuzz_assert(q - p < last);
+    fuzz_assert(rogg_page_check_crc(q));
+    last = q - p;
+  }
+
+  /* the framer has to find the same pages however it's fed */
+  fuzz_framer(&whole, p, len, len ? len : 1);
+  fuzz_framer(&pieces, p, len, size ? 1 + data[0] % 64 * 97 : 1);
+  fuzz_assert(pieces.count == whole.count);
+  for (i = 0; i < whole.count && i < FUZZ_PAGES_MAX; i++)
+    fuzz_assert(pieces.offsets[i] == whole.offsets[i]);
+
+  free(p);
+  return 0;
+}
+
+#ifdef ROGG_FUZZ_MAIN
+int main(int argc, char *argv[])
+{
+  FILE *in;
+  unsigned char *data;
+  long size;
+  int i;
+
+  for (i = 1; i < argc; i++) {
+    in = fopen(argv[i], "rb");
+    if (in == NULL) {
+      fprintf(stderr, "couldn't open '%s'\n", argv[i]);
+      return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    size = ftell(in);
+    rewind(in);
+    data = malloc(size ? size : 1);
+    if (data == NULL || fread(data, 1, size, in) != (size_t)size) {
+      fprintf(stderr, "couldn't read '%s'\n", argv[i]);
+      return 1;
+    }
+    fclose(in);
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+  }
+
+  return 0;
+}
+#endif
@@ -30,9 +30,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "rogg.h"
 
+#ifdef ROGG_INSTRUMENT
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t rogg_ticks(void)
+{
+  return __rdtsc();
+}
+#else
+#include <time.h>
+static inline uint64_t rogg_ticks(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+static __thread rogg_counters rogg_counts;
+static rogg_counters rogg_counts_total;
+#define ROGG_COUNT(field, n) (rogg_counts.field += (n))
+#define ROGG_TIMER_START(t) uint64_t t = rogg_ticks()
+#define ROGG_TIMER_STOP(field, t) (rogg_counts.field += rogg_ticks() - (t))
+#else
+#define ROGG_COUNT(field, n) do {} while (0)
+#define ROGG_TIMER_START(t) do {} while (0)
+#define ROGG_TIMER_STOP(field, t) do {} while (0)
+#endif
+
 /* write out a little-endian 64 bit integer */
 void rogg_write_uint64(unsigned char *p, uint64_t v)
 {
@@ -82,7 +110,7 @@ void rogg_read_uint32(unsigned char *p, uint32_t *v)
   *v = (p[0]) |
        (p[1] << 8) |
        (p[2] << 16) |
-       (p[3] << 24);
+       ((uint32_t)p[3] << 24);
 }
 
 /* read a little-endian 16 bit integer */
@@ -112,21 +140,42 @@ void rogg_page_get_length(unsigned char *p, int *length)
 /* scan for the capture pattern */
 unsigned char *rogg_scan(unsigned char *p, long len)
 {
-  unsigned char *end = p + len - 4;
+  unsigned char *end, *start = p;
+  ROGG_TIMER_START(t);
 
-  while (p < end) {
+  if (len < 4) {
+    ROGG_TIMER_STOP(scan_ticks, t);
+    return NULL;
+  }
+  /* the last place a whole capture pattern fits */
+  end = p + len - 4;
+  while (p <= end) {
     if (*p == 'O') {
-      if ((p[1] == 'g') && (p[2] == 'g') && (p[3] == 'S')) return p;
+      if ((p[1] == 'g') && (p[2] == 'g') && (p[3] == 'S')) {
+        ROGG_COUNT(scan_bytes, p - start + 4);
+        if (p > start) {
+          ROGG_COUNT(garbage, p - start);
+          ROGG_COUNT(holes, 1);
+        }
+        ROGG_TIMER_STOP(scan_ticks, t);
+        return p;
+      }
     }
     p++;
   }
 
+  ROGG_COUNT(scan_bytes, len > 0 ? len : 0);
+  ROGG_COUNT(garbage, len > 0 ? len : 0);
+  ROGG_COUNT(holes, len > 0);
+  ROGG_TIMER_STOP(scan_ticks, t);
   return NULL;
 }
 
 /* parse out the header fields of the page starting at p */
 void rogg_page_parse(unsigned char *p, rogg_page_header *header)
 {
+  ROGG_TIMER_START(t);
+
   header->capture = p;
   header->version = p[ROGG_OFFSET_VERSION];
   header->flags = p[ROGG_OFFSET_FLAGS];
@@ -143,6 +192,116 @@ void rogg_page_parse(unsigned char *p, rogg_page_header *header)
   header->eos = (header->flags & 0x04) ? 1 : 0;
 
   rogg_page_get_length(p, &header->length);
+
+#ifdef ROGG_INSTRUMENT
+  {
+    int i;
+    for (i = 0; i < header->segments; i++) {
+      if (header->lacing[i] < 255) ROGG_COUNT(packets, 1);
+    }
+  }
+  ROGG_COUNT(pages, 1);
+#endif
+  ROGG_TIMER_STOP(parse_ticks, t);
+}
+
+/* Validation for untrusted input. Well formed pages take the fast
+   path: one compare for the capture pattern, one test covering the
+   version and reserved flag bits, and the lacing sum every parse
+   needs anyway. Only the bounds checks depend on how much data there
+   is, and they come after the header has been read from within it. */
+long rogg_page_check(unsigned char *p, long len)
+{
+  int i, segments;
+  long length;
+
+  if (len < ROGG_OFFSET_LACING) {
+    /* only say it's bad if what we have already is */
+    if (len > 0 && memcmp(p, "OggS", len < 4 ? len : 4)) return -1;
+    if (len > ROGG_OFFSET_FLAGS && (p[ROGG_OFFSET_VERSION] |
+	(p[ROGG_OFFSET_FLAGS] & ~0x07))) return -1;
+    return 0;
+  }
+  if (memcmp(p, "OggS", 4) ||
+	(p[ROGG_OFFSET_VERSION] | (p[ROGG_OFFSET_FLAGS] & ~0x07)))
+    return -1;
+  segments = p[ROGG_OFFSET_SEGMENTS];
+  if (len < ROGG_OFFSET_LACING + segments) return 0;
+  length = ROGG_OFFSET_LACING + segments;
+  for (i = 0; i < segments; i++) length += p[ROGG_OFFSET_LACING + i];
+
+  return length <= len ? length : 0;
+}
+
+long rogg_page_parse_checked(unsigned char *p, long len,
+	rogg_page_header *header)
+{
+  long length = rogg_page_check(p, len);
+
+  if (length > 0) rogg_page_parse(p, header);
+  return length;
+}
+
+/* find the next complete, well formed page at or after p */
+unsigned char *rogg_page_next(unsigned char *p, unsigned char *e,
+	rogg_page_header *header)
+{
+  while ((p = rogg_scan(p, e - p)) != NULL) {
+    if (rogg_page_parse_checked(p, e - p, header) > 0) return p;
+    /* not a real page, or cut off; keep looking */
+    p++;
+  }
+
+  return NULL;
+}
+
+unsigned char *rogg_page_walk(unsigned char *p, unsigned char *q,
+	unsigned char *e, rogg_page_header *header, const rogg_hooks *hooks)
+{
+  unsigned char *o = q < e ? rogg_page_next(q, e, header) : NULL;
+
+  if (hooks == NULL) return o;
+  if (o == NULL) {
+    /* a buffer without any pages isn't garbage, just not ogg */
+    if (q > p && q < e && hooks->skip) hooks->skip(hooks->data, q - p, e - q);
+    return NULL;
+  }
+  if (o > q && hooks->skip) hooks->skip(hooks->data, q - p, o - q);
+  if (hooks->page) hooks->page(hooks->data, o - p, header);
+
+  return o;
+}
+
+/* find the next complete page with a valid crc at or after p */
+unsigned char *rogg_page_find(unsigned char *p, unsigned char *e,
+	rogg_page_header *header)
+{
+  while ((p = rogg_page_next(p, e, header)) != NULL) {
+    if (rogg_page_check_crc(p)) return p;
+    p++;
+  }
+
+  return NULL;
+}
+
+/* find the last complete page with a valid crc starting at or after
+   p and before the given pointer, looking backwards */
+unsigned char *rogg_page_find_back(unsigned char *p, unsigned char *before,
+	unsigned char *e, rogg_page_header *header)
+{
+  unsigned char *q = before;
+
+  if (e - q < ROGG_OFFSET_LACING) q = e - ROGG_OFFSET_LACING;
+  while (q > p) {
+    q--;
+    if (*q != 'O' || q[1] != 'g' || q[2] != 'g' || q[3] != 'S') continue;
+    ROGG_COUNT(scan_bytes, before - q);
+    before = q;
+    if (rogg_page_parse_checked(q, e - q, header) > 0 &&
+	rogg_page_check_crc(q)) return q;
+  }
+
+  return NULL;
 }
 
 /* return number of packets starting on this page */
@@ -265,8 +424,10 @@ void rogg_page_update_crc(unsigned char *p)
   uint32_t crc = 0;
   unsigned char *q = p;
   int i, length;
+  ROGG_TIMER_START(t);
 
   rogg_page_get_length(p, &length);
+  ROGG_COUNT(crc_bytes, length);
 
   /* calculate the CRC with the CRC header element zeroed */
   p[ROGG_OFFSET_CRC + 0] = 0;
@@ -279,4 +440,199 @@ void rogg_page_update_crc(unsigned char *p)
   }
 
   rogg_write_uint32(p + ROGG_OFFSET_CRC, crc);
+  ROGG_TIMER_STOP(crc_ticks, t);
+}
+
+/* compute the crc of the page starting at p without modifying it */
+uint32_t rogg_page_crc(unsigned char *p)
+{
+  uint32_t crc = 0;
+  unsigned char *q = p;
+  int i, length;
+  ROGG_TIMER_START(t);
+
+  rogg_page_get_length(p, &length);
+  ROGG_COUNT(crc_bytes, length);
+
+  /* treat the CRC header element as zero */
+  for (i = 0; i < ROGG_OFFSET_CRC; i++) {
+    crc = (crc<<8)^rogg_crc_lookup[((crc >> 24)&0xFF)^(*q++)];
+  }
+  for (i = 0; i < 4; i++) {
+    crc = (crc<<8)^rogg_crc_lookup[((crc >> 24)&0xFF)];
+  }
+  q += 4;
+  for (i = ROGG_OFFSET_CRC + 4; i < length; i++) {
+    crc = (crc<<8)^rogg_crc_lookup[((crc >> 24)&0xFF)^(*q++)];
+  }
+
+  ROGG_TIMER_STOP(crc_ticks, t);
+  return crc;
+}
+
+/* continue a page crc over more data */
+uint32_t rogg_crc_update(uint32_t crc, const unsigned char *data, long len)
+{
+  long i;
+  ROGG_TIMER_START(t);
+
+  ROGG_COUNT(crc_bytes, len);
+  for (i = 0; i < len; i++) {
+    crc = (crc<<8)^rogg_crc_lookup[((crc >> 24)&0xFF)^data[i]];
+  }
+
+  ROGG_TIMER_STOP(crc_ticks, t);
+  return crc;
+}
+
+/* return nonzero if the crc stored on the page starting at p is correct */
+int rogg_page_check_crc(unsigned char *p)
+{
+  uint32_t crc;
+
+  rogg_read_uint32(p + ROGG_OFFSET_CRC, &crc);
+
+  return crc == rogg_page_crc(p);
+}
+
+/* x^(8*2^k) modulo the crc polynomial, for skipping over 2^k zero bytes */
+static const uint32_t rogg_crc_zeros[16]={
+  0x00000100,0x00010000,0x04c11db7,0x490d678d,
+  0xe8a45605,0x75be46b7,0xe6228b11,0x567fddeb,
+  0x88fe2237,0x0e857e71,0x7001e426,0x075de2b2,
+  0xf12a7f90,0xf0b4a1c1,0x58f46c0c,0xc3395ade};
+
+/* multiply two polynomials modulo the crc polynomial */
+static uint32_t rogg_crc_multiply(uint32_t a, uint32_t b)
+{
+  uint32_t m = 0;
+  int i;
+
+  for (i = 31; i >= 0; i--) {
+    m = (m << 1) ^ ((m & 0x80000000) ? 0x04c11db7 : 0);
+    if (a & ((uint32_t)1 << i)) m ^= b;
+  }
+  return m;
+}
+
+/* return nonzero if len bytes at offset can be patched: the crc
+   itself and the lacing values, which give the length, can't be */
+static int rogg_page_patchable(unsigned char *p, int offset, int len)
+{
+  int length;
+
+  rogg_page_get_length(p, &length);
+  return offset >= 0 && len >= 0 && offset + len <= length &&
+	!(offset < ROGG_OFFSET_CRC + 4 && offset + len > ROGG_OFFSET_CRC) &&
+	!(offset < ROGG_OFFSET_LACING + p[ROGG_OFFSET_SEGMENTS] &&
+	  offset + len > ROGG_OFFSET_SEGMENTS);
+}
+
+/* The page crc has no initial value or final xor, so it is linear:
+   the crc of a patched page is the old crc xor the crc of a page of
+   zeros holding just the changed bits. That is the crc of the xor of
+   the old and new bytes, pushed through the zeros which follow them. */
+int rogg_page_patch_crc(unsigned char *p, int offset,
+	const unsigned char *old, const unsigned char *new, int len)
+{
+  uint32_t crc, delta = 0;
+  int i, length, zeros;
+  ROGG_TIMER_START(t);
+
+  if (!rogg_page_patchable(p, offset, len)) return -1;
+  rogg_page_get_length(p, &length);
+  ROGG_COUNT(crc_bytes, len);
+
+  if (old == NULL) old = p + offset;
+  for (i = 0; i < len; i++) {
+    delta = (delta<<8)^rogg_crc_lookup[((delta >> 24)&0xFF)^(old[i]^new[i])];
+  }
+  for (i = 0, zeros = length - offset - len; zeros; i++, zeros >>= 1) {
+    if (zeros & 1) delta = rogg_crc_multiply(delta, rogg_crc_zeros[i]);
+  }
+
+  memmove(p + offset, new, len);
+  rogg_read_uint32(p + ROGG_OFFSET_CRC, &crc);
+  rogg_write_uint32(p + ROGG_OFFSET_CRC, crc ^ delta);
+  ROGG_TIMER_STOP(crc_ticks, t);
+  return 0;
+}
+
+/* as rogg_page_patch_crc, but refuse to patch a page whose crc is wrong */
+int rogg_page_patch_crc_checked(unsigned char *p, int offset,
+	const unsigned char *old, const unsigned char *new, int len)
+{
+  if (!rogg_page_patchable(p, offset, len) || !rogg_page_check_crc(p))
+    return -1;
+  if (old != NULL && memcmp(p + offset, old, len)) return -1;
+  return rogg_page_patch_crc(p, offset, NULL, new, len);
+}
+
+int rogg_counters_snapshot(rogg_counters *counters)
+{
+#ifdef ROGG_INSTRUMENT
+  *counters = rogg_counts;
+  return 0;
+#else
+  memset(counters, 0, sizeof(*counters));
+  return -1;
+#endif
+}
+
+void rogg_counters_reset(void)
+{
+#ifdef ROGG_INSTRUMENT
+  memset(&rogg_counts, 0, sizeof(rogg_counts));
+#endif
+}
+
+void rogg_counters_merge(void)
+{
+#ifdef ROGG_INSTRUMENT
+  uint64_t *total = (uint64_t *)&rogg_counts_total;
+  uint64_t *mine = (uint64_t *)&rogg_counts;
+  size_t i;
+
+  for (i = 0; i < sizeof(rogg_counts)/sizeof(*mine); i++) {
+    __atomic_fetch_add(&total[i], mine[i], __ATOMIC_RELAXED);
+  }
+  rogg_counters_reset();
+#endif
+}
+
+int rogg_counters_total(rogg_counters *counters)
+{
+#ifdef ROGG_INSTRUMENT
+  uint64_t *total = (uint64_t *)&rogg_counts_total;
+  uint64_t *copy = (uint64_t *)counters;
+  size_t i;
+
+  for (i = 0; i < sizeof(*counters)/sizeof(*copy); i++) {
+    copy[i] = __atomic_load_n(&total[i], __ATOMIC_RELAXED);
+  }
+  return 0;
+#else
+  memset(counters, 0, sizeof(*counters));
+  return -1;
+#endif
+}
+
+void rogg_counters_report(FILE *out)
+{
+  rogg_counters c;
+
+  rogg_counters_merge();
+  if (rogg_counters_total(&c)) {
+    fprintf(out, "rogg counters: not compiled in (build with INSTRUMENT=1)\n");
+    return;
+  }
+  fprintf(out, "rogg counters: %llu pages, %llu packets, %llu crc bytes\n",
+	(unsigned long long)c.pages, (unsigned long long)c.packets,
+	(unsigned long long)c.crc_bytes);
+  fprintf(out, "  scan: %llu bytes examined, %llu garbage bytes in %llu holes\n",
+	(unsigned long long)c.scan_bytes, (unsigned long long)c.garbage,
+	(unsigned long long)c.holes);
+  fprintf(out, "  ticks: scan %llu, parse %llu, crc %llu\n",
+	(unsigned long long)c.scan_ticks, (unsigned long long)c.parse_ticks,
+	(unsigned long long)c.crc_ticks);
 }
@@ -30,6 +30,7 @@
 #ifndef _ROGG_H_
 #define _ROGG_H_
 
+#include <stdio.h>
 #include <stdint.h>
 
 /* parsed header struct */
@@ -63,12 +64,17 @@ struct _rogg_page_header {
 #define ROGG_OFFSET_SEGMENTS 26
 #define ROGG_OFFSET_LACING 27
 
+/* largest possible page: full header, 255 segments of 255 bytes */
+#define ROGG_PAGE_MAX (ROGG_OFFSET_LACING + 255 + 255*255)
+
 /* parsed packet struct */
 typedef struct _rogg_packet rogg_packet;
 struct _rogg_packet {
   unsigned char **data;	/* array of pointers to body data sections */
   /* framing data derived from the page header(s) */
   unsigned int *lengths;	/* array of data section lengths */
+  int sections;			/* number of data sections */
+  long length;			/* total packet length */
   uint64_t granulepos;		/* timestamp, -1 if unknown */
   int bos, eos;			/* beginning and end flags */
 };
@@ -90,6 +96,46 @@ void rogg_page_get_length(unsigned char *p, int *length);
 /* parse out the header fields of the page starting at p */
 void rogg_page_parse(unsigned char *p, rogg_page_header *header);
 
+/* check the page at p against the len bytes available, for input
+   which can't be trusted: returns the page length if a whole page with
+   version 0 and no reserved flags is there, 0 if it's cut off, or -1
+   if the header is invalid. Doesn't check the crc. */
+long rogg_page_check(unsigned char *p, long len);
+
+/* rogg_page_check, then rogg_page_parse if the page is whole */
+long rogg_page_parse_checked(unsigned char *p, long len,
+	rogg_page_header *header);
+
+/* find the next complete, well formed page at or after p and before
+   e, without checking its crc */
+unsigned char *rogg_page_next(unsigned char *p, unsigned char *e,
+	rogg_page_header *header);
+
+/* find the next complete page with a valid crc at or after p */
+unsigned char *rogg_page_find(unsigned char *p, unsigned char *e,
+	rogg_page_header *header);
+
+/* find the last complete page with a valid crc starting in [p, before)
+   and ending by e, scanning backwards */
+unsigned char *rogg_page_find_back(unsigned char *p, unsigned char *before,
+	unsigned char *e, rogg_page_header *header);
+
+/* callbacks from a walk over a buffer, any of which may be NULL */
+typedef struct _rogg_hooks rogg_hooks;
+struct _rogg_hooks {
+  /* bytes which aren't part of a page, at offset 0 for leading garbage
+     and running to the end of the buffer for trailing garbage */
+  void (*skip)(void *data, long long offset, long long len);
+  /* a page about to be looked at, before anything on it changes */
+  void (*page)(void *data, long long offset, rogg_page_header *header);
+  void *data;
+};
+
+/* the next well formed page at or after q in the buffer [p, e), as
+   rogg_page_next, passing what's skipped and the page to hooks */
+unsigned char *rogg_page_walk(unsigned char *p, unsigned char *q,
+	unsigned char *e, rogg_page_header *header, const rogg_hooks *hooks);
+
 /* return number of packets starting on this page */
 int rogg_page_packets_starting(rogg_page_header *header);
 
@@ -102,4 +148,737 @@ int rogg_page_packets_full(rogg_page_header *header);
 /* recompute and store a new crc on the page starting at p */
 void rogg_page_update_crc(unsigned char *p);
 
+/* compute the crc of the page starting at p without modifying it */
+uint32_t rogg_page_crc(unsigned char *p);
+
+/* return nonzero if the crc stored on the page starting at p is correct */
+int rogg_page_check_crc(unsigned char *p);
+
+/* replace len bytes at offset in the page starting at p by new, and
+   update the crc for the change without rereading the page. old holds
+   the bytes being replaced, or NULL to use those on the page. The
+   stored crc is trusted, so a page which was bad stays bad. Returns
+   -1 if the range isn't inside the page, or overlaps the crc or the
+   segment table. */
+int rogg_page_patch_crc(unsigned char *p, int offset,
+	const unsigned char *old, const unsigned char *new, int len);
+
+/* as rogg_page_patch_crc, but first check the stored crc and that old
+   matches the page, returning -1 without changing anything if not */
+int rogg_page_patch_crc_checked(unsigned char *p, int offset,
+	const unsigned char *old, const unsigned char *new, int len);
+
+/* correct up to max_bits (1 or 2) flipped bits in the page starting
+   at p, which must have been found with its true length. Returns the
+   number of bits corrected, storing their positions as byte * 8 + bit
+   in positions if it isn't NULL, 0 if the crc was already right, or
+   -1 if no unique correction was found. */
+int rogg_page_repair(unsigned char *p, int max_bits, long *positions);
+
+/* continue a page crc over more data, starting from 0 */
+uint32_t rogg_crc_update(uint32_t crc, const unsigned char *data, long len);
+
+/* hot path counters, only maintained when built with ROGG_INSTRUMENT.
+   Each thread counts into its own copy; times are in cpu timestamp
+   ticks where available, nanoseconds otherwise. */
+typedef struct _rogg_counters rogg_counters;
+struct _rogg_counters {
+  uint64_t pages;		/* pages parsed */
+  uint64_t packets;		/* packets completed on parsed pages */
+  uint64_t scan_bytes;		/* bytes examined looking for a capture */
+  uint64_t garbage;		/* bytes skipped between pages */
+  uint64_t holes;		/* scans which had to skip bytes */
+  uint64_t crc_bytes;		/* bytes run through the crc */
+  uint64_t scan_ticks;		/* time spent in rogg_scan */
+  uint64_t parse_ticks;		/* time spent in rogg_page_parse */
+  uint64_t crc_ticks;		/* time spent computing crcs */
+};
+
+/* copy the calling thread's counters; returns nonzero if
+   instrumentation isn't compiled in */
+int rogg_counters_snapshot(rogg_counters *counters);
+
+/* zero the calling thread's counters */
+void rogg_counters_reset(void);
+
+/* move the calling thread's counters into the process total,
+   for threads which are about to exit */
+void rogg_counters_merge(void);
+
+/* copy the process total of all merged counters */
+int rogg_counters_total(rogg_counters *counters);
+
+/* merge the calling thread and print the process total */
+void rogg_counters_report(FILE *out);
+
+/* codec identification and granulepos mapping */
+#define ROGG_CODEC_UNKNOWN 0
+#define ROGG_CODEC_VORBIS 1
+#define ROGG_CODEC_OPUS 2
+#define ROGG_CODEC_THEORA 3
+#define ROGG_CODEC_KATE 4
+#define ROGG_CODEC_SPEEX 5
+#define ROGG_CODEC_FLAC 6
+#define ROGG_CODEC_SKELETON 7
+
+typedef struct _rogg_codec rogg_codec;
+typedef struct _rogg_stream_info rogg_stream_info;
+
+/* what we know about a logical stream from its bos page */
+struct _rogg_stream_info {
+  const rogg_codec *codec;	/* NULL if not recognized */
+  uint32_t serialno;
+  /* time = (frames - preskip) * rate_den / rate_num */
+  int64_t rate_num, rate_den;
+  int64_t preskip;		/* granules to drop from the start */
+  int shift;			/* keyframe granule shift, or 0 */
+  int frame_base;		/* add one to frame counts (old theora) */
+  int headers;			/* header packets, -1 if unknown */
+};
+
+/* codec descriptor; register additional ones with rogg_codec_register */
+struct _rogg_codec {
+  int id;			/* ROGG_CODEC_* or an application value */
+  const char *name;
+  const char *magic;		/* start of the identification packet */
+  int magic_len;
+  int min_len;			/* shortest valid identification packet */
+  /* fill in info from the identification packet, return < 0 if invalid */
+  int (*parse)(rogg_stream_info *info, unsigned char *data, int len);
+  /* granulepos of the keyframe a granulepos depends on, or NULL if
+     every packet can be decoded on its own */
+  int64_t (*keyframe)(rogg_stream_info *info, int64_t granulepos);
+  /* whether a data packet is a keyframe, NULL if it can't be told */
+  int (*packet_keyframe)(unsigned char *data, int len);
+};
+
+/* add a codec, matched before the built in ones so it can replace
+   them; ids aren't checked, so a duplicate id is simply registered
+   too. Returns 0, or -1 once 8 codecs have been added. The descriptor
+   must outlive every use. */
+int rogg_codec_register(const rogg_codec *codec);
+
+/* the codec whose identification packet starts with data, or NULL */
+const rogg_codec *rogg_codec_identify(unsigned char *data, int len);
+
+/* the codec's name, or "unknown" for NULL */
+const char *rogg_codec_name(const rogg_codec *codec);
+
+/* fill in info from a bos page, returning the codec id, or -1 with
+   info->codec NULL if the page isn't a bos page starting a packet,
+   or the codec is unknown or its identification packet is invalid */
+int rogg_stream_info_init(rogg_stream_info *info, rogg_page_header *header);
+
+/* the frame count at granulepos less the preskip, at least 0, or -1
+   for a negative granulepos */
+int64_t rogg_stream_frames(rogg_stream_info *info, int64_t granulepos);
+
+/* seconds at the end of granulepos, or -1 without a rate or for a
+   negative granulepos */
+double rogg_stream_time(rogg_stream_info *info, int64_t granulepos);
+
+/* granulepos of the keyframe granulepos depends on; granulepos itself
+   for codecs without keyframes, or -1 if it's negative */
+int64_t rogg_stream_keyframe(rogg_stream_info *info, int64_t granulepos);
+
+/* region allocator for state that lives as long as one file. Nothing
+   is freed piecemeal; a reset makes everything available again while
+   keeping the blocks, so steady state processing doesn't touch the
+   heap. An arena isn't safe to share between threads. */
+#define ROGG_ARENA_BLOCK 65536
+
+struct _rogg_arena_block;
+
+typedef struct _rogg_arena rogg_arena;
+struct _rogg_arena {
+  struct _rogg_arena_block *blocks;	/* every block, in order of use */
+  struct _rogg_arena_block *current;	/* the block being carved */
+  size_t used;			/* bytes taken from the current block */
+  size_t block;			/* size of new blocks */
+  size_t allocated;		/* total held in blocks */
+  void *last;			/* most recent allocation, for grow */
+};
+
+/* set up an empty arena growing by block bytes, 0 for the default */
+void rogg_arena_init(rogg_arena *arena, size_t block);
+
+/* size bytes aligned for any type, NULL if out of memory */
+void *rogg_arena_alloc(rogg_arena *arena, size_t size);
+
+/* count zeroed elements of size bytes */
+void *rogg_arena_calloc(rogg_arena *arena, size_t count, size_t size);
+
+/* resize old to size bytes, extending it in place if it was the last
+   allocation, otherwise copying; old space is reclaimed on reset */
+void *rogg_arena_grow(rogg_arena *arena, void *old, size_t old_size,
+	size_t size);
+
+/* forget every allocation, keeping the memory for reuse */
+void rogg_arena_reset(rogg_arena *arena);
+
+/* release all the memory held by the arena */
+void rogg_arena_clear(rogg_arena *arena);
+
+/* gather the packet's sections into out, which must hold
+   packet->length bytes; returns that length */
+long rogg_packet_copy(rogg_packet *packet, unsigned char *out);
+
+/* free lists allocated on the heap and zero the packet; not for
+   packets whose lists came from an arena */
+void rogg_packet_clear(rogg_packet *packet);
+
+/* the header packets of a logical stream, read in place */
+typedef struct _rogg_headers rogg_headers;
+struct _rogg_headers {
+  uint32_t serialno;
+  int count;			/* number of header packets */
+  rogg_packet *packets;		/* scatter lists into the mapped file */
+  long long start, end;		/* bos page to the end of the last header page */
+  long long *offsets;		/* the stream's pages in that region */
+  int pages;
+  int shared;			/* last header page also starts data packets */
+  rogg_arena *arena;		/* holding the lists, NULL for the heap */
+};
+
+/* find the first count packets of the stream starting at its bos
+   page, with lists on the heap. Returns 0, or -1 with the headers
+   cleared if the stream has no bos page, ends or is broken before
+   count packets, or memory runs out. */
+int rogg_headers_read(rogg_headers *headers, unsigned char *p, long len,
+	uint32_t serialno, int count);
+
+/* as rogg_headers_read, taking the lists from an arena; clearing the
+   headers then leaves the memory to the arena's next reset */
+int rogg_headers_read_arena(rogg_headers *headers, rogg_arena *arena,
+	unsigned char *p, long len, uint32_t serialno, int count);
+
+/* free the lists of headers read from the heap, and zero the struct */
+void rogg_headers_clear(rogg_headers *headers);
+
+/* replace the header packets read from the writable mapping p of len
+   bytes with data[i] of lengths[i], for every one of headers->count.
+   When every length is unchanged the bytes are copied back through
+   the scatter lists and the crcs updated in p; path and fd aren't
+   used, and 0 is returned. Otherwise the header pages are rebuilt,
+   which needs fd open for writing on the file at path, and isn't
+   possible when data packets share the last header page:
+   - 0 if the new pages take the same space, written through p
+   - 1 if the file changed size, by shifting its tail with fallocate
+     or by writing a new file which is renamed over path, renumbering
+     the stream's later pages if the page count changed. p then no
+     longer matches the file and must be unmapped and remapped.
+   - -1 if it couldn't be done. The file is unchanged unless a write
+     failed after fallocate had already shifted its tail. */
+int rogg_headers_write(rogg_headers *headers, const char *path, int fd,
+	unsigned char *p, long len, unsigned char **data, long *lengths);
+
+/* a parsed comment header, tags point into the packet or caller data */
+typedef struct _rogg_comments rogg_comments;
+struct _rogg_comments {
+  int codec;			/* ROGG_CODEC_* the packet belongs to */
+  unsigned char *vendor;
+  uint32_t vendor_len;
+  uint32_t count;		/* number of KEY=value tags */
+  uint32_t room;		/* allocated tag slots */
+  unsigned char **entries;
+  uint32_t *lengths;
+  unsigned char *extra;		/* opus binary data to carry over */
+  long extra_len;
+  int last;			/* flac last metadata block flag */
+};
+
+/* nonzero if the codec's comment header can be parsed */
+int rogg_comments_supported(int codec);
+
+/* parse the comment packet data of len bytes, which must stay valid
+   while c is used. Returns 0, or -1 if the packet is malformed or
+   memory runs out; clear c either way. */
+int rogg_comments_parse(rogg_comments *c, int codec,
+	unsigned char *data, long len);
+
+/* free the tag lists, not the tags, and zero c */
+void rogg_comments_clear(rogg_comments *c);
+
+/* nonzero if the tag entry of len bytes has the key, up to any '=' in
+   key, compared without case */
+int rogg_comments_match(unsigned char *entry, uint32_t len, const char *key);
+
+/* drop every tag with the key, returning how many went. Only the
+   pointers are removed; the tag data belongs to whoever supplied it. */
+int rogg_comments_delete(rogg_comments *c, const char *key);
+
+/* append a KEY=value tag of len bytes. The tag isn't copied, so it
+   must stay valid until c is written or cleared, and stays the
+   caller's to free. Returns 0, or -1 if memory runs out. */
+int rogg_comments_add(rogg_comments *c, unsigned char *tag, uint32_t len);
+
+/* bytes needed to write the packet out as it stands */
+long rogg_comments_size(rogg_comments *c);
+
+/* write the packet into out of len bytes, at least rogg_comments_size;
+   anything beyond that is zero padding, covered by the block length
+   for flac */
+void rogg_comments_write(rogg_comments *c, unsigned char *out, long len);
+
+/* find where to start decoding the stream described by info to show
+   the frame at t seconds. Returns the offset in p of the page the
+   packet to decode first starts on, or -1 if the stream's codec,
+   header count or rate is unknown, t is negative, or the pages aren't
+   there. A t past the end gives the last keyframe of the stream.
+   *keyframe, if not NULL, gets the granulepos of that keyframe; for
+   codecs without keyframes it gets -1 and the page is the last one
+   finishing a packet before t. If packets can't be told apart as
+   keyframes, the page is the one before the keyframe's, where
+   decoding must begin and skip ahead to it. */
+long long rogg_seek_keyframe(unsigned char *p, long len,
+	rogg_stream_info *info, double t, int64_t *keyframe);
+
+/* packet index of every logical stream in a buffer, built in one pass
+   over the pages with a valid crc. Positions are stored in blocks of
+   ROGG_INDEX_BLOCK entries as deltas from a base per block, so finding
+   any page or packet takes constant time. */
+#define ROGG_INDEX_BLOCK 64
+
+typedef struct _rogg_index_entry rogg_index_entry;
+struct _rogg_index_entry {
+  uint32_t page;		/* first page, from the block's base page */
+  uint16_t span;		/* number of pages the packet is on */
+  uint8_t segment;		/* first lacing value on that page */
+};
+
+typedef struct _rogg_index_stream rogg_index_stream;
+struct _rogg_index_stream {
+  uint32_t serialno;
+  long pages;
+  long long *page_base;		/* offset of each block's first page */
+  uint32_t *page_delta;		/* page offsets from their block's base */
+  long packets;			/* complete packets indexed */
+  long *packet_base;		/* first page of each block's first packet */
+  rogg_index_entry *entries;
+};
+
+typedef struct _rogg_index rogg_index;
+struct _rogg_index {
+  rogg_index_stream *streams;	/* in order of appearance */
+  int count;
+};
+
+/* index the buffer with lists from the arena; returns 0, ROGG_NO_PAGES
+   (see the whole file operations below) without any pages, or -1 when
+   out of memory, or for a packet over 65535 pages or 64 pages of a
+   stream spread over more than 4GB */
+int rogg_index_build(rogg_index *index, rogg_arena *arena,
+	unsigned char *p, long len);
+
+rogg_index_stream *rogg_index_find(rogg_index *index, uint32_t serialno);
+
+/* offset of page n of the stream, -1 if out of range */
+long long rogg_index_page(rogg_index_stream *s, long n);
+
+/* scatter list for packet n of the stream, pointing into the indexed
+   buffer p, with lists from the arena or the heap when it's NULL as
+   for rogg_headers_read_arena. Returns -1 if n is out of range. */
+int rogg_index_packet(rogg_index_stream *s, unsigned char *p, long n,
+	rogg_arena *arena, rogg_packet *packet);
+
+/* print the usual one line summary of a page header */
+void rogg_page_print(FILE *out, rogg_page_header *header);
+
+/* per-page record output in a choice of formats */
+#define ROGG_OUTPUT_TEXT 0
+#define ROGG_OUTPUT_JSON 1	/* one object per line */
+#define ROGG_OUTPUT_CSV 2	/* with a header row */
+#define ROGG_OUTPUT_BINARY 3	/* fixed size little endian records */
+
+/* binary records are ROGG_OUTPUT_RECORD bytes:
+   0 file index, 4 serialno, 8 sequenceno, 12 page length (32 bit)
+   16 file offset, 24 granulepos (64 bit)
+   32 flags, 33 segments, 34 reserved (8 bit), 36 crc (32 bit) */
+#define ROGG_OUTPUT_RECORD 40
+
+typedef struct _rogg_output rogg_output;
+struct _rogg_output {
+  FILE *fp;
+  int format;
+  int file_index;		/* count of rogg_output_begin calls, from 0 */
+  long rows;			/* records written */
+  char *name;			/* current file name, quoted for the format */
+  int name_len;
+  char *line;			/* record formatting buffer */
+};
+
+/* look up a format by name, returns -1 if unknown */
+int rogg_output_format(const char *name);
+
+/* set up to write records to fp */
+void rogg_output_init(rogg_output *out, FILE *fp, int format);
+
+/* start records for a new input file, returns nonzero on failure */
+int rogg_output_begin(rogg_output *out, const char *file);
+
+/* write a record for the page found at offset */
+void rogg_output_page(rogg_output *out, long long offset,
+	rogg_page_header *header);
+
+/* note bytes skipped looking for a page; only json records these */
+void rogg_output_skip(rogg_output *out, long long offset, long long bytes);
+
+/* flush and release the output buffers */
+void rogg_output_finish(rogg_output *out);
+
+/* streaming page framer: finds pages in a sequence of buffers,
+   carrying partial pages over from one buffer to the next */
+typedef struct _rogg_framer rogg_framer;
+typedef int (*rogg_page_callback)(void *data, long long offset,
+	rogg_page_header *header);
+struct _rogg_framer {
+  unsigned char *carry;		/* partial page from the last buffer */
+  int fill;			/* bytes held in carry */
+  long long offset;		/* stream offset of carry[0] */
+  long long pages;		/* pages passed to the callback */
+  long long garbage;		/* bytes skipped between pages */
+  int holes;			/* number of times we lost sync */
+  rogg_page_callback page;	/* called for each complete page */
+  void *data;			/* passed through to the callback */
+};
+
+/* set up a framer, returns nonzero on allocation failure */
+int rogg_framer_init(rogg_framer *framer, rogg_page_callback page, void *data);
+
+/* feed the next buffer of the stream, returns nonzero if
+   the callback asked us to stop */
+int rogg_framer_feed(rogg_framer *framer, unsigned char *buf, long len);
+
+/* account for any trailing partial page at the end of the stream */
+void rogg_framer_finish(rogg_framer *framer);
+
+/* release the framer's carry buffer */
+void rogg_framer_clear(rogg_framer *framer);
+
+/* batch file reader, feeding pages from many files to callbacks
+   while keeping a number of reads in flight */
+#define ROGG_READER_AUTO 0
+#define ROGG_READER_URING 1
+#define ROGG_READER_THREADS 2
+
+typedef struct _rogg_reader rogg_reader;
+struct _rogg_reader {
+  int backend;			/* one of the ROGG_READER_* values */
+  int depth;			/* reads in flight, and the buffer pool size */
+  long chunk;			/* size of each read */
+  /* called for each page; calls for the same file are serialized
+     and in order, but different files may run concurrently */
+  int (*page)(void *data, int file, long long offset,
+	rogg_page_header *header);
+  /* called once per file after its last page, error is an errno value */
+  void (*done)(void *data, int file, rogg_framer *framer, int error);
+  void *data;
+};
+
+/* fill in default reader settings */
+void rogg_reader_init(rogg_reader *reader);
+
+/* read all the named files, returns the backend used or -1 if none
+   could run or io_uring failed part way, in which case every file not
+   finished yet has been passed to done with the error */
+int rogg_reader_run(rogg_reader *reader, int count, char **names);
+
+/* page writer, queueing rewritten headers and references to the
+   original page bodies and writing them out in batches */
+#define ROGG_WRITER_PAGES 64
+#define ROGG_WRITER_HEADER (ROGG_OFFSET_LACING + 255)
+
+typedef struct _rogg_writer rogg_writer;
+struct _rogg_writer {
+  int fd;
+  long long offset;		/* bytes written, including queued ones */
+  int count;			/* queued pieces */
+  int pages;			/* queued rewritten headers */
+  unsigned char *base[2*ROGG_WRITER_PAGES];
+  long len[2*ROGG_WRITER_PAGES];
+  unsigned char headers[ROGG_WRITER_PAGES][ROGG_WRITER_HEADER];
+};
+
+/* set up to write to fd at its current position */
+void rogg_writer_init(rogg_writer *w, int fd);
+
+/* queue a page whose flags, granulepos, serialno and sequenceno are
+   taken from header, with the lacing and body it points to. The body
+   is referenced, not copied, until the next flush. */
+int rogg_writer_page(rogg_writer *w, rogg_page_header *header);
+
+/* queue len bytes to be written as they are, by reference */
+int rogg_writer_data(rogg_writer *w, unsigned char *data, long len);
+
+/* queue a packet on pages of its own, flags applying to the first
+   (bos) and last (eos) of them, the last one carrying granulepos. The
+   data is referenced until the next flush, sequenceno is advanced. */
+int rogg_writer_packet(rogg_writer *w, unsigned char *data, long len,
+	int flags, int64_t granulepos, uint32_t serialno, uint32_t *sequenceno);
+
+/* write len bytes at offset in fd, mapped at p, after what's queued */
+int rogg_writer_copy(rogg_writer *w, int fd, unsigned char *p,
+	long long offset, long long len);
+
+/* write out everything queued, returns nonzero on failure */
+int rogg_writer_flush(rogg_writer *w);
+
+/* Whole file operations behind the utilities, for running in process.
+   Each works on a mapped buffer with an options struct, keeps no state
+   between calls and reports through a result struct whose lists come
+   from the caller's arena. Calls on different buffers may run in
+   parallel. Those which rewrite pages do so in place. Unless noted,
+   they return 0, ROGG_NO_PAGES if the buffer has no pages, or -1 if
+   memory runs out; the header edits find nothing to do in a buffer
+   without pages. */
+#define ROGG_NO_PAGES -2
+
+/* end of stream flags: set the eos flag on the last page of every
+   stream which lacks it, or strip eos flags from every page */
+typedef struct _rogg_eos_options rogg_eos_options;
+struct _rogg_eos_options {
+  int tail_first;		/* look for the last pages from the end */
+  int strip;			/* clear eos flags instead of setting them */
+  rogg_hooks hooks;		/* not called for a tail first search */
+};
+
+typedef struct _rogg_eos_stream rogg_eos_stream;
+struct _rogg_eos_stream {
+  uint32_t serialno;
+  long long last;		/* offset of the stream's last page */
+  long changed;			/* pages whose eos flag was changed */
+};
+
+typedef struct _rogg_eos_result rogg_eos_result;
+struct _rogg_eos_result {
+  rogg_eos_stream *streams;	/* in order of appearance */
+  int count;
+  long long tail;		/* bytes searched from the end, -1 if the
+				   whole buffer was walked */
+};
+
+/* returns 0, or -1 if there are no pages or memory runs out */
+int rogg_eos_fix(unsigned char *p, long len, const rogg_eos_options *opts,
+	rogg_arena *arena, rogg_eos_result *result);
+
+/* serial number changes */
+#define ROGG_SERIAL_MAP 0	/* the pairs given */
+#define ROGG_SERIAL_RANDOM 1	/* random serials for every stream */
+#define ROGG_SERIAL_SEQUENTIAL 2	/* every stream in order from first */
+
+typedef struct _rogg_serial_pair rogg_serial_pair;
+struct _rogg_serial_pair {
+  uint32_t old_serial;
+  uint32_t new_serial;
+};
+
+typedef struct _rogg_serial_options rogg_serial_options;
+struct _rogg_serial_options {
+  int mode;			/* ROGG_SERIAL_* */
+  const rogg_serial_pair *pairs;	/* for ROGG_SERIAL_MAP */
+  int count;
+  uint32_t first;		/* for ROGG_SERIAL_SEQUENTIAL */
+  uint64_t seed;		/* for ROGG_SERIAL_RANDOM */
+  int threads;			/* to split the buffer between, at least 1 */
+};
+
+typedef struct _rogg_serial_result rogg_serial_result;
+struct _rogg_serial_result {
+  long pages, changed;
+  long long garbage;		/* bytes outside pages */
+  rogg_serial_pair *assigned;	/* serials picked by the other modes */
+  int count;
+};
+
+int rogg_serial_remap(unsigned char *p, long len,
+	const rogg_serial_options *opts, rogg_arena *arena,
+	rogg_serial_result *result);
+
+/* granulepos adjustment, all or nothing */
+typedef struct _rogg_granule_adjust rogg_granule_adjust;
+struct _rogg_granule_adjust {
+  int all;			/* every stream, unless one matches serialno */
+  uint32_t serialno;
+  int64_t adjust;
+};
+
+typedef struct _rogg_granule_options rogg_granule_options;
+struct _rogg_granule_options {
+  const rogg_granule_adjust *adjust;	/* the last match wins */
+  int count;
+  int headers;			/* header packets to skip, -1 by codec */
+  int check_only;		/* don't change anything */
+  int threads;
+  rogg_hooks hooks;
+};
+
+#define ROGG_GRANULE_OK 0
+#define ROGG_GRANULE_NOMEM 1	/* out of memory */
+#define ROGG_GRANULE_HEADERS 2	/* headers don't end a page */
+#define ROGG_GRANULE_UNSET 3	/* a granulepos would become -1 */
+#define ROGG_GRANULE_NEGATIVE 4	/* a granulepos would become negative */
+
+typedef struct _rogg_granule_result rogg_granule_result;
+struct _rogg_granule_result {
+  long pages;			/* pages changed, or which would be */
+  int error;			/* ROGG_GRANULE_* */
+  uint32_t serialno;		/* stream and value which failed */
+  int64_t granulepos;
+};
+
+/* returns 0, or -1 with nothing changed and the reason in result */
+int rogg_granule_shift(unsigned char *p, long len,
+	const rogg_granule_options *opts, rogg_arena *arena,
+	rogg_granule_result *result);
+
+/* fields of the identification headers the edits below work on,
+   read from the bos pages of the first link */
+typedef struct _rogg_theora_info rogg_theora_info;
+struct _rogg_theora_info {
+  int version[3];
+  int full_width, full_height;	/* encoded image */
+  int width, height, x, y;	/* display image, y from the top */
+  int fps_num, fps_den;
+  int aspect_num, aspect_den;
+  int colorspace;
+  int bitrate;
+  int quality;
+  int shift;			/* keyframe granule shift */
+};
+
+typedef struct _rogg_theora_options rogg_theora_options;
+struct _rogg_theora_options {
+  int aspect_set, aspect_num, aspect_den;
+  int fps_set, fps_num, fps_den;
+  int crop_set, crop_width, crop_height;
+  /* offsets from the right or bottom when the origin is '-' */
+  char crop_xorigin, crop_yorigin;
+  int crop_xoffset, crop_yoffset;
+  rogg_hooks hooks;
+};
+
+typedef struct _rogg_theora_stream rogg_theora_stream;
+struct _rogg_theora_stream {
+  uint32_t serialno;
+  long long offset;		/* of the bos page */
+  rogg_theora_info before, after;
+  int changed;
+  int bad_crop;			/* crop window outside the image, unset */
+};
+
+typedef struct _rogg_theora_result rogg_theora_result;
+struct _rogg_theora_result {
+  rogg_theora_stream *streams;
+  int count;
+};
+
+int rogg_theora_edit(unsigned char *p, long len,
+	const rogg_theora_options *opts, rogg_arena *arena,
+	rogg_theora_result *result);
+
+typedef struct _rogg_kate_info rogg_kate_info;
+struct _rogg_kate_info {
+  int major, minor;
+  char language[16], category[16];
+  int canvas_width, canvas_height;
+  int fps_num, fps_den;
+};
+
+typedef struct _rogg_kate_options rogg_kate_options;
+struct _rogg_kate_options {
+  const char *language;		/* up to 15 characters, NULL to keep */
+  const char *category;
+  int canvas_set, canvas_width, canvas_height;
+  rogg_hooks hooks;
+};
+
+typedef struct _rogg_kate_stream rogg_kate_stream;
+struct _rogg_kate_stream {
+  uint32_t serialno;
+  long long offset;
+  rogg_kate_info before, after;
+  int changed;
+};
+
+typedef struct _rogg_kate_result rogg_kate_result;
+struct _rogg_kate_result {
+  rogg_kate_stream *streams;
+  int count;
+};
+
+/* returns -1 without looking at the buffer if the options can't be
+   stored in the header, or if memory runs out */
+int rogg_kate_edit(unsigned char *p, long len,
+	const rogg_kate_options *opts, rogg_arena *arena,
+	rogg_kate_result *result);
+
+typedef struct _rogg_opus_info rogg_opus_info;
+struct _rogg_opus_info {
+  int version;
+  int channels;
+  int preskip;
+  int input_rate;
+  int gain;			/* Q7.8 dB */
+  int mapping;
+};
+
+typedef struct _rogg_opus_options rogg_opus_options;
+struct _rogg_opus_options {
+  int gain_set, gain;		/* output gain */
+  int track_set, track;		/* R128_TRACK_GAIN, only using padding */
+  rogg_hooks hooks;
+};
+
+typedef struct _rogg_opus_stream rogg_opus_stream;
+struct _rogg_opus_stream {
+  uint32_t serialno;
+  long long offset;
+  rogg_opus_info before, after;
+  int track;			/* 0 if set, 1 if there was no room, -1 on
+				   errors */
+};
+
+typedef struct _rogg_opus_result rogg_opus_result;
+struct _rogg_opus_result {
+  rogg_opus_stream *streams;
+  int count;
+};
+
+int rogg_opus_edit(unsigned char *p, long len,
+	const rogg_opus_options *opts, rogg_arena *arena,
+	rogg_opus_result *result);
+
+/* per stream page and bitrate statistics */
+#define ROGG_STATS_SIZES 10	/* page size buckets, doubling from 128 */
+
+typedef struct _rogg_stats_options rogg_stats_options;
+struct _rogg_stats_options {
+  double window;		/* seconds for the peak bitrate */
+  rogg_hooks hooks;
+};
+
+typedef struct _rogg_stream_stats rogg_stream_stats;
+struct _rogg_stream_stats {
+  uint32_t serialno;
+  rogg_stream_info info;
+  long pages;
+  long hbytes, dbytes;		/* page headers and bodies */
+  long sizes[ROGG_STATS_SIZES];
+  int64_t last_granule;
+  double duration;		/* -1 without a time mapping */
+  double max_gap;		/* longest between timestamps */
+  double peak;			/* bits per second */
+};
+
+typedef struct _rogg_stats_result rogg_stats_result;
+struct _rogg_stats_result {
+  rogg_stream_stats *streams;	/* in order of appearance */
+  int count;
+  long hbytes, dbytes;
+};
+
+int rogg_stats_collect(unsigned char *p, long len,
+	const rogg_stats_options *opts, rogg_arena *arena,
+	rogg_stats_result *result);
+
 #endif /* _ROGG_H */
@@ -0,0 +1,164 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* region allocation for per-file state */
+
+/* Memory is carved off the front of large blocks and never given back
+   one piece at a time. Resetting the arena rewinds it to the first
+   block but keeps every block it has grown, so once a file as big as
+   any before it has been seen, processing further files makes no
+   heap calls at all. Blocks are only freed by rogg_arena_clear. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rogg.h"
+
+/* every allocation is aligned for any scalar type */
+#define ROGG_ARENA_ALIGN 16
+#define ROGG_ARENA_ROUND(n) \
+	(((n) + ROGG_ARENA_ALIGN - 1) & ~(size_t)(ROGG_ARENA_ALIGN - 1))
+
+struct _rogg_arena_block {
+  struct _rogg_arena_block *next;
+  size_t size;			/* usable bytes after the header */
+};
+
+#define ROGG_ARENA_HEADER ROGG_ARENA_ROUND(sizeof(struct _rogg_arena_block))
+
+static unsigned char *block_data(struct _rogg_arena_block *b)
+{
+  return (unsigned char *)b + ROGG_ARENA_HEADER;
+}
+
+void rogg_arena_init(rogg_arena *arena, size_t block)
+{
+  memset(arena, 0, sizeof(*arena));
+  arena->block = block ? ROGG_ARENA_ROUND(block) : ROGG_ARENA_BLOCK;
+}
+
+/* move on to a block with room for size bytes, reusing the ones kept
+   by a reset where they are big enough */
+static int arena_next(rogg_arena *arena, size_t size)
+{
+  struct _rogg_arena_block *b, **link;
+  size_t want;
+
+  link = arena->current ? &arena->current->next : &arena->blocks;
+  while ((b = *link) != NULL) {
+    if (b->size >= size) {
+      arena->current = b;
+      arena->used = 0;
+      return 0;
+    }
+    link = &b->next;
+  }
+
+  want = size > arena->block ? size : arena->block;
+  b = malloc(ROGG_ARENA_HEADER + want);
+  if (b == NULL) return -1;
+  b->next = NULL;
+  b->size = want;
+  *link = b;
+  arena->current = b;
+  arena->used = 0;
+  arena->allocated += want;
+
+  return 0;
+}
+
+void *rogg_arena_alloc(rogg_arena *arena, size_t size)
+{
+  unsigned char *ret;
+
+  size = ROGG_ARENA_ROUND(size ? size : 1);
+  if (arena->current == NULL || arena->used + size > arena->current->size) {
+    if (arena_next(arena, size) < 0) return NULL;
+  }
+  ret = block_data(arena->current) + arena->used;
+  arena->last = ret;
+  arena->used += size;
+
+  return ret;
+}
+
+void *rogg_arena_calloc(rogg_arena *arena, size_t count, size_t size)
+{
+  void *ret;
+
+  if (size && count > SIZE_MAX / size) return NULL;
+  ret = rogg_arena_alloc(arena, count * size);
+  if (ret != NULL) memset(ret, 0, count * size);
+
+  return ret;
+}
+
+void *rogg_arena_grow(rogg_arena *arena, void *old, size_t old_size,
+	size_t size)
+{
+  unsigned char *start;
+  void *ret;
+
+  if (old == NULL) return rogg_arena_alloc(arena, size);
+  if (size <= old_size) return old;
+
+  /* the latest allocation can be extended where it is */
+  if (old == arena->last) {
+    start = block_data(arena->current);
+    if ((unsigned char *)old - start + ROGG_ARENA_ROUND(size) <=
+	arena->current->size) {
+      arena->used = (unsigned char *)old - start + ROGG_ARENA_ROUND(size);
+      return old;
+    }
+  }
+
+  ret = rogg_arena_alloc(arena, size);
+  if (ret != NULL) memcpy(ret, old, old_size);
+
+  return ret;
+}
+
+void rogg_arena_reset(rogg_arena *arena)
+{
+  arena->current = arena->blocks;
+  arena->used = 0;
+  arena->last = NULL;
+}
+
+void rogg_arena_clear(rogg_arena *arena)
+{
+  struct _rogg_arena_block *next, *b = arena->blocks;
+
+  while (b != NULL) {
+    next = b->next;
+    free(b);
+    b = next;
+  }
+  rogg_arena_init(arena, arena->block);
+}
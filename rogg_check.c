@@ -0,0 +1,276 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* batch crc validation of many Ogg files using the rogg library */
+
+/* compile with
+   gcc -O2 -g -Wall -I. -o rogg_check rogg.c rogg_reader.c rogg_repair.c \
+	rogg_check.c -lpthread
+*/
+
+/* With -c, pages with a bad crc are checked for one or two flipped
+   bits which would explain it. The bits found are noted as file
+   offsets while reading, and flipped back in the file once it has
+   been read through, so the reader never sees a half fixed file. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <rogg.h>
+
+int show_counters = 0;
+int verbose = 0;
+int backend = ROGG_READER_AUTO;
+int depth = 0;
+long chunk = 0;
+int correct = 0;
+
+typedef struct {
+  char *name;
+  long long bad;
+  long long fixed;		/* pages corrected */
+  long long *bits;		/* file offset * 8 + bit of each fix */
+  long count, room;
+} filecheck;
+
+void print_usage(FILE *out, char *name)
+{
+  fprintf(stderr, "Batch crc checker for Ogg files\n");
+  fprintf(stderr, "%s [-v] [-c] [-j n] [-b kbytes] [-T] <file1.ogg> [<file2.ogg>...]\n",
+	name);
+  fprintf(stderr, "    -v          print each page with a bad crc\n"
+		  "    -c          correct pages with one or two flipped bits\n"
+		  "    -j n        number of reads to keep in flight\n"
+		  "    -b kbytes   size of each read\n"
+		  "    -T          use a thread pool instead of io_uring\n"
+		  "    -S          print library counters on exit\n");
+}
+
+int parse_args(int *argc, char *argv[])
+{
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'v':
+	  verbose = 1;
+	  shift = 1;
+	  break;
+	case 'c':
+	  correct = 1;
+	  shift = 1;
+	  break;
+	case 'T':
+	  backend = ROGG_READER_THREADS;
+	  shift = 1;
+	  break;
+	case 'j':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 || sscanf(argv[arg+1], "%d", &depth) != 1) {
+	    fprintf(stderr, "Option -j requires a number of reads.\n");
+	    exit(1);
+	  }
+	  break;
+	case 'b':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 || sscanf(argv[arg+1], "%ld", &chunk) != 1) {
+	    fprintf(stderr, "Option -b requires a read size in kilobytes.\n");
+	    exit(1);
+	  }
+	  chunk *= 1024;
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
+}
+
+/* look for flipped bits explaining a bad crc, noting them to be fixed;
+   returns nonzero if the page could be corrected */
+int repair_page(filecheck *check, long long offset, rogg_page_header *header)
+{
+  unsigned char *copy;
+  long positions[2];
+  int i, bits;
+
+  copy = malloc(header->length);
+  if (copy == NULL) return 0;
+  memcpy(copy, header->capture, header->length);
+  bits = rogg_page_repair(copy, 2, positions);
+  free(copy);
+  if (bits <= 0) return 0;
+
+  if (check->count + bits > check->room) {
+    long long *more;
+    check->room = check->room * 2 + 16;
+    more = realloc(check->bits, check->room * sizeof(*more));
+    if (more == NULL) return 0;
+    check->bits = more;
+  }
+  fprintf(stdout, "%s: corrected page serial %08x seq %d at offset %lld,",
+	check->name, header->serialno, header->sequenceno, offset);
+  for (i = 0; i < bits; i++) {
+    check->bits[check->count++] = offset * 8 + positions[i];
+    fprintf(stdout, " byte %ld bit %ld", positions[i] / 8, positions[i] % 8);
+  }
+  fprintf(stdout, "\n");
+  check->fixed++;
+  return 1;
+}
+
+/* flip the noted bits back in the file */
+int repair_file(filecheck *check)
+{
+  unsigned char byte;
+  long long at;
+  long i;
+  int fd;
+
+  fd = open(check->name, O_RDWR);
+  if (fd < 0) return -1;
+  for (i = 0; i < check->count; i++) {
+    at = check->bits[i] / 8;
+    if (pread(fd, &byte, 1, at) != 1) break;
+    byte ^= 1 << (check->bits[i] % 8);
+    if (pwrite(fd, &byte, 1, at) != 1) break;
+  }
+  if (close(fd) < 0 || i < check->count) return -1;
+  return 0;
+}
+
+int check_page(void *data, int file, long long offset, rogg_page_header *header)
+{
+  filecheck *checks = data;
+
+  if (!rogg_page_check_crc(header->capture)) {
+    if (correct && repair_page(&checks[file], offset, header)) return 0;
+    checks[file].bad++;
+    if (verbose) {
+      fprintf(stdout, "%s: bad crc on page serial %08x seq %d at offset %lld\n",
+	checks[file].name, header->serialno, header->sequenceno, offset);
+    }
+  }
+
+  return 0;
+}
+
+void check_done(void *data, int file, rogg_framer *framer, int error)
+{
+  filecheck *checks = data;
+
+  if (error) {
+    fprintf(stdout, "%s: read error: %s\n", checks[file].name, strerror(error));
+    checks[file].bad++;
+    return;
+  }
+  if (framer->pages == 0) {
+    fprintf(stdout, "%s: couldn't find ogg data!\n", checks[file].name);
+    checks[file].bad++;
+    return;
+  }
+  if (checks[file].count && repair_file(&checks[file]) < 0) {
+    fprintf(stdout, "%s: couldn't write corrections: %s\n",
+	checks[file].name, strerror(errno));
+    checks[file].bad += checks[file].fixed;
+    checks[file].fixed = 0;
+  }
+  fprintf(stdout, "%s: %lld pages, %lld bad crc, %lld garbage bytes in %d holes",
+	checks[file].name, framer->pages, checks[file].bad,
+	framer->garbage, framer->holes);
+  if (checks[file].fixed)
+    fprintf(stdout, ", %lld pages corrected", checks[file].fixed);
+  fprintf(stdout, "\n");
+  if (framer->garbage) checks[file].bad++;
+}
+
+int main(int argc, char *argv[])
+{
+  rogg_reader reader;
+  filecheck *checks;
+  int i, failed = 0;
+
+  parse_args(&argc, argv);
+  if (argc < 2) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+
+  checks = calloc(argc - 1, sizeof(*checks));
+  if (checks == NULL) {
+    fprintf(stderr, "couldn't allocate file list\n");
+    exit(1);
+  }
+  for (i = 1; i < argc; i++) {
+    checks[i-1].name = argv[i];
+  }
+
+  rogg_reader_init(&reader);
+  reader.backend = backend;
+  if (depth > 0) reader.depth = depth;
+  if (chunk > 0) reader.chunk = chunk;
+  reader.page = check_page;
+  reader.done = check_done;
+  reader.data = checks;
+  if (rogg_reader_run(&reader, argc - 1, argv + 1) < 0) {
+    fprintf(stderr, "couldn't start the reader\n");
+    exit(1);
+  }
+
+  for (i = 0; i < argc - 1; i++) {
+    if (checks[i].bad) failed++;
+    free(checks[i].bits);
+  }
+  free(checks);
+
+  if (show_counters) rogg_counters_report(stderr);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,265 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* codec identification and granulepos mapping for the rogg library */
+
+/* Each codec is described by its identification header magic and a
+   parse function which pulls the granule rate, keyframe shift and
+   header count out of the first packet. Lookup on a bos page is an
+   index on the first byte of the packet followed by a memcmp against
+   the few codecs sharing it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rogg.h"
+
+/* big and little endian accessors for the codec headers */
+static uint32_t get32le(unsigned char *data)
+{
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint32_t get32be(unsigned char *data)
+{
+  return ((uint32_t)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+static int vorbis_parse(rogg_stream_info *info, unsigned char *data, int len)
+{
+  info->rate_num = get32le(data + 12);
+  info->rate_den = 1;
+  info->headers = 3;
+  return 0;
+}
+
+static int opus_parse(rogg_stream_info *info, unsigned char *data, int len)
+{
+  /* granulepos is always at 48 kHz, whatever the input rate was */
+  info->rate_num = 48000;
+  info->rate_den = 1;
+  info->preskip = data[10] | (data[11] << 8);
+  info->headers = 2;
+  return 0;
+}
+
+static int theora_parse(rogg_stream_info *info, unsigned char *data, int len)
+{
+  info->rate_num = get32be(data + 22);
+  info->rate_den = get32be(data + 26);
+  info->shift = ((data[40] & 0x03) << 3) | (data[41] >> 5);
+  /* frame numbers were zero based before 3.2.1 */
+  info->frame_base = (data[7] << 16 | data[8] << 8 | data[9]) < 0x030201;
+  info->headers = 3;
+  return 0;
+}
+
+static int kate_parse(rogg_stream_info *info, unsigned char *data, int len)
+{
+  info->rate_num = get32le(data + 24);
+  info->rate_den = get32le(data + 28);
+  info->shift = data[15];
+  info->headers = data[11];
+  return 0;
+}
+
+static int speex_parse(rogg_stream_info *info, unsigned char *data, int len)
+{
+  info->rate_num = get32le(data + 36);
+  info->rate_den = 1;
+  /* the comment header plus any extra headers */
+  info->headers = 2 + get32le(data + 68);
+  return 0;
+}
+
+static int flac_parse(rogg_stream_info *info, unsigned char *data, int len)
+{
+  int count = (data[7] << 8) | data[8];
+
+  info->rate_num = (data[27] << 12) | (data[28] << 4) | (data[29] >> 4);
+  info->rate_den = 1;
+  /* a count of zero means the number of headers isn't known */
+  info->headers = count ? count + 1 : -1;
+  return 0;
+}
+
+static int skeleton_parse(rogg_stream_info *info, unsigned char *data, int len)
+{
+  /* skeleton has no timebase of its own, and every packet up to
+     the eos is a header */
+  info->headers = -1;
+  return 0;
+}
+
+/* keyframe granule for codecs which split granulepos at shift */
+static int64_t shift_keyframe(rogg_stream_info *info, int64_t granulepos)
+{
+  if (granulepos < 0) return -1;
+  return (granulepos >> info->shift) << info->shift;
+}
+
+/* theora data packets start with a zero bit, then zero for intra frames */
+static int theora_packet_keyframe(unsigned char *data, int len)
+{
+  return len > 0 && !(data[0] & 0xc0);
+}
+
+/* the built in codecs, sorted so ones sharing a first byte are adjacent */
+static const rogg_codec rogg_codecs[] = {
+  { ROGG_CODEC_VORBIS, "vorbis", "\x01vorbis", 7, 30,
+	vorbis_parse, NULL, NULL },
+  { ROGG_CODEC_OPUS, "opus", "OpusHead", 8, 19,
+	opus_parse, NULL, NULL },
+  { ROGG_CODEC_THEORA, "theora", "\x80theora", 7, 42,
+	theora_parse, shift_keyframe, theora_packet_keyframe },
+  { ROGG_CODEC_KATE, "kate", "\x80kate\0\0\0", 8, 64,
+	kate_parse, shift_keyframe, NULL },
+  { ROGG_CODEC_SPEEX, "speex", "Speex   ", 8, 80,
+	speex_parse, NULL, NULL },
+  { ROGG_CODEC_FLAC, "flac", "\x7f""FLAC", 5, 51,
+	flac_parse, NULL, NULL },
+  { ROGG_CODEC_SKELETON, "skeleton", "fishead\0", 8, 64,
+	skeleton_parse, NULL, NULL },
+};
+
+#define ROGG_CODECS (int)(sizeof(rogg_codecs)/sizeof(*rogg_codecs))
+
+/* first byte of the identification packet to one more than the index
+   of the first codec in rogg_codecs starting with it, 0 for none */
+static const unsigned char rogg_codec_index[256] = {
+  [0x01] = 1,	/* vorbis */
+  ['O'] = 2,	/* opus */
+  [0x80] = 3,	/* theora, kate */
+  ['S'] = 5,	/* speex */
+  [0x7f] = 6,	/* flac */
+  ['f'] = 7,	/* skeleton */
+};
+
+/* codecs added by the application, checked before the built in ones */
+#define ROGG_CODEC_EXTRA 8
+static const rogg_codec *rogg_codec_extra[ROGG_CODEC_EXTRA];
+static int rogg_codec_extras = 0;
+
+static int rogg_codec_match(const rogg_codec *codec,
+	unsigned char *data, int len)
+{
+  return len >= codec->min_len && len >= codec->magic_len &&
+	!memcmp(data, codec->magic, codec->magic_len);
+}
+
+int rogg_codec_register(const rogg_codec *codec)
+{
+  if (rogg_codec_extras >= ROGG_CODEC_EXTRA) return -1;
+  rogg_codec_extra[rogg_codec_extras++] = codec;
+  return 0;
+}
+
+const rogg_codec *rogg_codec_identify(unsigned char *data, int len)
+{
+  const rogg_codec *codec;
+  int i;
+
+  if (len < 1) return NULL;
+  for (i = 0; i < rogg_codec_extras; i++) {
+    if (rogg_codec_match(rogg_codec_extra[i], data, len))
+      return rogg_codec_extra[i];
+  }
+  i = rogg_codec_index[data[0]];
+  if (!i) return NULL;
+  for (codec = &rogg_codecs[i - 1]; codec < rogg_codecs + ROGG_CODECS &&
+	(unsigned char)codec->magic[0] == data[0]; codec++) {
+    if (rogg_codec_match(codec, data, len)) return codec;
+  }
+
+  return NULL;
+}
+
+const char *rogg_codec_name(const rogg_codec *codec)
+{
+  return codec ? codec->name : "unknown";
+}
+
+int rogg_stream_info_init(rogg_stream_info *info, rogg_page_header *header)
+{
+  unsigned char *data = header->data;
+  int len = 0;
+  int i;
+
+  memset(info, 0, sizeof(*info));
+  info->serialno = header->serialno;
+  info->headers = -1;
+  if (!header->bos || header->continued) return -1;
+  /* the identification packet must be the first on the page */
+  for (i = 0; i < header->segments; i++) {
+    len += header->lacing[i];
+    if (header->lacing[i] < 255) break;
+  }
+  info->codec = rogg_codec_identify(data, len);
+  if (info->codec == NULL) return -1;
+  if (info->codec->parse != NULL && info->codec->parse(info, data, len) < 0) {
+    info->codec = NULL;
+    return -1;
+  }
+
+  return info->codec->id;
+}
+
+int64_t rogg_stream_frames(rogg_stream_info *info, int64_t granulepos)
+{
+  int64_t frames = granulepos;
+
+  if (granulepos < 0) return -1;
+  if (info->shift) {
+    frames = (granulepos >> info->shift) +
+	(granulepos & (((int64_t)1 << info->shift) - 1));
+  }
+  frames += info->frame_base - info->preskip;
+  if (frames < 0) frames = 0;
+
+  return frames;
+}
+
+double rogg_stream_time(rogg_stream_info *info, int64_t granulepos)
+{
+  int64_t frames;
+
+  if (info->rate_num <= 0 || info->rate_den <= 0) return -1;
+  frames = rogg_stream_frames(info, granulepos);
+  if (frames < 0) return -1;
+
+  return (double)frames * info->rate_den / info->rate_num;
+}
+
+int64_t rogg_stream_keyframe(rogg_stream_info *info, int64_t granulepos)
+{
+  if (info->codec != NULL && info->codec->keyframe != NULL)
+    return info->codec->keyframe(info, granulepos);
+  /* every packet stands alone */
+  return granulepos < 0 ? -1 : granulepos;
+}
@@ -0,0 +1,217 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* vorbis comment style metadata packets */
+
+/* Vorbis, Opus, Theora and FLAC all carry the same comment structure,
+   a vendor string and a list of KEY=value tags with little endian
+   lengths, behind a codec specific prefix. Parsed tags point into the
+   packet data, or into whatever the caller adds, so nothing is copied
+   until the packet is written back out. Bytes left over after the
+   tags are treated as padding, except for Opus binary data. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#include "rogg.h"
+
+static uint32_t get32(unsigned char *data)
+{
+  return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/* codec framing before the comment data */
+static int comment_prefix(int codec)
+{
+  switch (codec) {
+    case ROGG_CODEC_VORBIS: return 7;	/* \x03vorbis */
+    case ROGG_CODEC_OPUS: return 8;	/* OpusTags */
+    case ROGG_CODEC_THEORA: return 7;	/* \x81theora */
+    case ROGG_CODEC_FLAC: return 4;	/* metadata block header */
+  }
+  return -1;
+}
+
+static int comment_magic(int codec, unsigned char *data, long len)
+{
+  switch (codec) {
+    case ROGG_CODEC_VORBIS: return len >= 7 && !memcmp(data, "\x03vorbis", 7);
+    case ROGG_CODEC_OPUS: return len >= 8 && !memcmp(data, "OpusTags", 8);
+    case ROGG_CODEC_THEORA: return len >= 7 && !memcmp(data, "\x81theora", 7);
+    case ROGG_CODEC_FLAC: return len >= 4 && (data[0] & 0x7f) == 4;
+  }
+  return 0;
+}
+
+int rogg_comments_supported(int codec)
+{
+  return comment_prefix(codec) > 0;
+}
+
+int rogg_comments_parse(rogg_comments *c, int codec,
+	unsigned char *data, long len)
+{
+  unsigned char *p, *e = data + len;
+  uint32_t i;
+
+  memset(c, 0, sizeof(*c));
+  c->codec = codec;
+  if (!comment_magic(codec, data, len)) return -1;
+  if (codec == ROGG_CODEC_FLAC) {
+    long block = (data[1] << 16) | (data[2] << 8) | data[3];
+    if (block > len - 4) return -1;
+    e = data + 4 + block;
+    c->last = (data[0] & 0x80) ? 1 : 0;
+  }
+  p = data + comment_prefix(codec);
+  if (e - p < 4) return -1;
+  c->vendor_len = get32(p);
+  p += 4;
+  if (c->vendor_len > e - p) return -1;
+  c->vendor = p;
+  p += c->vendor_len;
+  if (e - p < 4) return -1;
+  c->count = get32(p);
+  p += 4;
+  if (c->count > (e - p) / 4) return -1;
+  c->room = c->count + 8;
+  c->entries = malloc(c->room * sizeof(*c->entries));
+  c->lengths = malloc(c->room * sizeof(*c->lengths));
+  if (c->entries == NULL || c->lengths == NULL) return -1;
+  for (i = 0; i < c->count; i++) {
+    if (e - p < 4) return -1;
+    c->lengths[i] = get32(p);
+    p += 4;
+    if (c->lengths[i] > e - p) return -1;
+    c->entries[i] = p;
+    p += c->lengths[i];
+  }
+  if (codec == ROGG_CODEC_VORBIS) {
+    if (p >= e || !(*p & 1)) return -1;	/* framing bit */
+    p++;
+  }
+  /* opus keeps binary data flagged by the low bit */
+  if (codec == ROGG_CODEC_OPUS && p < e && (*p & 1)) {
+    c->extra = p;
+    c->extra_len = e - p;
+  }
+
+  return 0;
+}
+
+void rogg_comments_clear(rogg_comments *c)
+{
+  free(c->entries);
+  free(c->lengths);
+  memset(c, 0, sizeof(*c));
+}
+
+int rogg_comments_match(unsigned char *entry, uint32_t len, const char *key)
+{
+  size_t n = strcspn(key, "=");
+
+  return len > n && entry[n] == '=' && !strncasecmp((char *)entry, key, n);
+}
+
+int rogg_comments_delete(rogg_comments *c, const char *key)
+{
+  uint32_t i, j;
+
+  for (i = j = 0; i < c->count; i++) {
+    if (rogg_comments_match(c->entries[i], c->lengths[i], key)) continue;
+    c->entries[j] = c->entries[i];
+    c->lengths[j++] = c->lengths[i];
+  }
+  i = c->count - j;
+  c->count = j;
+
+  return i;
+}
+
+int rogg_comments_add(rogg_comments *c, unsigned char *tag, uint32_t len)
+{
+  if (c->count == c->room) {
+    uint32_t room = c->room * 2 + 8;
+    unsigned char **entries = realloc(c->entries, room * sizeof(*entries));
+    uint32_t *lengths;
+    if (entries == NULL) return -1;
+    c->entries = entries;
+    lengths = realloc(c->lengths, room * sizeof(*lengths));
+    if (lengths == NULL) return -1;
+    c->lengths = lengths;
+    c->room = room;
+  }
+  c->entries[c->count] = tag;
+  c->lengths[c->count++] = len;
+
+  return 0;
+}
+
+long rogg_comments_size(rogg_comments *c)
+{
+  long size = comment_prefix(c->codec) + 4 + c->vendor_len + 4;
+  uint32_t i;
+
+  for (i = 0; i < c->count; i++) size += 4 + c->lengths[i];
+  if (c->codec == ROGG_CODEC_VORBIS) size++;
+
+  return size + c->extra_len;
+}
+
+void rogg_comments_write(rogg_comments *c, unsigned char *out, long len)
+{
+  unsigned char *p = out + comment_prefix(c->codec);
+  uint32_t i;
+
+  memset(out, 0, len);
+  switch (c->codec) {
+    case ROGG_CODEC_VORBIS: memcpy(out, "\x03vorbis", 7); break;
+    case ROGG_CODEC_OPUS: memcpy(out, "OpusTags", 8); break;
+    case ROGG_CODEC_THEORA: memcpy(out, "\x81theora", 7); break;
+    case ROGG_CODEC_FLAC:
+      out[0] = 4 | (c->last ? 0x80 : 0);
+      out[1] = ((len - 4) >> 16) & 0xFF;
+      out[2] = ((len - 4) >> 8) & 0xFF;
+      out[3] = (len - 4) & 0xFF;
+      break;
+  }
+  rogg_write_uint32(p, c->vendor_len);
+  memcpy(p + 4, c->vendor, c->vendor_len);
+  p += 4 + c->vendor_len;
+  rogg_write_uint32(p, c->count);
+  p += 4;
+  for (i = 0; i < c->count; i++) {
+    rogg_write_uint32(p, c->lengths[i]);
+    memcpy(p + 4, c->entries[i], c->lengths[i]);
+    p += 4 + c->lengths[i];
+  }
+  if (c->codec == ROGG_CODEC_VORBIS) *p++ = 1;
+  if (c->extra_len) memcpy(p, c->extra, c->extra_len);
+}
@@ -0,0 +1,450 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* ogg file chaining using the rogg library */
+
+/* compile with
+   gcc -O2 -g -Wall -I. -o rogg_concat rogg.c rogg_codec.c rogg_writer.c \
+	rogg_concat.c
+*/
+
+/* Inputs are appended one after another as links of a chained file.
+   Demuxers tell links apart by their serial numbers, so a stream whose
+   serial was already used earlier in the output gets a fresh one, and
+   its pages are rewritten with the new serial and crc. Everything else
+   is copied as it is: long runs of untouched pages with
+   copy_file_range(), short ones by reference from the mapping.
+
+   With -x the byte range and timing of every link is written out as
+   CSV, so a player can go straight to the right link before seeking
+   within it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <rogg.h>
+
+/* runs of untouched pages at least this long are copied in the kernel */
+#define COPY_RUN (1024*1024)
+
+int show_counters = 0;
+int verbose = 0;
+char *output = NULL;
+char *index_name = NULL;
+
+/* a stream of the link being copied */
+typedef struct {
+  uint32_t serialno;		/* in the input */
+  uint32_t new_serialno;	/* in the output */
+  rogg_stream_info info;
+  long finished;		/* packets finished */
+  int64_t first, second;	/* first two data granulepos, or -1 */
+  int64_t last;			/* last granulepos, -1 for none */
+} link_stream;
+
+typedef struct {
+  link_stream *streams;
+  int count, room;
+  int data;			/* seen pages after the bos ones */
+  long long offset;		/* where it starts in the output */
+} chain_link;
+
+/* the whole output */
+typedef struct {
+  rogg_writer w;
+  uint32_t *used;		/* serial numbers in the output so far */
+  int used_count, used_room;
+  int links;
+  double time;			/* start time of the next link */
+  int renamed;
+  FILE *index;
+  FILE *pending;		/* index rows of the file being appended */
+} chain;
+
+void print_usage(FILE *out, char *name)
+{
+  fprintf(out, "Chain Ogg files together, fixing serial number collisions.\n");
+  fprintf(out, "%s [-v] [-x index.csv] -o out.ogg <in1.ogg> <in2.ogg>...\n",
+	name);
+  fprintf(out, "    -o out.ogg  the chained file to write\n"
+		  "    -x file     write the offset and times of each link as CSV\n"
+		  "    -v          print the serial numbers which were changed\n"
+		  "    -S          print library counters on exit\n");
+}
+
+int parse_args(int *argc, char *argv[])
+{
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'v':
+	  verbose = 1;
+	  shift = 1;
+	  break;
+	case 'o':
+	  shift = 2;
+	  if (*argc - arg - shift < 0) {
+	    fprintf(stderr, "Option -o requires an output file.\n");
+	    exit(1);
+	  }
+	  output = argv[arg+1];
+	  break;
+	case 'x':
+	  shift = 2;
+	  if (*argc - arg - shift < 0) {
+	    fprintf(stderr, "Option -x requires an index file.\n");
+	    exit(1);
+	  }
+	  index_name = argv[arg+1];
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
+}
+
+int serial_used(chain *c, uint32_t serialno)
+{
+  int i;
+
+  for (i = 0; i < c->used_count; i++) {
+    if (c->used[i] == serialno) return 1;
+  }
+  return 0;
+}
+
+int serial_add(chain *c, uint32_t serialno)
+{
+  if (c->used_count == c->used_room) {
+    uint32_t *used;
+    c->used_room = c->used_room * 2 + 64;
+    used = realloc(c->used, c->used_room * sizeof(*used));
+    if (used == NULL) return -1;
+    c->used = used;
+  }
+  c->used[c->used_count++] = serialno;
+  return 0;
+}
+
+link_stream *link_find(chain_link *l, uint32_t serialno)
+{
+  int i;
+
+  for (i = 0; i < l->count; i++) {
+    if (l->streams[i].serialno == serialno) return &l->streams[i];
+  }
+  return NULL;
+}
+
+/* when a stream starts; a link cut from a longer stream may not start
+   at zero, so take the first page to be about as long as the second */
+double stream_start(link_stream *s)
+{
+  double t1, t2;
+
+  if (s->first < 0) return -1;
+  t1 = rogg_stream_time(&s->info, s->first);
+  if (s->second < 0) return t1 > 0 ? 0 : t1;
+  t2 = rogg_stream_time(&s->info, s->second);
+  return t1 > t2 - t1 ? t1 - (t2 - t1) : 0;
+}
+
+/* note the finished link for the index and forget its streams; the
+   rows are only written out once the file's pages have been */
+void link_end(chain *c, chain_link *l, const char *name)
+{
+  double start = -1, end = 0, duration, t;
+  int i;
+
+  if (!l->count) return;
+  for (i = 0; i < l->count; i++) {
+    if (l->streams[i].last < 0) continue;
+    t = rogg_stream_time(&l->streams[i].info, l->streams[i].last);
+    if (t > end) end = t;
+    t = stream_start(&l->streams[i]);
+    if (t >= 0 && (start < 0 || t < start)) start = t;
+  }
+  duration = start < 0 ? 0 : end - start;
+  if (c->pending != NULL) {
+    fprintf(c->pending, "%d,%lld,%lld,%.6lf,%.6lf,", c->links, l->offset,
+	c->w.offset - l->offset, c->time, duration);
+    for (i = 0; i < l->count; i++)
+      fprintf(c->pending, "%s%08x", i ? " " : "", l->streams[i].new_serialno);
+    fputc(',', c->pending);
+    /* quote the name for csv */
+    fputc('"', c->pending);
+    for (; *name; name++) {
+      if (*name == '"') fputc('"', c->pending);
+      fputc(*name, c->pending);
+    }
+    fputs("\"\n", c->pending);
+  }
+  c->time += duration;
+  c->links++;
+  l->count = 0;
+  l->data = 0;
+}
+
+/* queue a run of untouched input for the output */
+int flush_run(chain *c, int f, unsigned char *p, unsigned char *start,
+	unsigned char *end)
+{
+  if (end - start >= COPY_RUN)
+    return rogg_writer_copy(&c->w, f, p, start - p, end - start);
+  return rogg_writer_data(&c->w, start, end - start);
+}
+
+int append_file(chain *c, const char *name, int f, unsigned char *p, long len)
+{
+  unsigned char *e = p + len;
+  unsigned char *q, *run, *expect;
+  rogg_page_header header;
+  chain_link l;
+  link_stream *s;
+  int ret = -1;
+
+  memset(&l, 0, sizeof(l));
+  q = rogg_page_find(p, e, &header);
+  if (q == NULL || !header.bos) {
+    fprintf(stderr, "'%s' doesn't start with a bos page\n", name);
+    return -1;
+  }
+  run = expect = q;
+  while (q != NULL) {
+    if (q != expect) {
+      /* leave out garbage between pages */
+      if (flush_run(c, f, p, run, expect)) goto out;
+      run = q;
+    }
+    if (header.bos && l.data) {
+      /* a chained input, carry on with its next link, which may
+	 reuse the serials of this one */
+      if (flush_run(c, f, p, run, q)) goto out;
+      run = q;
+      link_end(c, &l, name);
+    }
+    s = link_find(&l, header.serialno);
+    if (header.bos) {
+      if (s != NULL) {
+	fprintf(stderr, "'%s' has two bos pages for stream %08x\n",
+		name, header.serialno);
+	goto out;
+      }
+      if (!l.count) {
+	if (flush_run(c, f, p, run, q)) goto out;
+	run = q;
+	l.offset = c->w.offset;
+      }
+      if (l.count == l.room) {
+	link_stream *streams;
+	l.room = l.room * 2 + 4;
+	streams = realloc(l.streams, l.room * sizeof(*streams));
+	if (streams == NULL) goto out;
+	l.streams = streams;
+      }
+      s = &l.streams[l.count++];
+      s->serialno = s->new_serialno = header.serialno;
+      s->finished = 0;
+      s->first = s->second = s->last = -1;
+      rogg_stream_info_init(&s->info, &header);
+      while (serial_used(c, s->new_serialno)) s->new_serialno++;
+      if (serial_add(c, s->new_serialno) < 0) goto out;
+      if (s->new_serialno != s->serialno) {
+	c->renamed++;
+	if (verbose) fprintf(stdout, "%s: stream %08x is now %08x\n",
+		name, s->serialno, s->new_serialno);
+      }
+    } else if (s == NULL) {
+      fprintf(stderr, "'%s': dropping page of unknown stream %08x\n",
+	name, header.serialno);
+      if (flush_run(c, f, p, run, q)) goto out;
+      run = q + header.length;
+    } else {
+      l.data = 1;
+    }
+
+    if (s != NULL) {
+      int data;
+      s->finished += rogg_page_packets_ending(&header);
+      data = s->info.headers >= 0 && s->finished > s->info.headers;
+      if ((int64_t)header.granulepos != -1) {
+	if (data && s->first < 0) s->first = header.granulepos;
+	else if (data && s->second < 0) s->second = header.granulepos;
+	s->last = header.granulepos;
+      }
+      if (s->new_serialno != s->serialno) {
+	/* only this page needs rewriting */
+	if (flush_run(c, f, p, run, q)) goto out;
+	header.serialno = s->new_serialno;
+	if (rogg_writer_page(&c->w, &header)) goto out;
+	run = q + header.length;
+      }
+    }
+    expect = q + header.length;
+    q = rogg_page_find(expect, e, &header);
+  }
+  if (flush_run(c, f, p, run, expect)) goto out;
+  link_end(c, &l, name);
+  ret = 0;
+
+out:
+  free(l.streams);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  int f, o, i, ret = 0, keep = 0;
+  unsigned char *p;
+  char *rows;
+  size_t rows_len;
+  struct stat s, os;
+  chain c;
+
+  parse_args(&argc, argv);
+  if (argc < 2 || output == NULL) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+
+  memset(&c, 0, sizeof(c));
+  o = open(output, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  if (o < 0 || fstat(o, &os) < 0) {
+    fprintf(stderr, "couldn't create '%s'\n", output);
+    exit(1);
+  }
+  if (index_name != NULL) {
+    c.index = fopen(index_name, "w");
+    if (c.index == NULL) {
+      fprintf(stderr, "couldn't create '%s'\n", index_name);
+      exit(1);
+    }
+    fprintf(c.index, "link,offset,length,start,duration,serials,file\n");
+  }
+  rogg_writer_init(&c.w, o);
+
+  for (i = 1; i < argc && !ret; i++) {
+    f = open(argv[i], O_RDONLY);
+    if (f < 0) {
+      fprintf(stderr, "couldn't open '%s'\n", argv[i]);
+      ret = 1;
+      break;
+    }
+    if (fstat(f, &s) < 0 || s.st_size == 0) {
+      fprintf(stderr, "couldn't stat '%s'\n", argv[i]);
+      close(f);
+      ret = 1;
+      break;
+    }
+    if (s.st_dev == os.st_dev && s.st_ino == os.st_ino) {
+      fprintf(stderr, "can't read '%s' while writing it\n", argv[i]);
+      close(f);
+      keep = 1;
+      ret = 1;
+      break;
+    }
+    p = mmap(0, s.st_size, PROT_READ, MAP_SHARED, f, 0);
+    if (p == MAP_FAILED) {
+      fprintf(stderr, "couldn't mmap '%s'\n", argv[i]);
+      close(f);
+      ret = 1;
+      break;
+    }
+    rows = NULL;
+    if (c.index != NULL) {
+      c.pending = open_memstream(&rows, &rows_len);
+      if (c.pending == NULL) {
+	fprintf(stderr, "couldn't allocate index rows\n");
+	munmap(p, s.st_size);
+	close(f);
+	ret = 1;
+	break;
+      }
+    }
+    /* queued pieces point into the mapping, so write them out first */
+    if (append_file(&c, argv[i], f, p, s.st_size) < 0 ||
+	rogg_writer_flush(&c.w)) {
+      fprintf(stderr, "couldn't append '%s'\n", argv[i]);
+      ret = 1;
+    }
+    if (c.pending != NULL) {
+      if (fclose(c.pending) || (!ret &&
+	  fwrite(rows, 1, rows_len, c.index) != rows_len)) {
+	fprintf(stderr, "couldn't write '%s'\n", index_name);
+	ret = 1;
+      }
+      c.pending = NULL;
+      free(rows);
+    }
+    munmap(p, s.st_size);
+    close(f);
+  }
+
+  if (!ret) fprintf(stdout, "%s: %d links, %lld bytes, %d serial numbers "
+	"changed\n", output, c.links, c.w.offset, c.renamed);
+  if (c.index != NULL && fclose(c.index)) {
+    fprintf(stderr, "couldn't write '%s'\n", index_name);
+    ret = 1;
+  }
+  close(o);
+  if (ret && !keep) {
+    /* don't leave a partial chain or an index which describes one */
+    unlink(output);
+    if (index_name != NULL) unlink(index_name);
+  }
+  free(c.used);
+  if (show_counters) rogg_counters_report(stderr);
+  return ret;
+}
@@ -44,15 +44,37 @@
 
 #include <rogg.h>
 
-void print_header_info(FILE *out, rogg_page_header *header)
+int show_counters = 0;
+
+int parse_args(int *argc, char *argv[])
 {
-  fprintf(out, " Ogg page serial %08x seq %d (%5d bytes)",
-	header->serialno, header->sequenceno, header->length);
-  fprintf(out, (header->continued) ? " c" : "  ");
-  fprintf(out, " granule %lld", (long long int)header->granulepos);
-  fprintf(out, (header->bos) ? " bos" : "");
-  fprintf(out, (header->eos) ? " eos" : "");
-  fprintf(out, "\n");
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
 }
 
 int main(int argc, char *argv[])
@@ -62,6 +84,8 @@ int main(int argc, char *argv[])
   struct stat s;
   rogg_page_header header;
 
+  parse_args(&argc, argv);
+
   for (i = 1; i < argc; i++) {
     /* open and mmap each filename argument */
     f = open(argv[i], O_RDWR);
@@ -101,12 +125,13 @@ int main(int argc, char *argv[])
 	}
 	rogg_page_update_crc(q);
 	rogg_page_parse(q, &header);
-	print_header_info(stdout, &header);
+	rogg_page_print(stdout, &header);
 	q += header.length;
       }
     }
     munmap(p, s.st_size);
     close(f);
   }
+  if (show_counters) rogg_counters_report(stderr);
   return 0;
 }
@@ -0,0 +1,572 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* report pages shared between ogg files using the rogg library */
+
+/* compile with
+   gcc -O2 -g -Wall -I. -o rogg_dedup rogg.c rogg_reader.c rogg_dedup.c \
+	-lpthread
+*/
+
+/* Pages are identified by a 128 bit hash of their segment table and
+   body, leaving out the header fields which differ between copies of
+   the same data: flags, granulepos, serial and sequence numbers, and
+   the crc. Hashing happens as the reader hands each page over, with
+   files read in parallel by a pool of threads.
+
+   The index lives on disk so the archive can be far bigger than
+   memory. Each page becomes a 32 byte entry in one of a number of
+   bucket files chosen by its hash. A bucket at a time is then sorted,
+   and every page whose hash was seen earlier is recorded as a match
+   against the first copy, in match buckets split by file. Sorting
+   those by position gives runs of adjacent pages which are adjacent
+   in the first copy too, reported as shared byte ranges. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <rogg.h>
+
+/* entries gathered per reader thread before taking the lock */
+#define DEDUP_BATCH 256
+
+/* one page in the index */
+typedef struct {
+  uint64_t hash[2];
+  int64_t offset;
+  uint32_t file;
+  uint32_t length;
+} dedup_entry;
+
+/* a page found earlier at src */
+typedef struct {
+  int64_t offset;
+  int64_t src_offset;
+  uint32_t file;
+  uint32_t src_file;
+  uint32_t length;
+  uint32_t pad;
+} dedup_match;
+
+typedef struct {
+  char *name;
+  long long bytes;		/* bytes in pages */
+  long long shared;		/* of which found earlier */
+} dedup_file;
+
+typedef struct {
+  dedup_file *files;
+  int nfiles;
+  int buckets;
+  FILE **pages;			/* page entries by hash */
+  FILE **matches;		/* matches by file */
+  pthread_mutex_t lock;
+  int failed;
+} dedup_index;
+
+/* each entry names its file, so a thread's batch need not be
+   flushed between files, only before the thread finishes */
+typedef struct {
+  int count;
+  dedup_entry entries[DEDUP_BATCH];
+} dedup_batch;
+
+static __thread dedup_batch batch;
+
+int show_counters = 0;
+int threads = 0;
+int buckets = 256;
+long long min_range = 0;
+char *tmpdir = NULL;
+
+void print_usage(FILE *out, char *name)
+{
+  fprintf(out, "Report pages shared between Ogg files\n");
+  fprintf(out, "%s [-m bytes] [-j threads] [-t dir] [-b buckets] "
+	"<file1.ogg> [<file2.ogg>...]\n", name);
+  fprintf(out,
+		  "    -m bytes    only report shared ranges of at least this size\n"
+		  "    -j threads  files to read and hash at once (default one per cpu)\n"
+		  "    -t dir      where to keep the index while running (default $TMPDIR)\n"
+		  "    -b buckets  number of index files to split the pages between\n"
+		  "    -S          print library counters on exit\n"
+		  "\n");
+}
+
+int parse_args(int *argc, char *argv[])
+{
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'm':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%lld", &min_range) != 1) {
+	    fprintf(stderr, "Option -m requires a size in bytes.\n");
+	    exit(1);
+	  }
+	  break;
+	case 'j':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%d", &threads) != 1 || threads < 1) {
+	    fprintf(stderr, "Option -j requires a number of threads.\n");
+	    exit(1);
+	  }
+	  break;
+	case 't':
+	  shift = 2;
+	  if (*argc - arg - shift < 0) {
+	    fprintf(stderr, "Option -t requires a directory.\n");
+	    exit(1);
+	  }
+	  tmpdir = argv[arg+1];
+	  break;
+	case 'b':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%d", &buckets) != 1 ||
+		buckets < 1 || buckets > 4096) {
+	    fprintf(stderr, "Option -b requires a number of buckets up to 4096.\n");
+	    exit(1);
+	  }
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
+}
+
+/* 128 bit hash, four 64 bit lanes over 32 byte stripes folded into
+   two outputs; fast rather than cryptographic */
+#define PRIME1 0x9e3779b185ebca87ULL
+#define PRIME2 0xc2b2ae3d27d4eb4fULL
+#define PRIME3 0x165667b19e3779f9ULL
+
+static uint64_t rotl(uint64_t v, int r)
+{
+  return (v << r) | (v >> (64 - r));
+}
+
+static uint64_t lane(uint64_t acc, uint64_t v)
+{
+  return rotl(acc + v * PRIME2, 31) * PRIME1;
+}
+
+static uint64_t load64(const unsigned char *p)
+{
+  uint64_t v;
+
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static uint64_t avalanche(uint64_t h)
+{
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME3;
+  h ^= h >> 32;
+  return h;
+}
+
+void dedup_hash(const unsigned char *p, long len, uint64_t hash[2])
+{
+  uint64_t v1 = PRIME1 + PRIME2, v2 = PRIME2, v3 = 0, v4 = -PRIME1;
+  uint64_t h1, h2;
+  long i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    v1 = lane(v1, load64(p + i));
+    v2 = lane(v2, load64(p + i + 8));
+    v3 = lane(v3, load64(p + i + 16));
+    v4 = lane(v4, load64(p + i + 24));
+  }
+  h1 = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18) + len;
+  h2 = rotl(v4, 1) + rotl(v3, 7) + rotl(v2, 12) + rotl(v1, 18) + PRIME3;
+  for (; i + 8 <= len; i += 8) {
+    h1 = rotl(h1 ^ lane(0, load64(p + i)), 27) * PRIME1 + PRIME3;
+    h2 = rotl(h2 ^ lane(PRIME3, load64(p + i)), 29) * PRIME2 + PRIME1;
+  }
+  for (; i < len; i++) {
+    h1 = rotl(h1 ^ (p[i] * PRIME3), 11) * PRIME1;
+    h2 = rotl(h2 ^ (p[i] * PRIME1), 13) * PRIME2;
+  }
+  hash[0] = avalanche(h1);
+  hash[1] = avalanche(h2 ^ h1);
+}
+
+/* move this thread's gathered entries to the bucket files */
+void flush_batch(dedup_index *index)
+{
+  int i, b;
+
+  pthread_mutex_lock(&index->lock);
+  for (i = 0; i < batch.count; i++) {
+    b = batch.entries[i].hash[0] % index->buckets;
+    if (fwrite(&batch.entries[i], sizeof(dedup_entry), 1,
+	index->pages[b]) != 1)
+      index->failed = 1;
+  }
+  pthread_mutex_unlock(&index->lock);
+  batch.count = 0;
+}
+
+int hash_page(void *data, int file, long long offset, rogg_page_header *header)
+{
+  dedup_index *index = data;
+  dedup_file *f = &index->files[file];
+  dedup_entry *e = &batch.entries[batch.count++];
+
+  /* from the segment count to the end of the body */
+  dedup_hash(header->capture + ROGG_OFFSET_SEGMENTS,
+	header->length - ROGG_OFFSET_SEGMENTS, e->hash);
+  e->offset = offset;
+  e->file = file;
+  e->length = header->length;
+  f->bytes += header->length;
+  if (batch.count == DEDUP_BATCH) flush_batch(index);
+
+  return 0;
+}
+
+void hash_done(void *data, int file, rogg_framer *framer, int error)
+{
+  dedup_index *index = data;
+  dedup_file *f = &index->files[file];
+
+  /* the reader thread may finish after this file */
+  if (batch.count) flush_batch(index);
+  if (error) {
+    fprintf(stderr, "%s: read error: %s\n", f->name, strerror(error));
+  } else if (framer->pages == 0) {
+    fprintf(stderr, "%s: couldn't find ogg data!\n", f->name);
+  }
+}
+
+int compare_entries(const void *a, const void *b)
+{
+  const dedup_entry *x = a, *y = b;
+
+  if (x->hash[0] != y->hash[0]) return x->hash[0] < y->hash[0] ? -1 : 1;
+  if (x->hash[1] != y->hash[1]) return x->hash[1] < y->hash[1] ? -1 : 1;
+  if (x->length != y->length) return x->length < y->length ? -1 : 1;
+  if (x->file != y->file) return x->file < y->file ? -1 : 1;
+  if (x->offset != y->offset) return x->offset < y->offset ? -1 : 1;
+  return 0;
+}
+
+int compare_matches(const void *a, const void *b)
+{
+  const dedup_match *x = a, *y = b;
+
+  if (x->file != y->file) return x->file < y->file ? -1 : 1;
+  if (x->offset != y->offset) return x->offset < y->offset ? -1 : 1;
+  return 0;
+}
+
+/* read a whole bucket file into memory */
+void *load_bucket(FILE *fp, size_t size, long *count)
+{
+  void *data;
+  long len;
+
+  if (fflush(fp) || fseek(fp, 0, SEEK_END) || (len = ftell(fp)) < 0)
+    return NULL;
+  *count = len / size;
+  data = malloc(len ? len : 1);
+  if (data == NULL) return NULL;
+  rewind(fp);
+  if (*count && fread(data, size, *count, fp) != (size_t)*count) {
+    free(data);
+    return NULL;
+  }
+  return data;
+}
+
+/* matches for every page in a bucket whose hash was seen earlier */
+int match_bucket(dedup_index *index, int b)
+{
+  dedup_entry *entries;
+  dedup_match m;
+  long count, i, first = 0;
+
+  entries = load_bucket(index->pages[b], sizeof(*entries), &count);
+  if (entries == NULL) return -1;
+  qsort(entries, count, sizeof(*entries), compare_entries);
+  memset(&m, 0, sizeof(m));
+  for (i = 1; i < count; i++) {
+    if (memcmp(entries[i].hash, entries[first].hash, sizeof(entries[i].hash)) ||
+	entries[i].length != entries[first].length) {
+      first = i;
+      continue;
+    }
+    m.offset = entries[i].offset;
+    m.file = entries[i].file;
+    m.length = entries[i].length;
+    m.src_offset = entries[first].offset;
+    m.src_file = entries[first].file;
+    /* files are split between match buckets in order */
+    if (fwrite(&m, sizeof(m), 1, index->matches[
+	(long long)m.file * index->buckets / index->nfiles]) != 1) {
+      free(entries);
+      return -1;
+    }
+  }
+  free(entries);
+  return 0;
+}
+
+void report_range(dedup_index *index, dedup_match *run, long long end,
+	long long src_end)
+{
+  long long len = end - run->offset;
+
+  index->files[run->file].shared += len;
+  if (len < min_range) return;
+  fprintf(stdout, "%s %lld-%lld (%lld bytes) matches %s %lld-%lld\n",
+	index->files[run->file].name, (long long)run->offset, end, len,
+	index->files[run->src_file].name, (long long)run->src_offset, src_end);
+}
+
+/* join the matches of a bucket into ranges */
+int report_bucket(dedup_index *index, int b)
+{
+  dedup_match *matches, run;
+  long count, i;
+  long long end = 0, src_end = 0;
+
+  matches = load_bucket(index->matches[b], sizeof(*matches), &count);
+  if (matches == NULL) return -1;
+  qsort(matches, count, sizeof(*matches), compare_matches);
+  for (i = 0; i < count; i++) {
+    if (i && matches[i].file == run.file && matches[i].offset == end &&
+	matches[i].src_file == run.src_file &&
+	matches[i].src_offset == src_end) {
+      end += matches[i].length;
+      src_end += matches[i].length;
+      continue;
+    }
+    if (i) report_range(index, &run, end, src_end);
+    run = matches[i];
+    end = run.offset + run.length;
+    src_end = run.src_offset + run.length;
+  }
+  if (count) report_range(index, &run, end, src_end);
+  free(matches);
+  return 0;
+}
+
+/* one thread's share of the page buckets */
+typedef struct {
+  dedup_index *index;
+  int next, step;
+  int failed;
+} bucket_work;
+
+void *match_work(void *data)
+{
+  bucket_work *w = data;
+  int b;
+
+  for (b = w->next; b < w->index->buckets; b += w->step) {
+    if (match_bucket(w->index, b) < 0) w->failed = 1;
+  }
+  return NULL;
+}
+
+/* open the bucket files, unlinked so they go away however we exit */
+FILE **open_buckets(const char *dir, const char *kind, int n)
+{
+  FILE **files = calloc(n, sizeof(*files));
+  char *path;
+  int i, fd;
+
+  path = malloc(strlen(dir) + strlen(kind) + 16);
+  if (files == NULL || path == NULL) {
+    free(files);
+    free(path);
+    return NULL;
+  }
+  for (i = 0; i < n; i++) {
+    sprintf(path, "%s/rogg_%s.XXXXXX", dir, kind);
+    fd = mkstemp(path);
+    if (fd >= 0) {
+      unlink(path);
+      files[i] = fdopen(fd, "w+b");
+    }
+    if (files[i] == NULL) {
+      fprintf(stderr, "couldn't create an index file in '%s'\n", dir);
+      if (fd >= 0) close(fd);
+      while (i--) fclose(files[i]);
+      free(files);
+      free(path);
+      return NULL;
+    }
+  }
+  free(path);
+  return files;
+}
+
+void close_buckets(FILE **files, int n)
+{
+  int i;
+
+  if (files == NULL) return;
+  for (i = 0; i < n; i++) fclose(files[i]);
+  free(files);
+}
+
+int main(int argc, char *argv[])
+{
+  rogg_reader reader;
+  dedup_index index;
+  bucket_work *work;
+  pthread_t *tids;
+  long long total = 0, shared = 0;
+  int i, started, ret = 0;
+
+  parse_args(&argc, argv);
+  if (argc < 2) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+  if (!threads) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? cpus : 1;
+  }
+  if (tmpdir == NULL) tmpdir = getenv("TMPDIR");
+  if (tmpdir == NULL) tmpdir = "/tmp";
+
+  memset(&index, 0, sizeof(index));
+  index.nfiles = argc - 1;
+  index.buckets = buckets;
+  index.files = calloc(index.nfiles, sizeof(*index.files));
+  if (index.files == NULL) {
+    fprintf(stderr, "couldn't allocate file list\n");
+    exit(1);
+  }
+  for (i = 0; i < index.nfiles; i++) index.files[i].name = argv[i+1];
+  index.pages = open_buckets(tmpdir, "pages", buckets);
+  index.matches = open_buckets(tmpdir, "matches", buckets);
+  if (index.pages == NULL || index.matches == NULL) exit(1);
+  pthread_mutex_init(&index.lock, NULL);
+
+  /* hash every page into the index */
+  rogg_reader_init(&reader);
+  reader.backend = ROGG_READER_THREADS;
+  reader.depth = threads;
+  reader.page = hash_page;
+  reader.done = hash_done;
+  reader.data = &index;
+  if (rogg_reader_run(&reader, index.nfiles, argv + 1) < 0) {
+    fprintf(stderr, "couldn't start the reader\n");
+    exit(1);
+  }
+  if (index.failed) {
+    fprintf(stderr, "couldn't write the index\n");
+    exit(1);
+  }
+
+  /* find the repeated pages, a bucket per thread at a time */
+  work = calloc(threads, sizeof(*work));
+  tids = calloc(threads, sizeof(*tids));
+  if (work == NULL || tids == NULL) exit(1);
+  for (i = 0; i < threads; i++) {
+    work[i].index = &index;
+    work[i].next = i;
+    work[i].step = threads;
+  }
+  for (started = 1; started < threads; started++) {
+    if (pthread_create(&tids[started], NULL, match_work, &work[started]))
+      break;
+  }
+  match_work(&work[0]);
+  for (i = 1; i < started; i++) pthread_join(tids[i], NULL);
+  for (; i < threads; i++) match_work(&work[i]);
+  for (i = 0; i < threads; i++) {
+    if (work[i].failed) ret = 1;
+  }
+  free(work);
+  free(tids);
+  close_buckets(index.pages, buckets);
+  if (ret) {
+    fprintf(stderr, "couldn't sort the index\n");
+    exit(1);
+  }
+
+  /* and the ranges they make up, file by file */
+  for (i = 0; i < buckets; i++) {
+    if (report_bucket(&index, i) < 0) {
+      fprintf(stderr, "couldn't read the index\n");
+      ret = 1;
+    }
+  }
+  close_buckets(index.matches, buckets);
+
+  for (i = 0; i < index.nfiles; i++) {
+    if (!index.files[i].bytes) continue;
+    fprintf(stdout, "%s: %lld of %lld page bytes found earlier\n",
+	index.files[i].name, index.files[i].shared, index.files[i].bytes);
+    total += index.files[i].bytes;
+    shared += index.files[i].shared;
+  }
+  fprintf(stdout, "total: %lld of %lld page bytes duplicated\n", shared, total);
+
+  pthread_mutex_destroy(&index.lock);
+  free(index.files);
+  if (show_counters) rogg_counters_report(stderr);
+  return ret;
+}
@@ -0,0 +1,359 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* in place edits of Theora, Kate and Opus identification headers */
+
+/* Only fields of fixed size are changed, so each edit touches just the
+   bos page and its crc, plus for Opus the padding of the comment
+   header. The streams looked at are those of the first link. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rogg.h"
+
+/* big endian accessors for the theora header */
+static int get16be(unsigned char *data)
+{
+  return (data[0] << 8) | data[1];
+}
+static int get24be(unsigned char *data)
+{
+  return (data[0] << 16) | (data[1] << 8) | data[2];
+}
+static int get32be(unsigned char *data)
+{
+  return (int)(((uint32_t)data[0] << 24) | (data[1] << 16) |
+	(data[2] << 8) | data[3]);
+}
+static void put24be(unsigned char *data, int v)
+{
+  data[0] = (v >> 16) & 0xFF;
+  data[1] = (v >>  8) & 0xFF;
+  data[2] = v & 0xFF;
+}
+static void put32be(unsigned char *data, int v)
+{
+  data[0] = (v >> 24) & 0xFF;
+  data[1] = (v >> 16) & 0xFF;
+  data[2] = (v >>  8) & 0xFF;
+  data[3] = v & 0xFF;
+}
+
+/* little endian ones for kate and opus */
+static int get16le(unsigned char *data)
+{
+  return data[0] | (data[1] << 8);
+}
+static int get32le(unsigned char *data)
+{
+  return (int)(data[0] | (data[1] << 8) | (data[2] << 16) |
+	((uint32_t)data[3] << 24));
+}
+static void put16le(unsigned char *data, int v)
+{
+  data[0] = v & 0xFF;
+  data[1] = (v >> 8) & 0xFF;
+}
+
+/* the next bos page of the first link at or after *q with the given
+   codec, moving *q past it; NULL when there are no more */
+static unsigned char *edit_next(unsigned char *p, unsigned char **q,
+	unsigned char *e, int codec, rogg_page_header *header,
+	const rogg_hooks *hooks)
+{
+  rogg_stream_info info;
+  unsigned char *o;
+
+  while ((o = rogg_page_walk(p, *q, e, header, hooks)) != NULL) {
+    if (!header->bos) break;
+    *q = o + header->length;
+    if (rogg_stream_info_init(&info, header) == codec) return o;
+  }
+  *q = e;
+
+  return NULL;
+}
+
+/* room for one more entry in a list of n taken from an arena */
+static void *edit_grow(rogg_arena *arena, void *list, int n, size_t size)
+{
+  /* grow in steps of powers of two */
+  if (n && (n & (n - 1))) return list;
+  return rogg_arena_grow(arena, list, n * size, (n ? 2 * n : 1) * size);
+}
+
+static void theora_info(unsigned char *data, rogg_theora_info *info)
+{
+  info->version[0] = data[7];
+  info->version[1] = data[8];
+  info->version[2] = data[9];
+  info->full_width = get16be(data + 10) << 4;
+  info->full_height = get16be(data + 12) << 4;
+  info->width = get24be(data + 14);
+  info->height = get24be(data + 17);
+  info->x = data[20];
+  info->y = info->full_height - info->height - data[21];
+  info->fps_num = get32be(data + 22);
+  info->fps_den = get32be(data + 26);
+  info->aspect_num = get24be(data + 30);
+  info->aspect_den = get24be(data + 33);
+  info->colorspace = data[36];
+  info->bitrate = get24be(data + 37);
+  info->quality = data[40] >> 2;
+  info->shift = ((data[40] & 0x03) << 3) | (data[41] >> 5);
+}
+
+int rogg_theora_edit(unsigned char *p, long len,
+	const rogg_theora_options *opts, rogg_arena *arena,
+	rogg_theora_result *result)
+{
+  unsigned char *q = p, *e = p + len, *o, *data;
+  rogg_page_header header;
+  rogg_theora_stream *s;
+  int x, y;
+
+  memset(result, 0, sizeof(*result));
+  while ((o = edit_next(p, &q, e, ROGG_CODEC_THEORA, &header,
+	&opts->hooks)) != NULL) {
+    s = edit_grow(arena, result->streams, result->count, sizeof(*s));
+    if (s == NULL) return -1;
+    result->streams = s;
+    s = &result->streams[result->count++];
+    memset(s, 0, sizeof(*s));
+    s->serialno = header.serialno;
+    s->offset = o - p;
+    data = header.data;
+    theora_info(data, &s->before);
+    if (opts->crop_set) {
+      /* a '-' origin is from the far edge of this image */
+      x = opts->crop_xoffset;
+      y = opts->crop_yoffset;
+      if (opts->crop_xorigin == '-')
+	x = s->before.full_width - opts->crop_width - x;
+      if (opts->crop_yorigin == '-')
+	y = s->before.full_height - opts->crop_height - y;
+      if (x < 0 || x + opts->crop_width > s->before.full_width ||
+	  y < 0 || y + opts->crop_height > s->before.full_height) {
+	s->bad_crop = 1;
+      } else {
+	put24be(data + 14, opts->crop_width);
+	put24be(data + 17, opts->crop_height);
+	data[20] = x;
+	data[21] = s->before.full_height - opts->crop_height - y;
+	s->changed = 1;
+      }
+    }
+    if (opts->aspect_set) {
+      put24be(data + 30, opts->aspect_num);
+      put24be(data + 33, opts->aspect_den);
+      s->changed = 1;
+    }
+    if (opts->fps_set) {
+      put32be(data + 22, opts->fps_num);
+      put32be(data + 26, opts->fps_den);
+      s->changed = 1;
+    }
+    if (s->changed) rogg_page_update_crc(o);
+    theora_info(data, &s->after);
+  }
+
+  return 0;
+}
+
+static void kate_info(unsigned char *data, rogg_kate_info *info)
+{
+  info->major = data[9];
+  info->minor = data[10];
+  memcpy(info->language, data + 32, 16);
+  info->language[15] = 0;
+  memcpy(info->category, data + 48, 16);
+  info->category[15] = 0;
+  info->canvas_width = ((data[16] & 0xf) | (data[17] << 4)) << (data[16] >> 4);
+  info->canvas_height = ((data[18] & 0xf) | (data[19] << 4)) << (data[18] >> 4);
+  info->fps_num = get32le(data + 24);
+  info->fps_den = get32le(data + 28);
+}
+
+/* a canvas dimension as a 12 bit base and 4 bit shift, returns -1 if
+   it can't be stored without losing low bits */
+static int kate_canvas(int size, unsigned char *out)
+{
+  unsigned int base = size;
+  int shift = 0;
+
+  if (size < 0) return -1;
+  while (base & ~((1u << 12) - 1)) {
+    /* a high bit we can't fit; shifting mustn't lose a low one */
+    if (base & 1) return -1;
+    shift++;
+    base >>= 1;
+  }
+  if (shift >= 16) return -1;
+  out[0] = (shift << 4) | (base & 0xf);
+  out[1] = base >> 4;
+
+  return 0;
+}
+
+int rogg_kate_edit(unsigned char *p, long len,
+	const rogg_kate_options *opts, rogg_arena *arena,
+	rogg_kate_result *result)
+{
+  unsigned char *q = p, *e = p + len, *o, *data;
+  unsigned char width[2], height[2];
+  rogg_page_header header;
+  rogg_kate_stream *s;
+
+  memset(result, 0, sizeof(*result));
+  if ((opts->language != NULL && strlen(opts->language) > 15) ||
+      (opts->category != NULL && strlen(opts->category) > 15)) return -1;
+  if (opts->canvas_set && (kate_canvas(opts->canvas_width, width) < 0 ||
+	kate_canvas(opts->canvas_height, height) < 0)) return -1;
+
+  while ((o = edit_next(p, &q, e, ROGG_CODEC_KATE, &header,
+	&opts->hooks)) != NULL) {
+    s = edit_grow(arena, result->streams, result->count, sizeof(*s));
+    if (s == NULL) return -1;
+    result->streams = s;
+    s = &result->streams[result->count++];
+    memset(s, 0, sizeof(*s));
+    s->serialno = header.serialno;
+    s->offset = o - p;
+    data = header.data;
+    kate_info(data, &s->before);
+    if (opts->canvas_set) {
+      memcpy(data + 16, width, 2);
+      memcpy(data + 18, height, 2);
+      s->changed = 1;
+    }
+    if (opts->language != NULL) {
+      memset(data + 32, 0, 16);
+      memcpy(data + 32, opts->language, strlen(opts->language));
+      s->changed = 1;
+    }
+    if (opts->category != NULL) {
+      memset(data + 48, 0, 16);
+      memcpy(data + 48, opts->category, strlen(opts->category));
+      s->changed = 1;
+    }
+    if (s->changed) rogg_page_update_crc(o);
+    kate_info(data, &s->after);
+  }
+
+  return 0;
+}
+
+static void opus_info(unsigned char *data, rogg_opus_info *info)
+{
+  info->version = data[8];
+  info->channels = data[9];
+  info->preskip = get16le(data + 10);
+  info->input_rate = get32le(data + 12);
+  info->gain = (short)get16le(data + 16);
+  info->mapping = data[18];
+}
+
+/* record the track gain in the tags packet, if it fits in the space
+   the packet already has. Returns 0 on success, 1 if there wasn't
+   room, -1 on errors. */
+static int opus_track_gain(unsigned char *p, long len, uint32_t serialno,
+	int track, rogg_arena *arena)
+{
+  rogg_headers headers;
+  rogg_comments c;
+  unsigned char *data[2];
+  long lengths[2];
+  char tag[32];
+  int i, ret = -1;
+
+  if (rogg_headers_read_arena(&headers, arena, p, len, serialno, 2) < 0)
+    return -1;
+  for (i = 0; i < 2; i++) {
+    lengths[i] = headers.packets[i].length;
+    data[i] = rogg_arena_alloc(arena, lengths[i]);
+    if (data[i] == NULL) goto out;
+    rogg_packet_copy(&headers.packets[i], data[i]);
+  }
+  if (rogg_comments_parse(&c, ROGG_CODEC_OPUS, data[1], lengths[1]) < 0)
+    goto clear;
+  snprintf(tag, sizeof(tag), "R128_TRACK_GAIN=%d", track);
+  rogg_comments_delete(&c, "R128_TRACK_GAIN");
+  if (rogg_comments_add(&c, (unsigned char *)tag, strlen(tag)) < 0) goto clear;
+
+  /* binary data has to stay at the end, so only padding can be used */
+  if (rogg_comments_size(&c) > lengths[1] ||
+	(c.extra_len && rogg_comments_size(&c) != lengths[1])) {
+    ret = 1;
+    goto clear;
+  }
+  data[1] = rogg_arena_alloc(arena, lengths[1]);
+  if (data[1] == NULL) goto clear;
+  rogg_comments_write(&c, data[1], lengths[1]);
+  /* same lengths, so this is always an update in place */
+  ret = rogg_headers_write(&headers, NULL, -1, p, len, data, lengths);
+  if (ret != 0) ret = -1;
+
+clear:
+  rogg_comments_clear(&c);
+out:
+  rogg_headers_clear(&headers);
+  return ret;
+}
+
+int rogg_opus_edit(unsigned char *p, long len,
+	const rogg_opus_options *opts, rogg_arena *arena,
+	rogg_opus_result *result)
+{
+  unsigned char *q = p, *e = p + len, *o;
+  rogg_page_header header;
+  rogg_opus_stream *s;
+
+  memset(result, 0, sizeof(*result));
+  while ((o = edit_next(p, &q, e, ROGG_CODEC_OPUS, &header,
+	&opts->hooks)) != NULL) {
+    s = edit_grow(arena, result->streams, result->count, sizeof(*s));
+    if (s == NULL) return -1;
+    result->streams = s;
+    s = &result->streams[result->count++];
+    memset(s, 0, sizeof(*s));
+    s->serialno = header.serialno;
+    s->offset = o - p;
+    opus_info(header.data, &s->before);
+    if (opts->gain_set) {
+      put16le(header.data + 16, opts->gain);
+      rogg_page_update_crc(o);
+    }
+    opus_info(header.data, &s->after);
+    if (opts->track_set)
+      s->track = opus_track_gain(p, len, s->serialno, opts->track, arena);
+  }
+
+  return 0;
+}
@@ -25,15 +25,18 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-/* simple script example for the rogg library */
+/* simple script example for the rogg library; the work is done by
+   rogg_eos_fix, this only handles files and messages */
 
 /* compile with
-   gcc -O2 -g -Wall -I. -o rogg_eosfix rogg.c rogg_eosfix.c
+   gcc -O2 -g -Wall -I. -o rogg_eosfix rogg.c rogg_arena.c rogg_codec.c \
+	rogg_fix.c rogg_eosfix.c -lpthread
 */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -43,104 +46,92 @@
 
 #include <rogg.h>
 
-typedef struct _streamref {
-  uint32_t serialno;
-  unsigned char *first;
-  unsigned char *last;
-  struct _streamref *next;
-} streamref;
+int show_counters = 0;
+int tail_first = 0;
 
-void print_header_info(FILE *out, rogg_page_header *header)
-{
-  fprintf(out, " Ogg page serial %08x seq %d (%5d bytes)",
-	header->serialno, header->sequenceno, header->length);
-  fprintf(out, (header->continued) ? " c" : "  ");
-  fprintf(out, " %lld", (long long int)header->granulepos);
-  fprintf(out, (header->bos) ? " bos" : "");
-  fprintf(out, (header->eos) ? " eos" : "");
-  fprintf(out, "\n");
-}
-
-streamref *streamref_new(streamref *head, rogg_page_header *page)
-{
-  streamref *ref;
-
-  ref = malloc(sizeof(*ref));
-  if (ref != NULL) {
-    ref->serialno = page->serialno;
-    ref->first = page->capture;
-    ref->last = NULL;
-    ref->next = head;
-  }
+/* the file being checked, for messages about skipped bytes */
+typedef struct {
+  FILE *out;
+  long long len;
+} skip_report;
 
-  return (ref != NULL) ? ref : head;
-}
-
-streamref *streamref_get(streamref *head, rogg_page_header *page)
+void report_skip(void *data, long long offset, long long len)
 {
-  streamref *ref = head;
-
-  while(ref != NULL) {
-    if (ref->serialno == page->serialno) return ref;
-    ref = ref->next;
-  }
-
-  return NULL;
+  skip_report *r = data;
+
+  if (offset == 0)
+    fprintf(r->out, "Skipped %d garbage bytes at the start\n", (int)len);
+  else if (offset + len == r->len)
+    fprintf(r->out, "Skipped %d garbage bytes as the end\n", (int)len);
+  else
+    fprintf(r->out, "Hole in data! skipped %d bytes\n", (int)len);
 }
 
-streamref *streamref_update(streamref *head, rogg_page_header *page)
-{
-  streamref *ref;
-  int newhead = 0;
-
-  ref = streamref_get(head, page);
-  if (ref == NULL) {
-	fprintf(stderr, "new logical stream serialno %08x\n", 
-		page->serialno);
-	ref = streamref_new(head, page);
-	newhead = 1;
-  }
-
-  ref->last = page->capture;
-
-  return newhead ? ref : head;
-}
-
-void streamref_free(streamref *head)
+#ifdef VERBOSE
+void report_page(void *data, long long offset, rogg_page_header *header)
 {
-  streamref *next, *ref = head;
-
-  while(ref != NULL) {
-	next = ref->next;
-	free(ref);
-	ref = next;
-  }
+  rogg_page_print(stdout, header);
 }
+#endif
 
-void streamref_seteos(streamref *head)
+int parse_args(int *argc, char *argv[])
 {
-  streamref *ref = head;
-  rogg_page_header header;
-
-  while (ref != NULL) {
-    rogg_page_parse(ref->last, &header);
-    if (!header.eos) {
-	fprintf(stderr, "setting missing eos on stream %08x\n",
-	  header.serialno);
-	ref->last[ROGG_OFFSET_FLAGS] |= 0x04;
-	rogg_page_update_crc(ref->last);
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 't':
+	  tail_first = 1;
+	  shift = 1;
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
     }
-    ref = ref->next;
   }
+
+  return 0;
 }
 
 int main(int argc, char *argv[])
 {
-  int f, i;
-  unsigned char *p, *q, *o, *e;
+  int f, i, j, ret;
+  unsigned char *p;
   struct stat s;
-  rogg_page_header header;
-  streamref *refs;
+  rogg_eos_options opts;
+  rogg_eos_result result;
+  rogg_arena arena;
+  skip_report report;
+
+  parse_args(&argc, argv);
+  rogg_arena_init(&arena, 4096);
+  memset(&opts, 0, sizeof(opts));
+  opts.tail_first = tail_first;
+#ifdef STRIP_EOS
+  opts.strip = 1;
+#endif
+  opts.hooks.skip = report_skip;
+#ifdef VERBOSE
+  opts.hooks.page = report_page;
+#endif
+  opts.hooks.data = &report;
+  report.out = stdout;
 
   for (i = 1; i < argc; i++) {
     f = open(argv[i], O_RDWR);
@@ -161,47 +152,38 @@ int main(int argc, char *argv[])
 	continue;
     }
     fprintf(stdout, "Checking Ogg file '%s'\n", argv[i]);
-    e = p + s.st_size; /* pointer to the end of the file */
-    q = rogg_scan(p, s.st_size); /* scan for an Ogg page */
-    refs = NULL;
-    if (q == NULL) {
+    report.len = s.st_size;
+    ret = rogg_eos_fix(p, s.st_size, &opts, &arena, &result);
+    if (ret == ROGG_NO_PAGES) {
 	fprintf(stdout, "couldn't find ogg data!\n");
+    } else if (ret < 0) {
+	fprintf(stderr, "couldn't allocate stream list\n");
     } else {
-      if (q > p) {
-	fprintf(stdout, "Skipped %d garbage bytes at the start\n", (int)(q-p));
-      } 
-      while (q < e) {
-	o = rogg_scan(q, e-q); /* find the next Ogg page */
-	if (o > q) {
-	  fprintf(stdout, "Hole in data! skipped %d bytes\n", (int)(o-q));
-	   q = o;
-	} else if (o == NULL) {
-	  fprintf(stdout, "Skipped %d garbage bytes as the end\n", (int)(e-q));
-	  break;
-	}
-	rogg_page_parse(q, &header);
-#ifdef VERBOSE
-	print_header_info(stdout, &header);
-#endif
-#ifdef STRIP_EOS
-	if (header.eos) {
-	  /* unset any eos flags */
-	  q[ROGG_OFFSET_FLAGS] &= ~0x04;
-	  rogg_page_update_crc(q);
-	  fprintf(stderr, "Removed eos flag on stream %08x\n",
-		header.serialno);
-        }
-#endif
-	refs = streamref_update(refs, &header);
-	q += header.length;
+      if (tail_first && result.tail < 0)
+	fprintf(stdout, "Not every stream ends in the tail, "
+		"checked the whole file\n");
+      else if (result.tail >= 0)
+	fprintf(stdout, "Found the last pages in the final %lld bytes\n",
+		result.tail);
+      for (j = 0; result.tail < 0 && j < result.count; j++)
+	fprintf(stderr, "new logical stream serialno %08x\n",
+		result.streams[j].serialno);
+      for (j = 0; j < result.count; j++) {
+	rogg_eos_stream *st = &result.streams[j];
+	if (!st->changed) continue;
+	if (opts.strip)
+	  fprintf(stderr, "Removed %ld eos flags on stream %08x\n",
+		st->changed, st->serialno);
+	else
+	  fprintf(stderr, "setting missing eos on stream %08x\n",
+		st->serialno);
       }
     }
-#ifndef STRIP_EOS
-    streamref_seteos(refs);
-#endif
-    streamref_free(refs);
+    rogg_arena_reset(&arena);
     munmap(p, s.st_size);
     close(f);
   }
+  rogg_arena_clear(&arena);
+  if (show_counters) rogg_counters_report(stderr);
   return 0;
 }
@@ -0,0 +1,600 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* in place rewrites of whole files: eos flags, serial numbers and
+   granule positions */
+
+/* The serial and granule passes split the buffer between threads.
+   Serial changes go by byte ranges, each thread taking the pages
+   starting in its range, found with a crc check so a range can begin
+   part way through a page. Granule changes are planned first, walking
+   the pages once to check that no adjusted granulepos would become -1
+   or otherwise negative, and only then are the planned pages divided
+   between threads to be rewritten. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "rogg.h"
+
+/* smallest range worth a thread of its own */
+#define ROGG_FIX_CHUNK (1024*1024)
+
+/* most threads a granule commit is split between */
+#define ROGG_FIX_THREADS 64
+
+/* the entry for serialno in a list of eos streams, added if new */
+static rogg_eos_stream *eos_stream(rogg_arena *arena, rogg_eos_result *r,
+	int *room, uint32_t serialno)
+{
+  rogg_eos_stream *s;
+  int i;
+
+  for (i = 0; i < r->count; i++) {
+    if (r->streams[i].serialno == serialno) return &r->streams[i];
+  }
+  if (r->count == *room) {
+    s = rogg_arena_grow(arena, r->streams, *room * sizeof(*s),
+	(*room * 2 + 8) * sizeof(*s));
+    if (s == NULL) return NULL;
+    r->streams = s;
+    *room = *room * 2 + 8;
+  }
+  s = &r->streams[r->count++];
+  s->serialno = serialno;
+  s->last = -1;
+  s->changed = 0;
+
+  return s;
+}
+
+/* find the last page of each stream by reading backwards from the end,
+   which on a long capture touches only the tail. The streams are those
+   with bos pages at the start; returns -1 if one can't be accounted
+   for, as in a chained file where the last link's streams are all
+   we'd find, so the caller can walk the whole buffer. */
+static int eos_tail(unsigned char *p, unsigned char *e, rogg_arena *arena,
+	rogg_eos_result *r, int *room)
+{
+  rogg_page_header header;
+  rogg_eos_stream *s;
+  unsigned char *q = p, *o;
+  int missing, i;
+
+  while ((o = rogg_page_find(q, e, &header)) != NULL && header.bos) {
+    if (eos_stream(arena, r, room, header.serialno) == NULL) return -1;
+    q = o + header.length;
+  }
+  missing = r->count;
+  if (!missing) return -1;
+
+  q = e;
+  while (missing && (o = rogg_page_find_back(p, q, e, &header)) != NULL) {
+    for (i = 0; i < r->count; i++) {
+      if (r->streams[i].serialno == header.serialno) break;
+    }
+    if (i == r->count) break;
+    s = &r->streams[i];
+    if (s->last < 0) {
+      s->last = o - p;
+      missing--;
+    }
+    q = o;
+  }
+  if (missing) return -1;
+
+  r->tail = e - q;
+  return 0;
+}
+
+int rogg_eos_fix(unsigned char *p, long len, const rogg_eos_options *opts,
+	rogg_arena *arena, rogg_eos_result *result)
+{
+  unsigned char *q = p, *e = p + len;
+  rogg_page_header header;
+  rogg_eos_stream *s;
+  unsigned char flags;
+  int room = 0, i;
+
+  memset(result, 0, sizeof(*result));
+  result->tail = -1;
+  if (opts->tail_first && !opts->strip &&
+      eos_tail(p, e, arena, result, &room) < 0) {
+    /* start over on the whole buffer */
+    result->count = 0;
+    result->tail = -1;
+  }
+
+  if (result->tail < 0) {
+    while ((q = rogg_page_walk(p, q, e, &header, &opts->hooks)) != NULL) {
+      s = eos_stream(arena, result, &room, header.serialno);
+      if (s == NULL) return -1;
+      s->last = q - p;
+      if (opts->strip && header.eos) {
+	flags = q[ROGG_OFFSET_FLAGS] & ~0x04;
+	rogg_page_patch_crc(q, ROGG_OFFSET_FLAGS, NULL, &flags, 1);
+	s->changed++;
+      }
+      q += header.length;
+    }
+    if (!result->count) return ROGG_NO_PAGES;
+  }
+
+  if (!opts->strip) {
+    for (i = 0; i < result->count; i++) {
+      q = p + result->streams[i].last;
+      if (!(q[ROGG_OFFSET_FLAGS] & 0x04)) {
+	flags = q[ROGG_OFFSET_FLAGS] | 0x04;
+	rogg_page_patch_crc(q, ROGG_OFFSET_FLAGS, NULL, &flags, 1);
+	result->streams[i].changed++;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* a growing list of serial pairs, from an arena or the heap, with
+   the offset of each stream's bos page when it was found in a pass */
+typedef struct {
+  rogg_serial_pair *pairs;
+  long long *from;
+  int count, room;
+} serial_map;
+
+static rogg_serial_pair *map_find(const rogg_serial_pair *pairs, int count,
+	uint32_t serial)
+{
+  int i;
+
+  for (i = 0; i < count; i++) {
+    if (pairs[i].old_serial == serial) return (rogg_serial_pair *)&pairs[i];
+  }
+  return NULL;
+}
+
+/* add a stream starting at offset from, keeping the first entry for
+   a serial; lists are added to in order, so that's the earliest */
+static int map_add(serial_map *m, rogg_arena *arena, uint32_t old_serial,
+	long long from)
+{
+  rogg_serial_pair *pair;
+  long long *offsets;
+  int room = m->room * 2 + 16;
+
+  if (map_find(m->pairs, m->count, old_serial) != NULL) return 0;
+  if (m->count == m->room) {
+    if (arena != NULL) {
+      pair = rogg_arena_grow(arena, m->pairs, m->room * sizeof(*pair),
+	room * sizeof(*pair));
+      offsets = pair == NULL ? NULL : rogg_arena_grow(arena, m->from,
+	m->room * sizeof(*offsets), room * sizeof(*offsets));
+    } else {
+      pair = realloc(m->pairs, room * sizeof(*pair));
+      if (pair != NULL) m->pairs = pair;
+      offsets = pair == NULL ? NULL :
+	realloc(m->from, room * sizeof(*offsets));
+    }
+    if (pair == NULL || offsets == NULL) return -1;
+    m->pairs = pair;
+    m->from = offsets;
+    m->room = room;
+  }
+  m->from[m->count] = from;
+  m->pairs[m->count].old_serial = old_serial;
+  m->pairs[m->count++].new_serial = 0;
+  return 0;
+}
+
+/* one thread's share of a serial pass */
+typedef struct {
+  unsigned char *p, *start, *end, *e;
+  const rogg_serial_pair *pairs;
+  const long long *from;	/* where each pair applies, or NULL */
+  int count;
+  int collect;			/* note bos pages of unmapped streams */
+  long pages, changed;
+  long long garbage;		/* between this chunk's own pages */
+  unsigned char *first, *stop;	/* first page found, end of the last */
+  serial_map late;		/* unmapped streams, on the heap */
+  int failed;
+} serial_chunk;
+
+static void *serial_work(void *data)
+{
+  serial_chunk *c = data;
+  rogg_page_header header;
+  unsigned char *q = c->start, *o;
+  rogg_serial_pair *pair;
+  unsigned char serial[4];
+
+  while (q < c->end) {
+    o = rogg_page_find(q, c->e, &header);
+    if (o == NULL || o >= c->end) break;
+    /* gaps before the first page depend on where the last chunk
+       stopped, so they're counted when joining */
+    if (c->first == NULL) c->first = o;
+    else c->garbage += o - q;
+    c->pages++;
+    pair = map_find(c->pairs, c->count, header.serialno);
+    /* earlier pages with the serial belong to a stream which has
+       already been renamed to it */
+    if (pair != NULL && c->from != NULL && o - c->p < c->from[pair - c->pairs])
+      pair = NULL;
+    if (pair != NULL) {
+      if (pair->new_serial != header.serialno) {
+	rogg_write_uint32(serial, pair->new_serial);
+	rogg_page_patch_crc(o, ROGG_OFFSET_SERIALNO, NULL, serial, 4);
+	c->changed++;
+      }
+    } else if (c->collect && header.bos) {
+      if (map_add(&c->late, NULL, header.serialno, o - c->p) < 0)
+	c->failed = 1;
+    }
+    q = o + header.length;
+  }
+  c->stop = q;
+
+  rogg_counters_merge();
+  return NULL;
+}
+
+/* one pass over the buffer with the given pairs, in parallel ranges,
+   adding streams which start in later links to late. With from, each
+   pair only applies from that offset on. */
+static int serial_pass(unsigned char *p, long len, int threads,
+	const rogg_serial_pair *pairs, const long long *from, int count,
+	serial_map *late, rogg_arena *arena, rogg_serial_result *r)
+{
+  serial_chunk *chunks;
+  pthread_t *tids;
+  unsigned char *covered = p;
+  int n = threads > 0 ? threads : 1;
+  int i, j, started, ret = 0;
+
+  if (len / n < ROGG_FIX_CHUNK) n = len / ROGG_FIX_CHUNK + 1;
+  chunks = calloc(n, sizeof(*chunks));
+  tids = calloc(n, sizeof(*tids));
+  if (chunks == NULL || tids == NULL) {
+    free(chunks);
+    free(tids);
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    chunks[i].p = p;
+    chunks[i].start = p + len / n * i;
+    chunks[i].end = (i == n - 1) ? p + len : p + len / n * (i + 1);
+    chunks[i].e = p + len;
+    chunks[i].pairs = pairs;
+    chunks[i].from = from;
+    chunks[i].count = count;
+    chunks[i].collect = late != NULL;
+  }
+  for (started = 1; started < n; started++) {
+    if (pthread_create(&tids[started], NULL, serial_work, &chunks[started]))
+      break;
+  }
+  serial_work(&chunks[0]);
+  for (i = 1; i < started; i++) pthread_join(tids[i], NULL);
+  for (; i < n; i++) serial_work(&chunks[i]);
+
+  for (i = 0; i < n; i++) {
+    r->pages += chunks[i].pages;
+    r->changed += chunks[i].changed;
+    r->garbage += chunks[i].garbage;
+    if (chunks[i].first != NULL) {
+      if (chunks[i].first > covered) r->garbage += chunks[i].first - covered;
+      if (chunks[i].stop > covered) covered = chunks[i].stop;
+    }
+    if (chunks[i].failed) ret = -1;
+    for (j = 0; late != NULL && j < chunks[i].late.count; j++) {
+      if (map_add(late, arena, chunks[i].late.pairs[j].old_serial,
+	  chunks[i].late.from[j]) < 0)
+	ret = -1;
+    }
+    free(chunks[i].late.pairs);
+    free(chunks[i].late.from);
+  }
+  if (covered < p + len) r->garbage += p + len - covered;
+  free(chunks);
+  free(tids);
+  return ret;
+}
+
+/* splitmix64, so every call has its own sequence */
+static uint64_t serial_random(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/* pick a serial number for the next stream of m, different from the
+   ones already given out in m and other */
+static uint32_t serial_pick(int mode, uint64_t *state, uint32_t *next,
+	serial_map *m, int assigned, serial_map *other)
+{
+  uint32_t serial;
+  int i;
+
+  for (;;) {
+    if (mode == ROGG_SERIAL_RANDOM) {
+      serial = (uint32_t)serial_random(state);
+    } else {
+      serial = (*next)++;
+    }
+    for (i = 0; i < assigned; i++) {
+      if (m->pairs[i].new_serial == serial) break;
+    }
+    if (i < assigned) continue;
+    for (i = 0; other != NULL && i < other->count; i++) {
+      if (other->pairs[i].new_serial == serial) break;
+    }
+    if (other != NULL && i < other->count) continue;
+    return serial;
+  }
+}
+
+int rogg_serial_remap(unsigned char *p, long len,
+	const rogg_serial_options *opts, rogg_arena *arena,
+	rogg_serial_result *result)
+{
+  unsigned char *q, *e = p + len;
+  rogg_page_header header;
+  serial_map first = { NULL, NULL, 0, 0 };
+  serial_map late = { NULL, NULL, 0, 0 };
+  uint64_t state = opts->seed;
+  uint32_t next = opts->first;
+  long pages;
+  long long garbage;
+  int i;
+
+  memset(result, 0, sizeof(*result));
+  if (opts->mode == ROGG_SERIAL_MAP)
+    return serial_pass(p, len, opts->threads, opts->pairs, NULL,
+	opts->count, NULL, arena, result);
+
+  /* new serials for the streams of the first link */
+  for (q = rogg_page_find(p, e, &header); q != NULL && header.bos;
+	q = rogg_page_find(q + header.length, e, &header)) {
+    if (map_add(&first, arena, header.serialno, q - p) < 0) return -1;
+  }
+  for (i = 0; i < first.count; i++)
+    first.pairs[i].new_serial = serial_pick(opts->mode, &state, &next,
+	&first, i, NULL);
+  if (serial_pass(p, len, opts->threads, first.pairs, NULL, first.count,
+	&late, arena, result) < 0) return -1;
+
+  if (late.count) {
+    /* streams from later links, avoiding everything seen so far. The
+       first link may have been renamed to one of their old serials,
+       so they're only matched from their bos pages on; the pages they
+       change weren't touched by the first pass, so the counts add. */
+    for (i = 0; i < late.count; i++)
+      late.pairs[i].new_serial = serial_pick(opts->mode, &state, &next,
+	&late, i, &first);
+    pages = result->pages;
+    garbage = result->garbage;
+    if (serial_pass(p, len, opts->threads, late.pairs, late.from,
+	late.count, NULL, arena, result) < 0) return -1;
+    result->pages = pages;
+    result->garbage = garbage;
+  }
+
+  /* report the first link's streams, then the later ones */
+  result->assigned = rogg_arena_alloc(arena,
+	(first.count + late.count) * sizeof(*result->assigned));
+  if (result->assigned == NULL) return -1;
+  memcpy(result->assigned, first.pairs, first.count * sizeof(*first.pairs));
+  memcpy(result->assigned + first.count, late.pairs,
+	late.count * sizeof(*late.pairs));
+  result->count = first.count + late.count;
+
+  return 0;
+}
+
+/* what planning knows about a stream */
+typedef struct {
+  uint32_t serialno;
+  int headers;			/* header packets to skip */
+  long finished;		/* packets finished so far */
+  int64_t adjust;
+} granule_stream;
+
+/* one thread's share of the commit */
+typedef struct {
+  unsigned char *p;
+  long long *offsets;
+  long count;
+  granule_stream *streams;
+  int nstreams;
+} granule_work;
+
+/* the adjustment for a stream; the last matching one wins, with ones
+   for a particular serial number beating those for every stream */
+static int64_t granule_adjust(const rogg_granule_options *opts,
+	uint32_t serialno)
+{
+  int64_t adjust = 0;
+  int i, exact = 0;
+
+  for (i = 0; i < opts->count; i++) {
+    if (opts->adjust[i].all && !exact) {
+      adjust = opts->adjust[i].adjust;
+    } else if (!opts->adjust[i].all &&
+	opts->adjust[i].serialno == serialno) {
+      adjust = opts->adjust[i].adjust;
+      exact = 1;
+    }
+  }
+  return adjust;
+}
+
+static granule_stream *granule_find(const rogg_granule_options *opts,
+	rogg_arena *arena, granule_stream **streams, int *count, int *room,
+	rogg_page_header *header)
+{
+  granule_stream *s;
+  rogg_stream_info info;
+  int i;
+
+  for (i = 0; i < *count; i++) {
+    if ((*streams)[i].serialno == header->serialno) return &(*streams)[i];
+  }
+  if (*count == *room) {
+    s = rogg_arena_grow(arena, *streams, *room * sizeof(*s),
+	(*room * 2 + 8) * sizeof(*s));
+    if (s == NULL) return NULL;
+    *streams = s;
+    *room = *room * 2 + 8;
+  }
+  s = &(*streams)[(*count)++];
+  s->serialno = header->serialno;
+  s->finished = 0;
+  s->adjust = granule_adjust(opts, header->serialno);
+  s->headers = opts->headers;
+  if (s->headers < 0) {
+    rogg_stream_info_init(&info, header);
+    s->headers = info.headers >= 0 ? info.headers : 3;
+  }
+  return s;
+}
+
+static void *granule_commit(void *data)
+{
+  granule_work *w = data;
+  unsigned char *q;
+  uint64_t granulepos;
+  uint32_t serialno;
+  unsigned char buf[8];
+  long i;
+  int j;
+
+  for (i = 0; i < w->count; i++) {
+    q = w->p + w->offsets[i];
+    rogg_read_uint32(&q[ROGG_OFFSET_SERIALNO], &serialno);
+    for (j = 0; j < w->nstreams && w->streams[j].serialno != serialno; j++);
+    rogg_read_uint64(&q[ROGG_OFFSET_GRANULEPOS], &granulepos);
+    granulepos += (uint64_t)w->streams[j].adjust;
+    rogg_write_uint64(buf, granulepos);
+    rogg_page_patch_crc(q, ROGG_OFFSET_GRANULEPOS, NULL, buf, 8);
+  }
+
+  rogg_counters_merge();
+  return NULL;
+}
+
+/* stop planning with the reason */
+static int granule_fail(rogg_granule_result *r, int error,
+	uint32_t serialno, int64_t granulepos)
+{
+  r->error = error;
+  r->serialno = serialno;
+  r->granulepos = granulepos;
+  return -1;
+}
+
+int rogg_granule_shift(unsigned char *p, long len,
+	const rogg_granule_options *opts, rogg_arena *arena,
+	rogg_granule_result *result)
+{
+  unsigned char *q = p, *e = p + len;
+  rogg_page_header header;
+  granule_stream *streams = NULL, *s;
+  int nstreams = 0, sroom = 0;
+  long long *offsets = NULL, *o;
+  long room = 0;
+  uint64_t granulepos;
+  int64_t adjusted;
+  long before;
+  granule_work work[ROGG_FIX_THREADS];
+  pthread_t tids[ROGG_FIX_THREADS];
+  int n, i, started;
+
+  memset(result, 0, sizeof(*result));
+
+  /* plan: note the pages to change, giving up if any can't be */
+  while ((q = rogg_page_walk(p, q, e, &header, &opts->hooks)) != NULL) {
+    s = granule_find(opts, arena, &streams, &nstreams, &sroom, &header);
+    if (s == NULL) return granule_fail(result, ROGG_GRANULE_NOMEM, 0, 0);
+    before = s->finished;
+    s->finished += rogg_page_packets_ending(&header);
+    if (s->finished <= s->headers) {
+      q += header.length;
+      continue;
+    } else if (before < s->headers) {
+      return granule_fail(result, ROGG_GRANULE_HEADERS, s->serialno, 0);
+    }
+    granulepos = header.granulepos;
+    if (s->adjust && granulepos != ~(uint64_t)0) {
+      adjusted = (int64_t)(granulepos + (uint64_t)s->adjust);
+      if (adjusted == -1)
+	return granule_fail(result, ROGG_GRANULE_UNSET, s->serialno,
+		(int64_t)granulepos);
+      if (adjusted < 0 && (int64_t)granulepos >= 0)
+	return granule_fail(result, ROGG_GRANULE_NEGATIVE, s->serialno,
+		(int64_t)granulepos);
+      if (result->pages == room) {
+	o = rogg_arena_grow(arena, offsets, room * sizeof(*o),
+		(room * 2 + 1024) * sizeof(*o));
+	if (o == NULL) return granule_fail(result, ROGG_GRANULE_NOMEM, 0, 0);
+	offsets = o;
+	room = room * 2 + 1024;
+      }
+      offsets[result->pages++] = q - p;
+    }
+    q += header.length;
+  }
+  if (opts->check_only || !result->pages) return 0;
+
+  /* commit, splitting the pages between threads */
+  n = opts->threads > ROGG_FIX_THREADS ? ROGG_FIX_THREADS : opts->threads;
+  if (n < 1) n = 1;
+  if (result->pages < n) n = result->pages;
+  for (i = 0; i < n; i++) {
+    work[i].p = p;
+    work[i].offsets = offsets + result->pages / n * i;
+    work[i].count = (i == n - 1) ? result->pages - result->pages / n * i :
+	result->pages / n;
+    work[i].streams = streams;
+    work[i].nstreams = nstreams;
+  }
+  for (started = 1; started < n; started++) {
+    if (pthread_create(&tids[started], NULL, granule_commit, &work[started]))
+      break;
+  }
+  granule_commit(&work[0]);
+  for (i = 1; i < started; i++) pthread_join(tids[i], NULL);
+  for (; i < n; i++) granule_commit(&work[i]);
+
+  return 0;
+}
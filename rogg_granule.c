@@ -26,15 +26,21 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-/* ogg vorbis logical stream granule adjustment using the rogg library */
+/* ogg logical stream granule adjustment using the rogg library */
 
 /* compile with
-   gcc -O2 -g -Wall -I. -o rogg_granule rogg.c rogg_granule.c
+   gcc -O2 -g -Wall -I. -o rogg_granule rogg.c rogg_codec.c rogg_arena.c \
+	rogg_fix.c rogg_granule.c -lpthread
 */
 
+/* The adjustment itself is rogg_granule_shift, which checks the whole
+   file before changing anything, so a file is either adjusted
+   completely or left alone. */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 
 #include <sys/types.h>
@@ -45,30 +51,63 @@
 
 #include <rogg.h>
 
-int header_packets = 3;
-int granule_adjust = 0;
+int show_counters = 0;
+int header_packets = -1;	/* -1 to go by the codec */
+int check_only = 0;
+int threads = 1;
+rogg_granule_adjust *adjustments = NULL;
+int nadjustments = 0;
 
 void print_usage(FILE *out, char *name)
 {
   fprintf(stderr, "Script for editing ogg headers\n");
-  fprintf(stderr, "%s [-g n] <file1.ogg> [<file2.ogg>...]\n",
+  fprintf(stderr, "%s [-g n] [-s serial:n]... <file1.ogg> [<file2.ogg>...]\n",
 	name);
   fprintf(stderr,
-		  "    -k n        Skip n header pacekts. Default is 3, which is suitable for Vorbis.\n"
-		  "    -g n        Change the granule position of a logical vorbis stream by n\n"
+		  "    -k n        Skip n header packets of every stream. By default this\n"
+		  "                comes from the codec, or is 3 if it isn't recognized.\n"
+		  "    -g n        Change the granule position of every logical stream by n\n"
 		  "                (can be positive or negative).\n"
+		  "    -s serial:n Change the granule position of the stream with the given\n"
+		  "                serial number (hex) by n, overriding -g.\n"
+		  "    -c          only check that the adjustment is possible\n"
+		  "    -j threads  number of threads to rewrite pages with\n"
+		  "    -S          print library counters on exit\n"
 		  "\n");
 }
 
+int add_adjustment(int all, uint32_t serialno, int64_t adjust)
+{
+  rogg_granule_adjust *a = realloc(adjustments, (nadjustments + 1) * sizeof(*a));
+
+  if (a == NULL) return -1;
+  adjustments = a;
+  adjustments[nadjustments].all = all;
+  adjustments[nadjustments].serialno = serialno;
+  adjustments[nadjustments++].adjust = adjust;
+  return 0;
+}
+
 void parse_args(int *argc, char *argv[])
 {
   int arg = 1;
   int shift;
+  int64_t adjust;
+  unsigned int serialno;
+  char *end;
 
   while (arg < *argc) {
     shift = 0;
     if (argv[arg][0] == '-') {
       switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'c':
+	  check_only = 1;
+	  shift = 1;
+	  break;
         case 'k':
           shift = 2;
           if (*argc - arg - shift < 0) {
@@ -93,11 +132,34 @@ void parse_args(int *argc, char *argv[])
 	    exit(1);
 	  }
 	  /* read granule adjustment from the next arg */
-	  if (sscanf(argv[arg+1], "%i", &granule_adjust) != 1) {
+	  if (sscanf(argv[arg+1], "%" SCNi64, &adjust) != 1) {
 	    fprintf(stderr, "Could not parse granule adjustment '%s'.\n", argv[arg+1]);
-	    granule_adjust = 0;
 	  } else {
-	    fprintf(stdout, "Adjusting granule position by %i\n", granule_adjust);
+	    fprintf(stdout, "Adjusting granule position by %" PRId64 "\n", adjust);
+	    if (add_adjustment(1, 0, adjust) < 0) exit(1);
+	  }
+	  break;
+	case 's':
+	  shift = 2;
+	  if (*argc - arg - shift < 0) {
+	    fprintf(stderr, "Error parsing arguments: Option -s requires an argument.\n");
+	    exit(1);
+	  }
+	  serialno = strtoul(argv[arg+1], &end, 16);
+	  if (*end != ':' || sscanf(end + 1, "%" SCNi64, &adjust) != 1) {
+	    fprintf(stderr, "Could not parse stream adjustment '%s'.\n", argv[arg+1]);
+	    exit(1);
+	  }
+	  fprintf(stdout, "Adjusting granule position of stream %08x by %" PRId64 "\n",
+		serialno, adjust);
+	  if (add_adjustment(0, serialno, adjust) < 0) exit(1);
+	  break;
+	case 'j':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%d", &threads) != 1 || threads < 1) {
+	    fprintf(stderr, "Option -j requires a number of threads.\n");
+	    exit(1);
 	  }
 	  break;
       }
@@ -116,41 +178,87 @@ void parse_args(int *argc, char *argv[])
   }
 }
 
-static int page_has_granulepos(unsigned char *p)
+/* the file being checked, for messages about skipped bytes */
+typedef struct {
+  FILE *out;
+  long long len;
+} skip_report;
+
+void report_skip(void *data, long long offset, long long len)
+{
+  skip_report *r = data;
+
+  if (offset == 0)
+    fprintf(r->out, "Skipped %d garbage bytes at the start\n", (int)len);
+  else if (offset + len == r->len)
+    fprintf(r->out, "Skipped %d garbage bytes as the end\n", (int)len);
+  else
+    fprintf(r->out, "Hole in data! skipped %d bytes\n", (int)len);
+}
+
+void report_error(FILE *out, rogg_granule_result *result)
 {
-  uint64_t granulepos = 0;
-  rogg_read_uint64(&p[ROGG_OFFSET_GRANULEPOS], &granulepos);
-  return granulepos != ~(uint64_t)0;
+  switch (result->error) {
+    case ROGG_GRANULE_NOMEM:
+      fprintf(out, "Error: out of memory planning the adjustment.\n");
+      break;
+    case ROGG_GRANULE_HEADERS:
+      fprintf(out,
+	"Error: Header packets of stream %08x do not terminate on a page "
+	"boundary. Cannot adjust granulepos meaningfully.\n",
+	result->serialno);
+      break;
+    case ROGG_GRANULE_UNSET:
+      fprintf(out,
+	"Error: granulepos offset would result in a granulepos of -1, "
+	"which would be an unparsable stream.\n");
+      break;
+    case ROGG_GRANULE_NEGATIVE:
+      fprintf(out,
+	"Error: granulepos offset would make granulepos %" PRId64
+	" of stream %08x negative.\n", result->granulepos, result->serialno);
+      break;
+  }
 }
 
 int main(int argc, char *argv[])
 {
-  int f, i;
-  unsigned char *p, *q, *o, *e;
+  int f, i, ret = 0;
+  unsigned char *p;
   struct stat s;
-  rogg_page_header header;
-  int header_done;
-  uint64_t packetno;
-  uint64_t granulepos;
+  rogg_granule_options opts;
+  rogg_granule_result result;
+  rogg_arena arena;
+  skip_report report;
 
   parse_args(&argc, argv);
   if (argc < 2) {
     print_usage(stderr, argv[0]);
     exit(1);
   }
+  rogg_arena_init(&arena, 0);
+  memset(&opts, 0, sizeof(opts));
+  opts.adjust = adjustments;
+  opts.count = nadjustments;
+  opts.headers = header_packets;
+  opts.check_only = check_only;
+  opts.threads = threads;
+  opts.hooks.skip = report_skip;
+  opts.hooks.data = &report;
+  report.out = stdout;
 
   for (i = 1; i < argc; i++) {
-    f = open(argv[i], O_RDWR);
+    f = open(argv[i], check_only ? O_RDONLY : O_RDWR);
     if (f < 0) {
 	fprintf(stderr, "couldn't open '%s'\n", argv[i]);
 	continue;
     }
-    if (fstat(f, &s) < 0) {
+    if (fstat(f, &s) < 0 || s.st_size == 0) {
 	fprintf(stderr, "couldn't stat '%s'\n", argv[i]);
 	close(f);
 	continue;
     }
-    p = mmap(0, s.st_size, PROT_READ|PROT_WRITE,
+    p = mmap(0, s.st_size, PROT_READ|(check_only ? 0 : PROT_WRITE),
 	MAP_SHARED, f, 0);
     if (p == MAP_FAILED) {
 	fprintf(stderr, "couldn't mmap '%s'\n", argv[i]);
@@ -158,103 +266,26 @@ int main(int argc, char *argv[])
 	continue;
     }
 
-    /* first pass: scan whether we would write invalid -1 granulepos */
     fprintf(stdout, "Checking Ogg file '%s'\n", argv[i]);
-    e = p + s.st_size; /* pointer to the end of the file */
-    packetno = 0;
-    header_done = 0;
-    q = rogg_scan(p, s.st_size); /* scan for an Ogg page */
-    if (q == NULL) {
-      fprintf(stdout, "couldn't find ogg data!\n");
+    report.len = s.st_size;
+    if (rogg_granule_shift(p, s.st_size, &opts, &arena, &result) < 0) {
+      report_error(stderr, &result);
+      fprintf(stderr, "Leaving '%s' unchanged.\n", argv[i]);
+      ret = 1;
+    } else if (!check_only) {
+      fprintf(stdout, "Applied granulepos offset to %ld pages of '%s'\n",
+	result.pages, argv[i]);
     } else {
-      if (q > p) {
-        fprintf(stdout, "Skipped %d garbage bytes at the start\n", (int)(q-p));
-      }
-      while (q < e) {
-        o = rogg_scan(q, e-q); /* find the next Ogg page */
-        if (o > q) {
-          fprintf(stdout, "Hole in data! skipped %d bytes\n", (int)(o-q));
-          q = o;
-        } else if (o == NULL) {
-          fprintf(stdout, "Skipped %d garbage bytes as the end\n", (int)(e-q));
-          break;
-        }
-        rogg_page_parse(q, &header);
-        packetno += rogg_page_packets_ending(&header);
-        if (packetno < header_packets) {
-          q += header.length;
-          continue;
-        } else if (packetno == header_packets) {
-          header_done = 1;
-          q += header.length;
-          continue;
-        } else if (!header_done) {
-            fprintf(stderr,
-              "Error: Header packets do not terminate on a page boundary. "
-              "Cannot adjust granulepos meaningfully. Aborting.\n");
-            munmap(p, s.st_size);
-            close(f);
-            exit(1);
-        }
-        rogg_read_uint64(&q[ROGG_OFFSET_GRANULEPOS], &granulepos);
-        if (page_has_granulepos(q)) {
-          granulepos += (int64_t)granule_adjust;
-          if (granulepos == ~(uint64_t)0) {
-            fprintf(stderr,
-              "Error: granulepos offset would result in a granulepos of -1, "
-              "which would be an unparsable stream. Aborting.\n");
-            munmap(p, s.st_size);
-            close(f);
-            exit(1);
-          }
-        }
-        q += header.length;
-      }
-    }
-
-    /* second pass: actually apply granulepos offset */
-    fprintf(stdout, "Applying granulepos offset to file '%s'\n", argv[i]);
-    e = p + s.st_size; /* pointer to the end of the file */
-    packetno = 0;
-    header_done = 0;
-    q = rogg_scan(p, s.st_size); /* scan for an Ogg page */
-    if (q == NULL) {
-      /* fprintf(stdout, "couldn't find ogg data!\n"); */
-    } else {
-      if (q > p) {
-        /* fprintf(stdout, "Skipped %d garbage bytes at the start\n", (int)(q-p)); */
-      }
-      while (q < e) {
-        o = rogg_scan(q, e-q); /* find the next Ogg page */
-        if (o > q) {
-          /* fprintf(stdout, "Hole in data! skipped %d bytes\n", (int)(o-q)); */
-          q = o;
-        } else if (o == NULL) {
-          /* fprintf(stdout, "Skipped %d garbage bytes as the end\n", (int)(e-q)); */
-          break;
-        }
-        rogg_page_parse(q, &header);
-        packetno += rogg_page_packets_ending(&header);
-        if (packetno < header_packets) {
-          q += header.length;
-          continue;
-        } else if (packetno == header_packets) {
-          header_done = 1;
-          q += header.length;
-          continue;
-        }
-        rogg_read_uint64(&q[ROGG_OFFSET_GRANULEPOS], &granulepos);
-        if (page_has_granulepos(q)) {
-          granulepos += (int64_t)granule_adjust;
-          rogg_write_uint64(&q[ROGG_OFFSET_GRANULEPOS], granulepos);
-          rogg_page_update_crc(q);
-        }
-        q += header.length;
-      }
+      fprintf(stdout, "%ld pages of '%s' would change\n", result.pages,
+	argv[i]);
     }
 
+    rogg_arena_reset(&arena);
     munmap(p, s.st_size);
     close(f);
   }
-  return 0;
+  rogg_arena_clear(&arena);
+  free(adjustments);
+  if (show_counters) rogg_counters_report(stderr);
+  return ret;
 }
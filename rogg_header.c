@@ -0,0 +1,497 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* reading and rewriting the header packets of a logical stream */
+
+/* Header packets are read as scatter lists pointing into the mapped
+   file, so they can span any number of pages. Replacements of the
+   same length are copied straight back through those lists. Anything
+   else re-pages just the header region: the stream's own header pages
+   are rebuilt, pages of other streams in between are kept, and the
+   rest of the file is moved by inserting or collapsing filesystem
+   blocks where the size change allows, or by copying it into a new
+   file which replaces the old one. */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+
+#include "rogg.h"
+
+/* append a section of body data to a packet. Arena lists double at
+   powers of two, since the two of them can't both grow in place. */
+static int packet_add(rogg_packet *packet, rogg_arena *arena,
+	unsigned char *data, unsigned int length)
+{
+  unsigned char **sections;
+  unsigned int *lengths;
+  int n = packet->sections;
+
+  if (arena == NULL) {
+    sections = realloc(packet->data, (n + 1) * sizeof(*sections));
+    if (sections == NULL) return -1;
+    packet->data = sections;
+    lengths = realloc(packet->lengths, (n + 1) * sizeof(*lengths));
+    if (lengths == NULL) return -1;
+    packet->lengths = lengths;
+  } else if (n < 4 ? n == 0 : !(n & (n - 1))) {
+    int room = n ? 2 * n : 4;
+    sections = rogg_arena_grow(arena, packet->data,
+	n * sizeof(*sections), room * sizeof(*sections));
+    if (sections == NULL) return -1;
+    packet->data = sections;
+    lengths = rogg_arena_grow(arena, packet->lengths,
+	n * sizeof(*lengths), room * sizeof(*lengths));
+    if (lengths == NULL) return -1;
+    packet->lengths = lengths;
+  }
+  packet->data[packet->sections] = data;
+  packet->lengths[packet->sections] = length;
+  packet->sections++;
+  packet->length += length;
+
+  return 0;
+}
+
+long rogg_packet_copy(rogg_packet *packet, unsigned char *out)
+{
+  int i;
+
+  for (i = 0; i < packet->sections; i++) {
+    memcpy(out, packet->data[i], packet->lengths[i]);
+    out += packet->lengths[i];
+  }
+
+  return packet->length;
+}
+
+void rogg_packet_clear(rogg_packet *packet)
+{
+  free(packet->data);
+  free(packet->lengths);
+  memset(packet, 0, sizeof(*packet));
+}
+
+int rogg_headers_read(rogg_headers *headers, unsigned char *p, long len,
+	uint32_t serialno, int count)
+{
+  return rogg_headers_read_arena(headers, NULL, p, len, serialno, count);
+}
+
+int rogg_headers_read_arena(rogg_headers *headers, rogg_arena *arena,
+	unsigned char *p, long len, uint32_t serialno, int count)
+{
+  unsigned char *e = p + len;
+  unsigned char *q, *data;
+  rogg_page_header header;
+  long long *offsets;
+  int packet = 0;
+  int running = 0;
+  int i;
+
+  memset(headers, 0, sizeof(*headers));
+  headers->serialno = serialno;
+  headers->count = count;
+  headers->arena = arena;
+  if (count < 1) return -1;
+  if (arena != NULL)
+    headers->packets = rogg_arena_calloc(arena, count,
+	sizeof(*headers->packets));
+  else
+    headers->packets = calloc(count, sizeof(*headers->packets));
+  if (headers->packets == NULL) return -1;
+
+  /* find the bos page */
+  q = p;
+  while ((q = rogg_page_find(q, e, &header)) != NULL) {
+    if (header.serialno == serialno) break;
+    q += header.length;
+  }
+  if (q == NULL || !header.bos) goto fail;
+  headers->start = q - p;
+
+  for (;;) {
+    if (header.continued != running) goto fail;
+    if (arena != NULL)
+      offsets = rogg_arena_grow(arena, headers->offsets,
+	headers->pages * sizeof(*offsets),
+	(headers->pages + 1) * sizeof(*offsets));
+    else
+      offsets = realloc(headers->offsets,
+	(headers->pages + 1) * sizeof(*offsets));
+    if (offsets == NULL) goto fail;
+    headers->offsets = offsets;
+    headers->offsets[headers->pages++] = q - p;
+
+    /* split the page body into runs belonging to each packet */
+    data = header.data;
+    i = 0;
+    while (i < header.segments && packet < count) {
+      rogg_packet *pkt = &headers->packets[packet];
+      unsigned char *run = data;
+      unsigned int n = 0;
+      running = 1;
+      while (i < header.segments) {
+	n += header.lacing[i];
+	if (header.lacing[i++] < 255) {
+	  running = 0;
+	  break;
+	}
+      }
+      if (packet_add(pkt, arena, run, n) < 0) goto fail;
+      if (pkt->sections == 1) pkt->bos = header.bos;
+      data += n;
+      if (!running) {
+	pkt->granulepos = header.granulepos;
+	packet++;
+      }
+    }
+    if (packet == count) {
+      /* data packets sharing the last page pin the layout */
+      headers->shared = i < header.segments;
+      headers->end = q - p + header.length;
+      return 0;
+    }
+
+    q += header.length;
+    while ((q = rogg_page_find(q, e, &header)) != NULL) {
+      if (header.serialno == serialno) break;
+      q += header.length;
+    }
+    if (q == NULL) goto fail;
+  }
+
+fail:
+  rogg_headers_clear(headers);
+  return -1;
+}
+
+void rogg_headers_clear(rogg_headers *headers)
+{
+  int i;
+
+  if (headers->arena != NULL) {
+    /* the arena owns the lists */
+    memset(headers, 0, sizeof(*headers));
+    return;
+  }
+  if (headers->packets != NULL) {
+    for (i = 0; i < headers->count; i++)
+      rogg_packet_clear(&headers->packets[i]);
+  }
+  free(headers->packets);
+  free(headers->offsets);
+  memset(headers, 0, sizeof(*headers));
+}
+
+/* assemble a page from lacing values and body data, returns its length */
+static int page_build(unsigned char *out, int flags, int64_t granulepos,
+	uint32_t serialno, uint32_t sequenceno,
+	unsigned char *lacing, int segments, unsigned char *body)
+{
+  int i, length = 0;
+
+  memcpy(out, "OggS", 4);
+  out[ROGG_OFFSET_VERSION] = 0;
+  out[ROGG_OFFSET_FLAGS] = flags;
+  rogg_write_uint64(out + ROGG_OFFSET_GRANULEPOS, granulepos);
+  rogg_write_uint32(out + ROGG_OFFSET_SERIALNO, serialno);
+  rogg_write_uint32(out + ROGG_OFFSET_SEQUENCENO, sequenceno);
+  out[ROGG_OFFSET_SEGMENTS] = segments;
+  memcpy(out + ROGG_OFFSET_LACING, lacing, segments);
+  for (i = 0; i < segments; i++) length += lacing[i];
+  memcpy(out + ROGG_OFFSET_LACING + segments, body, length);
+  rogg_page_update_crc(out);
+
+  return ROGG_OFFSET_LACING + segments + length;
+}
+
+/* write all of buf at offset */
+static int write_all(int fd, unsigned char *buf, long long len, off_t offset)
+{
+  ssize_t ret;
+
+  while (len > 0) {
+    ret = pwrite(fd, buf, len, offset);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    buf += ret;
+    len -= ret;
+    offset += ret;
+  }
+
+  return 0;
+}
+
+/* copy len bytes from the old file to the new one, sharing extents
+   where the filesystem can, or from the mapping where it can't */
+static int copy_range(int in, unsigned char *p, off_t from,
+	int out, off_t to, long long len)
+{
+  ssize_t ret;
+
+  while (len > 0) {
+    ret = copy_file_range(in, &from, out, &to, len, 0);
+    if (ret <= 0) break;
+    len -= ret;
+  }
+  if (len > 0) return write_all(out, p + from, len, to);
+
+  return 0;
+}
+
+/* renumber the stream's pages after the header region in the new file */
+static int renumber(rogg_headers *headers, unsigned char *p, long len,
+	int fd, long long delta, int shift)
+{
+  unsigned char buf[ROGG_PAGE_MAX];
+  unsigned char *e = p + len;
+  unsigned char *q = p + headers->end;
+  rogg_page_header header;
+
+  while ((q = rogg_page_find(q, e, &header)) != NULL) {
+    if (header.serialno == headers->serialno) {
+      memcpy(buf, q, header.length);
+      rogg_write_uint32(buf + ROGG_OFFSET_SEQUENCENO,
+	header.sequenceno + shift);
+      rogg_page_update_crc(buf);
+      if (write_all(fd, buf, header.length, q - p + delta) < 0) return -1;
+    }
+    q += header.length;
+  }
+
+  return 0;
+}
+
+/* lay out new header pages for the stream in out, returning the number
+   of pages, or -1 if the packets can't be paged */
+static int headers_page(rogg_headers *headers, unsigned char *p,
+	unsigned char **data, long *lengths, unsigned char *out, long *size)
+{
+  rogg_page_header header;
+  unsigned char *lacing, *body, *b;
+  uint32_t sequenceno;
+  long total = 0;
+  int segments = 0;
+  int pages, left, pos, n, i, j, flags, ends;
+  int eos, length;
+
+  rogg_page_parse(p + headers->offsets[headers->pages - 1], &header);
+  eos = header.eos;
+  rogg_page_parse(p + headers->start, &header);
+  sequenceno = header.sequenceno;
+
+  /* the identification packet goes alone on the bos page */
+  n = lengths[0] / 255 + 1;
+  if (n > 255) return -1;
+  lacing = malloc(n);
+  if (lacing == NULL) return -1;
+  for (j = 0; j < n - 1; j++) lacing[j] = 255;
+  lacing[n - 1] = lengths[0] % 255;
+  flags = 0x02 | ((headers->count == 1 && eos) ? 0x04 : 0);
+  *size = page_build(out, flags, 0, headers->serialno, sequenceno++,
+	lacing, n, data[0]);
+  free(lacing);
+  if (headers->count == 1) return 1;
+
+  /* gather the rest into one run of lacing values and body data */
+  for (i = 1; i < headers->count; i++) {
+    segments += lengths[i] / 255 + 1;
+    total += lengths[i];
+  }
+  lacing = malloc(segments);
+  body = malloc(total);
+  if (lacing == NULL || body == NULL) {
+    free(lacing);
+    free(body);
+    return -1;
+  }
+  pos = 0;
+  b = body;
+  for (i = 1; i < headers->count; i++) {
+    for (j = 0; j < lengths[i] / 255; j++) lacing[pos++] = 255;
+    lacing[pos++] = lengths[i] % 255;
+    memcpy(b, data[i], lengths[i]);
+    b += lengths[i];
+  }
+
+  /* keep the old page count where the packets allow it, so the
+     following pages don't need renumbering */
+  pages = headers->pages - 1;
+  if (pages < (segments + 254) / 255) pages = (segments + 254) / 255;
+  if (pages > segments) pages = segments;
+
+  pos = 0;
+  b = body;
+  for (left = pages; left > 0; left--) {
+    n = segments - pos - (left - 1);
+    if (n > 255) n = 255;
+    ends = 0;
+    for (j = pos; j < pos + n; j++) if (lacing[j] < 255) ends = 1;
+    flags = (pos > 0 && lacing[pos - 1] == 255) ? 0x01 : 0;
+    if (left == 1 && eos) flags |= 0x04;
+    length = page_build(out + *size, flags, ends ? 0 : -1,
+	headers->serialno, sequenceno++, lacing + pos, n, b);
+    b += length - ROGG_OFFSET_LACING - n;
+    pos += n;
+    *size += length;
+  }
+  free(lacing);
+  free(body);
+
+  return pages + 1;
+}
+
+int rogg_headers_write(rogg_headers *headers, const char *path, int fd,
+	unsigned char *p, long len, unsigned char **data, long *lengths)
+{
+  unsigned char *e = p + len;
+  unsigned char *q, *out, *pages, *o;
+  rogg_page_header header;
+  long long delta, align;
+  long size, room;
+  int count, seen, shift;
+  int i, j, ret = -1;
+  struct stat st;
+
+  /* same sized packets go straight back through the scatter lists */
+  for (i = 0; i < headers->count; i++) {
+    if (lengths[i] != headers->packets[i].length) break;
+  }
+  if (i == headers->count) {
+    for (i = 0; i < headers->count; i++) {
+      rogg_packet *pkt = &headers->packets[i];
+      unsigned char *d = data[i];
+      for (j = 0; j < pkt->sections; j++) {
+	memcpy(pkt->data[j], d, pkt->lengths[j]);
+	d += pkt->lengths[j];
+      }
+    }
+    for (i = 0; i < headers->pages; i++)
+      rogg_page_update_crc(p + headers->offsets[i]);
+    return 0;
+  }
+
+  /* otherwise rebuild the header pages */
+  if (headers->shared) return -1;
+  room = 0;
+  for (i = 0; i < headers->count; i++) room += lengths[i] + lengths[i] / 255 + 1;
+  room += (room / (255 * 255) + headers->pages + 2) * ROGG_OFFSET_LACING;
+  pages = malloc(room);
+  if (pages == NULL) return -1;
+  count = headers_page(headers, p, data, lengths, pages, &size);
+  if (count < 0) {
+    free(pages);
+    return -1;
+  }
+  shift = count - headers->pages;
+
+  /* splice them in place of the old ones, keeping other streams'
+     pages where they were; the output starts at a block boundary
+     so it can follow an inserted or collapsed range */
+  if (fstat(fd, &st) < 0) goto done;
+  align = headers->start - headers->start % st.st_blksize;
+  out = malloc(headers->end - align + size);
+  if (out == NULL) goto done;
+  memcpy(out, p + align, headers->start - align);
+  o = out + (headers->start - align);
+  q = p + headers->start;
+  seen = 0;
+  while ((q = rogg_page_find(q, e, &header)) != NULL &&
+	q < p + headers->end) {
+    if (header.serialno != headers->serialno) {
+      memcpy(o, q, header.length);
+      o += header.length;
+    } else if (++seen == 1) {
+      /* the new bos page goes where the old one was, and the rest
+	 where the second header page was */
+      rogg_page_get_length(pages, &i);
+      if (headers->pages == 1) i = size;
+      memcpy(o, pages, i);
+      o += i;
+    } else if (seen == 2) {
+      rogg_page_get_length(pages, &i);
+      memcpy(o, pages + i, size - i);
+      o += size - i;
+    }
+    q += header.length;
+  }
+  delta = (o - out) - (headers->end - align);
+
+  if (delta == 0 && shift == 0) {
+    /* same size after all */
+    memcpy(p + align, out, o - out);
+    ret = 0;
+  } else if (delta && shift == 0 && delta % st.st_blksize == 0 &&
+	fallocate(fd, delta > 0 ? FALLOC_FL_INSERT_RANGE :
+		FALLOC_FL_COLLAPSE_RANGE, align, delta > 0 ? delta : -delta) == 0) {
+    /* the filesystem moved the rest of the file for us */
+    ret = write_all(fd, out, o - out, align) < 0 ? -1 : 1;
+  } else {
+    /* copy everything into a new file and swap it in */
+    char *tmp = malloc(strlen(path) + 8);
+    int t;
+    if (tmp == NULL) goto free_out;
+    sprintf(tmp, "%s.XXXXXX", path);
+    t = mkstemp(tmp);
+    if (t < 0) {
+      free(tmp);
+      goto free_out;
+    }
+    if (fchmod(t, st.st_mode & 07777) < 0 ||
+	copy_range(fd, p, 0, t, 0, align) < 0 ||
+	write_all(t, out, o - out, align) < 0 ||
+	copy_range(fd, p, headers->end, t, headers->end + delta,
+		len - headers->end) < 0 ||
+	(shift && renumber(headers, p, len, t, delta, shift) < 0) ||
+	fsync(t) < 0 || rename(tmp, path) < 0) {
+      unlink(tmp);
+    } else {
+      ret = 1;
+    }
+    close(t);
+    free(tmp);
+  }
+
+free_out:
+  free(out);
+done:
+  free(pages);
+  return ret;
+}
@@ -0,0 +1,255 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* packet index of the logical streams in a buffer */
+
+/* Each stream keeps two tables, one entry per page and one per packet.
+   Entries are grouped in blocks of ROGG_INDEX_BLOCK with an absolute
+   base per block, and each entry only holds its distance from that
+   base, so a lookup reads one base and one entry without decoding any
+   neighbours. A packet records the stream page it starts on, its
+   first lacing value there and how many pages it covers, which is
+   everything needed to point at its data again. Packets cut short by
+   a missing page, or left open at the end of the buffer, aren't
+   indexed. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rogg.h"
+
+/* per stream state while building */
+typedef struct {
+  long start;			/* page the open packet starts on, or -1 */
+  int segment;			/* its first lacing value */
+  uint32_t sequenceno;		/* expected on the next page */
+} index_open;
+
+/* make room for entry n of a list growing at powers of two */
+static void *index_room(rogg_arena *arena, void *list, long n, size_t size)
+{
+  if (n < 16 ? n != 0 : (n & (n - 1)) != 0) return list;
+  return rogg_arena_grow(arena, list, n * size, (n ? 2 * n : 16) * size);
+}
+
+/* record a page of the stream at offset */
+static int index_page(rogg_arena *arena, rogg_index_stream *s,
+	long long offset)
+{
+  long n = s->pages;
+  long long delta;
+
+  if (n % ROGG_INDEX_BLOCK == 0) {
+    s->page_base = index_room(arena, s->page_base, n / ROGG_INDEX_BLOCK,
+	sizeof(*s->page_base));
+    if (s->page_base == NULL) return -1;
+    s->page_base[n / ROGG_INDEX_BLOCK] = offset;
+  }
+  delta = offset - s->page_base[n / ROGG_INDEX_BLOCK];
+  if (delta > UINT32_MAX) return -1;
+  s->page_delta = index_room(arena, s->page_delta, n, sizeof(*s->page_delta));
+  if (s->page_delta == NULL) return -1;
+  s->page_delta[n] = (uint32_t)delta;
+  s->pages++;
+
+  return 0;
+}
+
+/* record a packet from lacing value segment of page start to page end */
+static int index_packet(rogg_arena *arena, rogg_index_stream *s,
+	long start, int segment, long end)
+{
+  long n = s->packets;
+  rogg_index_entry *entry;
+
+  if (end - start >= UINT16_MAX) return -1;
+  if (n % ROGG_INDEX_BLOCK == 0) {
+    s->packet_base = index_room(arena, s->packet_base,
+	n / ROGG_INDEX_BLOCK, sizeof(*s->packet_base));
+    if (s->packet_base == NULL) return -1;
+    s->packet_base[n / ROGG_INDEX_BLOCK] = start;
+  }
+  s->entries = index_room(arena, s->entries, n, sizeof(*s->entries));
+  if (s->entries == NULL) return -1;
+  entry = &s->entries[n];
+  entry->page = (uint32_t)(start - s->packet_base[n / ROGG_INDEX_BLOCK]);
+  entry->span = (uint16_t)(end - start + 1);
+  entry->segment = (uint8_t)segment;
+  s->packets++;
+
+  return 0;
+}
+
+/* split a page of the stream into packets */
+static int index_lacing(rogg_arena *arena, rogg_index_stream *s,
+	index_open *o, rogg_page_header *header)
+{
+  long page = s->pages - 1;
+  int i = 0;
+
+  /* a gap in the sequence or a fresh start loses the open packet */
+  if ((page > 0 && header->sequenceno != o->sequenceno) ||
+	!header->continued)
+    o->start = -1;
+  o->sequenceno = header->sequenceno + 1;
+
+  if (header->continued) {
+    /* finish the open packet, or skip the tail of one we never saw */
+    while (i < header->segments && header->lacing[i] == 255) i++;
+    if (i == header->segments) return 0;
+    i++;
+    if (o->start >= 0 &&
+	index_packet(arena, s, o->start, o->segment, page) < 0) return -1;
+    o->start = -1;
+  }
+
+  while (i < header->segments) {
+    int first = i;
+    while (i < header->segments && header->lacing[i] == 255) i++;
+    if (i == header->segments) {
+      o->start = page;
+      o->segment = first;
+      return 0;
+    }
+    i++;
+    if (index_packet(arena, s, page, first, page) < 0) return -1;
+  }
+
+  return 0;
+}
+
+int rogg_index_build(rogg_index *index, rogg_arena *arena,
+	unsigned char *p, long len)
+{
+  unsigned char *q = p, *e = p + len;
+  rogg_page_header header;
+  rogg_index_stream *s;
+  index_open *open = NULL;
+  int i;
+
+  memset(index, 0, sizeof(*index));
+  while ((q = rogg_page_find(q, e, &header)) != NULL) {
+    for (i = 0; i < index->count; i++) {
+      if (index->streams[i].serialno == header.serialno) break;
+    }
+    if (i == index->count) {
+      index->streams = index_room(arena, index->streams, i,
+	sizeof(*index->streams));
+      open = index_room(arena, open, i, sizeof(*open));
+      if (index->streams == NULL || open == NULL) return -1;
+      memset(&index->streams[i], 0, sizeof(*index->streams));
+      index->streams[i].serialno = header.serialno;
+      open[i].start = -1;
+      index->count++;
+    }
+    s = &index->streams[i];
+    if (index_page(arena, s, q - p) < 0) return -1;
+    if (index_lacing(arena, s, &open[i], &header) < 0) return -1;
+    q += header.length;
+  }
+
+  return index->count ? 0 : ROGG_NO_PAGES;
+}
+
+rogg_index_stream *rogg_index_find(rogg_index *index, uint32_t serialno)
+{
+  int i;
+
+  for (i = 0; i < index->count; i++) {
+    if (index->streams[i].serialno == serialno) return &index->streams[i];
+  }
+
+  return NULL;
+}
+
+long long rogg_index_page(rogg_index_stream *s, long n)
+{
+  if (n < 0 || n >= s->pages) return -1;
+  return s->page_base[n / ROGG_INDEX_BLOCK] + s->page_delta[n];
+}
+
+int rogg_index_packet(rogg_index_stream *s, unsigned char *p, long n,
+	rogg_arena *arena, rogg_packet *packet)
+{
+  rogg_index_entry *entry;
+  rogg_page_header header;
+  unsigned char *data;
+  unsigned int length;
+  long page;
+  int i = 0, k;
+
+  memset(packet, 0, sizeof(*packet));
+  if (n < 0 || n >= s->packets) return -1;
+  entry = &s->entries[n];
+  page = s->packet_base[n / ROGG_INDEX_BLOCK] + entry->page;
+
+  if (arena != NULL) {
+    packet->data = rogg_arena_alloc(arena,
+	entry->span * sizeof(*packet->data));
+    packet->lengths = rogg_arena_alloc(arena,
+	entry->span * sizeof(*packet->lengths));
+  } else {
+    packet->data = malloc(entry->span * sizeof(*packet->data));
+    packet->lengths = malloc(entry->span * sizeof(*packet->lengths));
+  }
+  if (packet->data == NULL || packet->lengths == NULL) {
+    if (arena == NULL) rogg_packet_clear(packet);
+    return -1;
+  }
+
+  for (k = 0; k < entry->span; k++) {
+    rogg_page_parse(p + rogg_index_page(s, page + k), &header);
+    data = header.data;
+    i = 0;
+    if (k == 0) {
+      for (; i < entry->segment; i++) data += header.lacing[i];
+      packet->bos = header.bos && entry->segment == 0;
+    }
+    length = 0;
+    while (i < header.segments) {
+      length += header.lacing[i];
+      if (header.lacing[i++] < 255) break;
+    }
+    packet->data[k] = data;
+    packet->lengths[k] = length;
+    packet->length += length;
+  }
+  packet->sections = entry->span;
+
+  /* the page's granulepos and eos belong to the last packet ending on it */
+  while (i < header.segments && header.lacing[i] == 255) i++;
+  if (i < header.segments) {
+    packet->granulepos = -1;
+  } else {
+    packet->granulepos = header.granulepos;
+    packet->eos = header.eos;
+  }
+
+  return 0;
+}
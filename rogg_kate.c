@@ -25,10 +25,12 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-/* kate header modification script using the rogg library */
+/* kate header modification script using the rogg library; the
+   edits are made by rogg_kate_edit */
 
 /* compile with
-   gcc -O2 -g -Wall -I. -o rogg_kate rogg.c rogg_kate.c
+   gcc -O2 -g -Wall -I. -o rogg_kate rogg.c rogg_codec.c rogg_output.c \
+	rogg_arena.c rogg_edit.c rogg_header.c rogg_comment.c rogg_kate.c
 */
 
 #include <stdio.h>
@@ -44,6 +46,7 @@
 
 #include <rogg.h>
 
+int show_counters = 0;
 int verbose = 0;
 int language_set = 0;
 const char * language = NULL;
@@ -53,77 +56,48 @@ int canvas_size_set = 0;
 int canvas_width = 0;
 int canvas_height = 0;
 
-/* little endian accessors for the kate header data */
-int get32(unsigned char *data)
+void print_kate_info(FILE *out, rogg_kate_info *info)
 {
-  return (data[3] << 24) | (data[2] << 16) | (data[1] << 8) | data[0];
-}
-void put32(unsigned char *data, int v)
-{
-  data[3] = (v >> 24) & 0xFF;
-  data[2] = (v >> 16) & 0xFF;
-  data[1] = (v >>  8) & 0xFF;
-  data[0] = v & 0xFF;
-}
-void put15s(unsigned char *data,const char *string)
-{
-  if (strlen(string)>15) {
-    fprintf(stderr ,"String must be less than 16 characters");
-    return;
-  }
-  strcpy((char*)data, string);
-  data[15] = 0;
+  fprintf(out, "  Kate info header version %d.%d\n",
+	info->major, info->minor);
+  fprintf(out, "   language: %s\n", info->language);
+  fprintf(out, "   category: %s\n", info->category);
+  fprintf(out, "   original canvas size: %dx%d\n",
+	info->canvas_width, info->canvas_height);
+  fprintf(out, "   frame rate %d:%d\n", info->fps_num, info->fps_den);
 }
-void put_canvas_size(unsigned char *data,int size)
+
+/* dump the bos pages as they're looked at */
+void dump_page(void *data, long long offset, rogg_page_header *header)
 {
-  size_t base=size;
-  size_t shift=0;
+  int j;
 
-  while (base&~((1<<12)-1)) {
-    /* we have a high bit we can't fit, increase shift if we wouldn't lose low bits */
-    if ((size>>shift)&1) {
-      fprintf(stderr,"Canvas size out of range\n");
-      return;
-    }
-    ++shift;
-    base>>=1;
-  }
-  if (shift>=16) {
-    fprintf(stderr,"Canvas size out of range\n");
-    return;
+  if (!header->bos) return;
+  rogg_page_print(stdout, header);
+  for (j = 0; j < header->length; j++) {
+    fprintf(stdout, " %02x", header->data[j]);
+    if (!((j+1)%4)) fprintf(stdout, " ");
+    if (!((j+1)%16)) fprintf(stdout, "\n");
   }
-  data[0]=(shift<<4)|(base&0xf);
-  data[1]=base>>4;
+  fprintf(stdout, "\n");
 }
 
-void print_header_info(FILE *out, rogg_page_header *header)
-{
-  fprintf(out, " Ogg page serial %08x seq %d (%5d bytes)",
-	header->serialno, header->sequenceno, header->length);
-  fprintf(out, (header->continued) ? " c" : "  ");
-  fprintf(out, " %lld", (long long int)header->granulepos);
-  fprintf(out, (header->bos) ? " bos" : "");
-  fprintf(out, (header->eos) ? " eos" : "");
-  fprintf(out, "\n");
-}
+/* the file being checked, for messages about skipped bytes */
+typedef struct {
+  FILE *out;
+  long long len;
+} skip_report;
 
-void print_kate_info(FILE *out, unsigned char *data)
+void report_skip(void *data, long long offset, long long len)
 {
-  char language[16], category[16];
-  int canvas_width = ((data[16]&0xf)|(data[17]<<4))<<(data[16]>>4);
-  int canvas_height = ((data[18]&0xf)|(data[19]<<4))<<(data[18]>>4);
-  memcpy(language, data+32, 16);
-  language[15] = 0;
-  memcpy(category, data+48, 16);
-  category[15] = 0;
+  skip_report *r = data;
 
-  fprintf(out, "  Kate info header version %d.%d\n",
-	data[9], data[10]);
-  fprintf(out, "   language: %s\n", language);
-  fprintf(out, "   category: %s\n", category);
-  fprintf(out, "   original canvas size: %dx%d\n", 
-	canvas_width, canvas_height);
-  fprintf(out, "   frame rate %d:%d\n", get32(data+24), get32(data+28));
+  if (offset == 0)
+    fprintf(r->out, "Skipped %d garbage bytes at the start\n", (int)len);
+  else if (offset + len == r->len)
+    fprintf(r->out, "Skipped %d garbage bytes as the end\n", (int)len);
+  else
+    fprintf(r->out, "Hole in data! skipped %d bytes\n", (int)len);
 }
 
 void print_usage(FILE *out, char *name)
@@ -136,7 +110,8 @@ void print_usage(FILE *out, char *name)
 		  "                common values: \n"
 		  "                        720x576, 1920x1080, etc \n"
 		  "    -l language set the language (ISO 639-1, RFC 3066)\n"
-		  "    -c category set the category (SUB, K-SPU, etc)\n");
+		  "    -c category set the category (SUB, K-SPU, etc)\n"
+		  "    -S          print library counters on exit\n");
 }
 
 int parse_args(int *argc, char *argv[])
@@ -149,6 +124,10 @@ int parse_args(int *argc, char *argv[])
     shift = 0;
     if (argv[arg][0] == '-') {
       switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
 	case 'v':
 	  verbose = 1;
 	  shift = 1;
@@ -194,17 +173,36 @@ int parse_args(int *argc, char *argv[])
 
 int main(int argc, char *argv[])
 {
-  int f, i;
-  unsigned char *p, *q, *o, *e;
+  int f, i, j;
+  unsigned char *p;
   struct stat s;
-  rogg_page_header header;
-  int changed=0;
+  rogg_kate_options opts;
+  rogg_kate_result result;
+  rogg_kate_stream *st;
+  rogg_arena arena;
+  skip_report report;
 
   parse_args(&argc, argv);
   if (argc < 2) {
     print_usage(stderr, argv[0]);
     exit(1);
   }
+  if ((language_set && strlen(language) > 15) ||
+      (category_set && strlen(category) > 15)) {
+    fprintf(stderr, "String must be less than 16 characters\n");
+    exit(1);
+  }
+  rogg_arena_init(&arena, 4096);
+  memset(&opts, 0, sizeof(opts));
+  opts.language = language_set ? language : NULL;
+  opts.category = category_set ? category : NULL;
+  opts.canvas_set = canvas_size_set;
+  opts.canvas_width = canvas_width;
+  opts.canvas_height = canvas_height;
+  opts.hooks.skip = report_skip;
+  if (verbose) opts.hooks.page = dump_page;
+  opts.hooks.data = &report;
+  report.out = stdout;
 
   for (i = 1; i < argc; i++) {
     f = open(argv[i], O_RDWR);
@@ -225,67 +223,34 @@ int main(int argc, char *argv[])
 	continue;
     }
     fprintf(stdout, "Checking Ogg file '%s'\n", argv[i]);
-    e = p + s.st_size; /* pointer to the end of the file */
-    q = rogg_scan(p, s.st_size); /* scan for an Ogg page */
-    if (q == NULL) {
+    report.len = s.st_size;
+    if (rogg_scan(p, s.st_size) == NULL)
 	fprintf(stdout, "couldn't find ogg data!\n");
-    } else {
-      if (q > p) {
-	fprintf(stdout, "Skipped %d garbage bytes at the start\n", (int)(q-p));
-      }
-      while (q < e) {
-	o = rogg_scan(q, e-q); /* find the next Ogg page */
-	if (o > q) {
-	  fprintf(stdout, "Hole in data! skipped %d bytes\n", (int)(o-q));
-	   q = o;
-	} else if (o == NULL) {
-	  fprintf(stdout, "Skipped %d garbage bytes as the end\n", (int)(e-q));
-	  break;
-	}
-	rogg_page_parse(q, &header);
-	if (!header.bos) break; /* only look at the initial bos pages */
-	if (verbose) {
-	  print_header_info(stdout, &header);
-	  int j;
-	  for (j = 0; j < header.length; j++) {
-	    fprintf(stdout, " %02x", header.data[j]);
-	    if (!((j+1)%4)) fprintf(stdout, " ");
-	    if (!((j+1)%16)) fprintf(stdout, "\n");
-	  }
-	  fprintf(stdout, "\n");
-	}
-	if (!memcmp(header.data, "\x80kate\0\0\0", 8)) {
-	  print_kate_info(stdout, header.data);
-	  if (canvas_size_set) {
-	    fprintf(stdout, "Setting canvas size to %dx%d\n",
+    if (rogg_kate_edit(p, s.st_size, &opts, &arena, &result) < 0) {
+	/* the strings were checked above, so it's the canvas */
+	fprintf(stderr, "Canvas size out of range\n");
+	exit(1);
+    }
+    for (j = 0; j < result.count; j++) {
+      st = &result.streams[j];
+      print_kate_info(stdout, &st->before);
+      if (canvas_size_set)
+	fprintf(stdout, "Setting canvas size to %dx%d\n",
 		canvas_width, canvas_height);
-            put_canvas_size(header.data+16,canvas_width);
-            put_canvas_size(header.data+18,canvas_height);
-            changed = 1;
-	  }
-	  if (language_set) {
-	    fprintf(stdout, "Setting language to %s\n",
-		language);
-            put15s(header.data+32, language);
-            changed = 1;
-	  }
-	  if (category_set) {
-	    fprintf(stdout, "Setting category to %s\n",
-		category);
-            put15s(header.data+48, category);
-            changed = 1;
-	  }
-	  if (changed) {
-	    rogg_page_update_crc(q);
-	    fprintf(stdout, "New settings:\n");
-	    print_kate_info(stdout, header.data);
-	  }
-        }
-	q += header.length;
+      if (language_set)
+	fprintf(stdout, "Setting language to %s\n", language);
+      if (category_set)
+	fprintf(stdout, "Setting category to %s\n", category);
+      if (st->changed) {
+	fprintf(stdout, "New settings:\n");
+	print_kate_info(stdout, &st->after);
       }
     }
+    rogg_arena_reset(&arena);
     munmap(p, s.st_size);
     close(f);
   }
+  rogg_arena_clear(&arena);
+  if (show_counters) rogg_counters_report(stderr);
   return 0;
 }
@@ -28,9 +28,21 @@
 /* opus header modification script using the rogg library */
 
 /* compile with
-   gcc -O2 -g -Wall -I. -o rogg_opus rogg.c rogg_opus.c -lm
+   gcc -O2 -g -Wall -I. -o rogg_opus rogg.c rogg_codec.c rogg_header.c \
+	rogg_comment.c rogg_output.c rogg_arena.c rogg_edit.c rogg_opus.c \
+	-lm -lpthread
 */
 
+/* Output gain can be set directly with -g, or computed from loudness
+   measurements with -L. The list has one 'file,LUFS' line per file,
+   giving the integrated loudness of the stream decoded without any
+   output gain, so rerunning the same list gives the same result. The
+   gain brings each file to the target loudness, and is written to the
+   identification header in place: only the bos page and its crc
+   change. When the OpusTags packet has padding to spare, the track
+   gain relative to the -23 LUFS R128 reference is recorded there too,
+   again without changing the size of anything. */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -41,58 +53,45 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 #include <math.h>
 
 #include <rogg.h>
 
+/* loudness reference for the R128_*_GAIN tags */
+#define R128_REFERENCE -23.0
+
+int show_counters = 0;
 int verbose = 0;
 int gain_set = 0;
 int gain;
+char *list = NULL;
+double target = R128_REFERENCE;
+int threads = 1;
 
-/* little endian accessors for the opus header data */
-int get16(unsigned char *data)
-{
-  return data[0] | (data[1] << 8);
-}
-int get32(unsigned char *data)
-{
-  return data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
-}
-void put16(unsigned char *data, int v)
-{
-  data[0] = v & 0xFF;
-  data[1] = (v >> 8) & 0xFF;
-}
-void put32(unsigned char *data, int v)
-{
-  data[0] = v & 0xFF;
-  data[1] = (v >>  8) & 0xFF;
-  data[2] = (v >> 16) & 0xFF;
-  data[3] = (v >> 24) & 0xFF;
-}
+/* a file to update, with its measured loudness if we have one */
+typedef struct {
+  char *name;
+  int measured;
+  double lufs;
+} job;
 
-void print_header_info(FILE *out, rogg_page_header *header)
-{
-  fprintf(out, " Ogg page serial %08x seq %d (%5d bytes)",
-	header->serialno, header->sequenceno, header->length);
-  fprintf(out, (header->continued) ? " c" : "  ");
-  fprintf(out, " %lld", (long long int)header->granulepos);
-  fprintf(out, (header->bos) ? " bos" : "");
-  fprintf(out, (header->eos) ? " eos" : "");
-  fprintf(out, "\n");
-}
+/* work shared between the threads */
+typedef struct {
+  job *jobs;
+  int count;
+  int next;
+  int failed;
+  pthread_mutex_t lock;
+} job_pool;
 
-void print_opus_info(FILE *out, unsigned char *data)
+void print_opus_info(FILE *out, rogg_opus_info *info)
 {
-  int version = data[8];
-  int channels = data[9];
-  int preskip = get16(data + 10);
-  int input = get32(data + 12);
-  short gain = get16(data + 16);
-  int mapping = data[18];
+  int channels = info->channels;
+  int mapping = info->mapping;
   fprintf(out, "  Opus info header version %d (%d.%d)\n",
-	version, version >> 4, version & 0xf);
+	info->version, info->version >> 4, info->version & 0xf);
   fprintf(out, "    channels %d%s\n", channels,
       channels == 0 ? " INVALID!" :
       channels == 1 && mapping == 0 ? " (mono)" :
@@ -108,19 +107,59 @@ void print_opus_info(FILE *out, unsigned char *data)
       channels > 8 && mapping == 1 ? " INVALID!" :
       mapping == 255 ?  "discrete" :
       " UNDEFINED");
-  fprintf(out, "    preskip %d samples\n", preskip);
-  fprintf(out, "    original sample rate %d Hz\n", input);
-  fprintf(out, "    output gain %d (%+.3lf dB)\n", gain, (double)gain/256.0);
+  fprintf(out, "    preskip %d samples\n", info->preskip);
+  fprintf(out, "    original sample rate %d Hz\n", info->input_rate);
+  fprintf(out, "    output gain %d (%+.3lf dB)\n", info->gain,
+	(double)info->gain/256.0);
   fprintf(out, "    channel mapping %d\n", mapping);
 }
 
+/* where skip reports go, and the file length to tell the end by */
+typedef struct {
+  FILE *out;
+  long long len;
+} skip_report;
+
+void report_skip(void *data, long long offset, long long len)
+{
+  skip_report *r = data;
+
+  if (offset == 0)
+    fprintf(r->out, "Skipped %d garbage bytes at the start\n", (int)len);
+  else if (offset + len == r->len)
+    fprintf(r->out, "Skipped %d garbage bytes as the end\n", (int)len);
+  else
+    fprintf(r->out, "Hole in data! skipped %d bytes\n", (int)len);
+}
+
+/* dump the bos pages as they're looked at */
+void dump_page(void *data, long long offset, rogg_page_header *header)
+{
+  FILE *out = ((skip_report *)data)->out;
+  int i;
+
+  if (!header->bos) return;
+  rogg_page_print(out, header);
+  for (i = 0; i < header->length; i++) {
+    fprintf(out, " %02x", header->data[i]);
+    if (!((i+1)%4)) fprintf(out, " ");
+    if (!((i+1)%16)) fprintf(out, "\n");
+  }
+  fprintf(out, "\n");
+}
+
 void print_usage(FILE *out, char *name)
 {
   fprintf(stderr, "Script for editing opus headers, in place.\n");
-  fprintf(stderr, "%s [-v] [-a num:den] [-f num:den] <file1.ogg> [<file2.ogg>...]\n",
-	name);
+  fprintf(stderr, "%s [-v] [-g gain] <file1.ogg> [<file2.ogg>...]\n", name);
+  fprintf(stderr, "%s [-v] -L list.csv [-t lufs] [-j threads]\n", name);
   fprintf(stderr, "    -v          print more information\n"
-		  "    -g gain     set the EBU R128 output gain\n");
+		  "    -g gain     set the output gain, in 1/256 dB steps\n"
+		  "    -L list     set the gain from a list of 'file,LUFS' lines\n"
+		  "    -t lufs     loudness to aim for with -L (default %.0f)\n"
+		  "    -j threads  number of files to work on at once\n"
+		  "    -S          print library counters on exit\n",
+		  R128_REFERENCE);
 }
 
 int parse_args(int *argc, char *argv[])
@@ -133,18 +172,46 @@ int parse_args(int *argc, char *argv[])
     shift = 0;
     if (argv[arg][0] == '-') {
       switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
 	case 'v':
 	  verbose = 1;
 	  shift = 1;
 	  break;
 	case 'g':
-	  gain_set = 1;
+	  shift = 2;
 	  /* read gain from the next arg */
-	  if (sscanf(argv[arg+1], "%d", &gain) != 1) {
-	    fprintf(stderr, "Could not parse gain '%s'.\n", argv[arg+1]);
-	    gain_set = 0;
+	  if (*argc - arg - shift < 0 || sscanf(argv[arg+1], "%d", &gain) != 1 ||
+		gain < -32768 || gain > 32767) {
+	    fprintf(stderr, "Option -g requires a gain from -32768 to 32767.\n");
+	    exit(1);
 	  }
+	  gain_set = 1;
+	  break;
+	case 'L':
 	  shift = 2;
+	  if (*argc - arg - shift < 0) {
+	    fprintf(stderr, "Option -L requires a loudness list.\n");
+	    exit(1);
+	  }
+	  list = argv[arg+1];
+	  break;
+	case 't':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 || sscanf(argv[arg+1], "%lf", &target) != 1) {
+	    fprintf(stderr, "Option -t requires a target loudness.\n");
+	    exit(1);
+	  }
+	  break;
+	case 'j':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 || sscanf(argv[arg+1], "%d", &threads) != 1 ||
+		threads < 1) {
+	    fprintf(stderr, "Option -j requires a number of threads.\n");
+	    exit(1);
+	  }
 	  break;
       }
     }
@@ -166,84 +233,262 @@ int parse_args(int *argc, char *argv[])
   return 0;
 }
 
-int main(int argc, char *argv[])
+/* read 'file,LUFS' lines, splitting at the last comma so names may
+   contain them. Blank lines, comments and lines without a number,
+   like a column header, are skipped. Returns the number of jobs. */
+int read_list(const char *path, job **jobs)
 {
-  int f, i;
-  unsigned char *p, *q, *o, *e;
-  struct stat s;
-  rogg_page_header header;
+  FILE *in;
+  char *line = NULL, *comma, *end, *name;
+  size_t size = 0;
+  ssize_t n;
+  int count = 0, room = 0, lineno = 0;
+  double lufs;
+  job *j;
 
-  parse_args(&argc, argv);
-  if (argc < 2) {
-    print_usage(stderr, argv[0]);
-    exit(1);
+  *jobs = NULL;
+  in = strcmp(path, "-") ? fopen(path, "r") : stdin;
+  if (in == NULL) {
+    fprintf(stderr, "couldn't open '%s'\n", path);
+    return -1;
   }
-
-  for (i = 1; i < argc; i++) {
-    f = open(argv[i], O_RDWR);
-    if (f < 0) {
-	fprintf(stderr, "couldn't open '%s'\n", argv[i]);
-	continue;
+  while ((n = getline(&line, &size, in)) >= 0) {
+    lineno++;
+    while (n > 0 && (line[n-1] == '\n' || line[n-1] == '\r')) line[--n] = '\0';
+    if (n == 0 || line[0] == '#') continue;
+    comma = strrchr(line, ',');
+    if (comma == NULL) {
+      fprintf(stderr, "%s:%d: no loudness, skipping\n", path, lineno);
+      continue;
     }
-    if (fstat(f, &s) < 0) {
-	fprintf(stderr, "couldn't stat '%s'\n", argv[i]);
-	close(f);
-	continue;
+    *comma = '\0';
+    lufs = strtod(comma + 1, &end);
+    while (*end == ' ' || *end == '\t') end++;
+    if (end == comma + 1 || *end != '\0' || !isfinite(lufs)) {
+      if (lineno > 1)
+	fprintf(stderr, "%s:%d: bad loudness '%s', skipping\n",
+		path, lineno, comma + 1);
+      continue;
     }
-    p = mmap(0, s.st_size, PROT_READ|PROT_WRITE,
-	MAP_SHARED, f, 0);
-    if (p == MAP_FAILED) {
-	fprintf(stderr, "couldn't mmap '%s'\n", argv[i]);
-	close(f);
-	continue;
+    name = line;
+    if (name[0] == '"' && comma - name > 1 && comma[-1] == '"') {
+      comma[-1] = '\0';
+      name++;
     }
-    fprintf(stdout, "Checking Ogg file '%s'\n", argv[i]);
-    e = p + s.st_size; /* pointer to the end of the file */
-    q = rogg_scan(p, s.st_size); /* scan for an Ogg page */
-    if (q == NULL) {
-	fprintf(stdout, "couldn't find ogg data!\n");
-    } else {
-      if (q > p) {
-	fprintf(stdout, "Skipped %d garbage bytes at the start\n", (int)(q-p));
-      }
-      while (q < e) {
-	o = rogg_scan(q, e-q); /* find the next Ogg page */
-	if (o > q) {
-	  fprintf(stdout, "Hole in data! skipped %d bytes\n", (int)(o-q));
-	   q = o;
-	} else if (o == NULL) {
-	  fprintf(stdout, "Skipped %d garbage bytes as the end\n", (int)(e-q));
-	  break;
-	}
-	rogg_page_parse(q, &header);
-	if (!header.bos) break; /* only look at the initial bos pages */
+    if (count == room) {
+      room = room * 2 + 64;
+      j = realloc(*jobs, room * sizeof(*j));
+      if (j == NULL) break;
+      *jobs = j;
+    }
+    j = &(*jobs)[count];
+    j->name = strdup(name);
+    if (j->name == NULL) break;
+    j->measured = 1;
+    j->lufs = lufs;
+    count++;
+  }
+  free(line);
+  if (in != stdin) fclose(in);
+
+  return count;
+}
+
+/* clamp a gain in dB to the Q7.8 range of the header */
+int gain_q78(double db)
+{
+  double q = round(db * 256.0);
+
+  if (q < -32768) return -32768;
+  if (q > 32767) return 32767;
+  return (int)q;
+}
+
+/* update the opus streams of one file, returns non-zero on failure */
+int process_file(FILE *out, job *j, rogg_arena *arena)
+{
+  int f, i, ret = 0;
+  unsigned char *p;
+  struct stat s;
+  rogg_opus_options opts;
+  rogg_opus_result result;
+  rogg_opus_stream *st;
+  skip_report report;
+  int set = gain_set || j->measured;
+
+  memset(&opts, 0, sizeof(opts));
+  opts.gain_set = set;
+  opts.gain = gain;
+  if (j->measured) {
+    opts.gain = gain_q78(target - j->lufs);
+    /* what it takes to get from the new output gain to the reference */
+    opts.track_set = 1;
+    opts.track = gain_q78(R128_REFERENCE - j->lufs) - opts.gain;
+  }
+  opts.hooks.skip = report_skip;
+  if (verbose) opts.hooks.page = dump_page;
+  opts.hooks.data = &report;
+  report.out = out;
+
+  f = open(j->name, set ? O_RDWR : O_RDONLY);
+  if (f < 0) {
+    fprintf(out, "couldn't open '%s'\n", j->name);
+    return -1;
+  }
+  if (fstat(f, &s) < 0) {
+    fprintf(out, "couldn't stat '%s'\n", j->name);
+    close(f);
+    return -1;
+  }
+  p = mmap(0, s.st_size, PROT_READ|(set ? PROT_WRITE : 0),
+	MAP_SHARED, f, 0);
+  if (p == MAP_FAILED) {
+    fprintf(out, "couldn't mmap '%s'\n", j->name);
+    close(f);
+    return -1;
+  }
+  report.len = s.st_size;
+  fprintf(out, "Checking Ogg file '%s'\n", j->name);
+  if (rogg_scan(p, s.st_size) == NULL) {
+    fprintf(out, "couldn't find ogg data!\n");
+    ret = -1;
+  } else if (rogg_opus_edit(p, s.st_size, &opts, arena, &result) < 0) {
+    fprintf(out, "couldn't allocate stream list\n");
+    ret = -1;
+  } else {
+    for (i = 0; i < result.count; i++) {
+      st = &result.streams[i];
+      if (!set || verbose) print_opus_info(out, &st->before);
+      if (set) {
 	if (verbose) {
-	  print_header_info(stdout, &header);
-	  int j;
-	  for (j = 0; j < header.length; j++) {
-	    fprintf(stdout, " %02x", header.data[j]);
-	    if (!((j+1)%4)) fprintf(stdout, " ");
-	    if (!((j+1)%16)) fprintf(stdout, "\n");
-	  }
-	  fprintf(stdout, "\n");
+	  fprintf(out, "New settings:\n");
+	  print_opus_info(out, &st->after);
+	} else {
+	  fprintf(out, "  stream %08x output gain %d (%+.3lf dB)\n",
+		st->serialno, st->after.gain, (double)st->after.gain/256.0);
 	}
-	if (!memcmp(header.data, "OpusHead", 8)) {
-	  print_opus_info(stdout, header.data);
-	  if (gain_set) {
-            fprintf(stderr, "Setting gain isn't yet supported.\n");
-	  }
-	  if (gain_set) {
-            put16(header.data+16, gain);
-	    rogg_page_update_crc(q);
-	    fprintf(stdout, "New settings:\n");
-	    print_opus_info(stdout, header.data);
-	  }
-        }
-	q += header.length;
+      }
+      if (!j->measured) continue;
+      switch (st->track) {
+	case 0:
+	  fprintf(out, "  stream %08x R128_TRACK_GAIN=%d\n",
+		st->serialno, opts.track);
+	  break;
+	case 1:
+	  fprintf(out, "  stream %08x no room for R128_TRACK_GAIN\n",
+		st->serialno);
+	  break;
+	default:
+	  fprintf(out, "  stream %08x couldn't update the comment header\n",
+		st->serialno);
+	  ret = -1;
       }
     }
-    munmap(p, s.st_size);
-    close(f);
+    if (set && !result.count) {
+      fprintf(out, "no opus streams in '%s'\n", j->name);
+      ret = -1;
+    }
   }
-  return 0;
+  munmap(p, s.st_size);
+  close(f);
+
+  return ret;
+}
+
+/* pull files off the shared list, printing each report as a whole */
+void *worker(void *data)
+{
+  job_pool *pool = data;
+  rogg_arena arena;
+  char *text;
+  size_t size;
+  FILE *out;
+  int i, ret;
+
+  rogg_arena_init(&arena, 0);
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    i = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+    if (i >= pool->count) break;
+
+    text = NULL;
+    out = open_memstream(&text, &size);
+    if (out == NULL) {
+      pthread_mutex_lock(&pool->lock);
+      pool->failed++;
+      pthread_mutex_unlock(&pool->lock);
+      continue;
+    }
+    ret = process_file(out, &pool->jobs[i], &arena);
+    rogg_arena_reset(&arena);
+    fclose(out);
+    pthread_mutex_lock(&pool->lock);
+    fputs(text, stdout);
+    if (ret) pool->failed++;
+    pthread_mutex_unlock(&pool->lock);
+    free(text);
+  }
+
+  rogg_arena_clear(&arena);
+  rogg_counters_merge();
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  job_pool pool;
+  pthread_t *tids;
+  int i, n;
+
+  parse_args(&argc, argv);
+  if (list == NULL && argc < 2) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+  if (list != NULL && gain_set) {
+    fprintf(stderr, "Options -g and -L can't be used together.\n");
+    exit(1);
+  }
+
+  if (list != NULL) {
+    pool.count = read_list(list, &pool.jobs);
+    if (pool.count < 0) exit(1);
+    if (argc > 1)
+      fprintf(stderr, "Ignoring files on the command line, using '%s'.\n",
+	list);
+  } else {
+    pool.count = argc - 1;
+    pool.jobs = calloc(pool.count, sizeof(*pool.jobs));
+    if (pool.jobs == NULL) exit(1);
+    for (i = 0; i < pool.count; i++) pool.jobs[i].name = argv[i + 1];
+  }
+  pool.next = 0;
+  pool.failed = 0;
+  pthread_mutex_init(&pool.lock, NULL);
+
+  n = threads < pool.count ? threads : pool.count;
+  tids = malloc((n > 0 ? n : 1) * sizeof(*tids));
+  for (i = 0; tids != NULL && i < n; i++) {
+    if (pthread_create(&tids[i], NULL, worker, &pool)) break;
+  }
+  if (tids == NULL || i == 0) {
+    /* no threads at all; do the work ourselves */
+    worker(&pool);
+    i = 0;
+  }
+  n = i;
+  for (i = 0; i < n; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  pthread_mutex_destroy(&pool.lock);
+  free(tids);
+
+  if (list != NULL) {
+    for (i = 0; i < pool.count; i++) free(pool.jobs[i].name);
+  }
+  free(pool.jobs);
+
+  if (show_counters) rogg_counters_report(stderr);
+  return pool.failed ? 1 : 0;
 }
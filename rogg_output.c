@@ -0,0 +1,297 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* per-page record output for the rogg utilities */
+
+/* Records are formatted by hand into a line buffer and handed to
+   stdio with a single fwrite(), so dumping a large file isn't
+   dominated by printf format parsing. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rogg.h"
+
+/* room for a page record, not counting the file name */
+#define ROGG_OUTPUT_LINE 256
+
+/* append helpers; each returns the new end of the buffer */
+static char *put_str(char *p, const char *s)
+{
+  while (*s) *p++ = *s++;
+  return p;
+}
+
+static char *put_uint(char *p, uint64_t v)
+{
+  char tmp[20];
+  int n = 0;
+
+  do {
+    tmp[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n) *p++ = tmp[--n];
+  return p;
+}
+
+static char *put_int(char *p, int64_t v)
+{
+  if (v < 0) {
+    *p++ = '-';
+    return put_uint(p, -(uint64_t)v);
+  }
+  return put_uint(p, v);
+}
+
+/* right aligned in a field of the given width, like %5d */
+static char *put_uint_width(char *p, uint64_t v, int width)
+{
+  char tmp[20];
+  int n = 0;
+
+  do {
+    tmp[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (width-- > n) *p++ = ' ';
+  while (n) *p++ = tmp[--n];
+  return p;
+}
+
+static char *put_hex32(char *p, uint32_t v)
+{
+  static const char digits[] = "0123456789abcdef";
+  int i;
+
+  for (i = 28; i >= 0; i -= 4) *p++ = digits[(v >> i) & 0xf];
+  return p;
+}
+
+static char *put_bool(char *p, int v)
+{
+  return put_str(p, v ? "true" : "false");
+}
+
+/* format the traditional one line page summary */
+static char *put_page_text(char *p, rogg_page_header *header)
+{
+  p = put_str(p, " Ogg page serial ");
+  p = put_hex32(p, header->serialno);
+  p = put_str(p, " seq ");
+  p = put_uint(p, header->sequenceno);
+  p = put_str(p, " (");
+  p = put_uint_width(p, header->length, 5);
+  p = put_str(p, " bytes)");
+  p = put_str(p, (header->continued) ? " c" : "  ");
+  p = put_str(p, " granule ");
+  p = put_int(p, (int64_t)header->granulepos);
+  if (header->bos) p = put_str(p, " bos");
+  if (header->eos) p = put_str(p, " eos");
+  *p++ = '\n';
+  return p;
+}
+
+void rogg_page_print(FILE *out, rogg_page_header *header)
+{
+  char line[ROGG_OUTPUT_LINE];
+  char *p = put_page_text(line, header);
+
+  fwrite(line, 1, p - line, out);
+}
+
+int rogg_output_format(const char *name)
+{
+  if (!strcmp(name, "text")) return ROGG_OUTPUT_TEXT;
+  if (!strcmp(name, "json")) return ROGG_OUTPUT_JSON;
+  if (!strcmp(name, "csv")) return ROGG_OUTPUT_CSV;
+  if (!strcmp(name, "binary")) return ROGG_OUTPUT_BINARY;
+  return -1;
+}
+
+void rogg_output_init(rogg_output *out, FILE *fp, int format)
+{
+  memset(out, 0, sizeof(*out));
+  out->fp = fp;
+  out->format = format;
+  out->file_index = -1;
+}
+
+int rogg_output_begin(rogg_output *out, const char *file)
+{
+  size_t len = strlen(file);
+  char *p;
+
+  free(out->name);
+  out->file_index++;
+  /* worst case every character in the name needs escaping; the
+     line buffer after it has room for the name plus the fields */
+  out->name = malloc(12*len + ROGG_OUTPUT_LINE);
+  out->line = (out->name != NULL) ? out->name + 6*len : NULL;
+  if (out->name == NULL) return -1;
+
+  /* quote the file name once for the whole file */
+  p = out->name;
+  if (out->format == ROGG_OUTPUT_JSON) {
+    for (; *file; file++) {
+      unsigned char c = *file;
+      if (c == '"' || c == '\\') {
+	*p++ = '\\';
+	*p++ = c;
+      } else if (c < 0x20) {
+	p = put_str(p, "\\u00");
+	*p++ = "0123456789abcdef"[c >> 4];
+	*p++ = "0123456789abcdef"[c & 0xf];
+      } else {
+	*p++ = c;
+      }
+    }
+  } else if (out->format == ROGG_OUTPUT_CSV) {
+    for (; *file; file++) {
+      if (*file == '"') *p++ = '"';
+      *p++ = *file;
+    }
+  }
+  out->name_len = p - out->name;
+
+  if (out->format == ROGG_OUTPUT_CSV && out->file_index == 0) {
+    fputs("file,offset,serialno,sequenceno,length,segments,"
+	"granulepos,continued,bos,eos,crc\n", out->fp);
+  }
+
+  return 0;
+}
+
+void rogg_output_page(rogg_output *out, long long offset,
+	rogg_page_header *header)
+{
+  char *p = out->line;
+
+  if (p == NULL) return;
+
+  switch (out->format) {
+    case ROGG_OUTPUT_TEXT:
+      p = put_page_text(p, header);
+      break;
+    case ROGG_OUTPUT_JSON:
+      p = put_str(p, "{\"file\":\"");
+      memcpy(p, out->name, out->name_len);
+      p += out->name_len;
+      p = put_str(p, "\",\"offset\":");
+      p = put_int(p, offset);
+      p = put_str(p, ",\"serialno\":");
+      p = put_uint(p, header->serialno);
+      p = put_str(p, ",\"sequenceno\":");
+      p = put_uint(p, header->sequenceno);
+      p = put_str(p, ",\"length\":");
+      p = put_uint(p, header->length);
+      p = put_str(p, ",\"segments\":");
+      p = put_uint(p, header->segments);
+      p = put_str(p, ",\"granulepos\":");
+      p = put_int(p, (int64_t)header->granulepos);
+      p = put_str(p, ",\"continued\":");
+      p = put_bool(p, header->continued);
+      p = put_str(p, ",\"bos\":");
+      p = put_bool(p, header->bos);
+      p = put_str(p, ",\"eos\":");
+      p = put_bool(p, header->eos);
+      p = put_str(p, ",\"crc\":");
+      p = put_uint(p, header->crc);
+      p = put_str(p, "}\n");
+      break;
+    case ROGG_OUTPUT_CSV:
+      *p++ = '"';
+      memcpy(p, out->name, out->name_len);
+      p += out->name_len;
+      p = put_str(p, "\",");
+      p = put_int(p, offset);
+      *p++ = ',';
+      p = put_uint(p, header->serialno);
+      *p++ = ',';
+      p = put_uint(p, header->sequenceno);
+      *p++ = ',';
+      p = put_uint(p, header->length);
+      *p++ = ',';
+      p = put_uint(p, header->segments);
+      *p++ = ',';
+      p = put_int(p, (int64_t)header->granulepos);
+      *p++ = ',';
+      *p++ = '0' + header->continued;
+      *p++ = ',';
+      *p++ = '0' + header->bos;
+      *p++ = ',';
+      *p++ = '0' + header->eos;
+      *p++ = ',';
+      p = put_uint(p, header->crc);
+      *p++ = '\n';
+      break;
+    case ROGG_OUTPUT_BINARY:
+      rogg_write_uint32((unsigned char *)p + 0, out->file_index);
+      rogg_write_uint32((unsigned char *)p + 4, header->serialno);
+      rogg_write_uint32((unsigned char *)p + 8, header->sequenceno);
+      rogg_write_uint32((unsigned char *)p + 12, header->length);
+      rogg_write_uint64((unsigned char *)p + 16, offset);
+      rogg_write_uint64((unsigned char *)p + 24, header->granulepos);
+      p[32] = header->flags;
+      p[33] = header->segments;
+      p[34] = 0;
+      p[35] = 0;
+      rogg_write_uint32((unsigned char *)p + 36, header->crc);
+      p += ROGG_OUTPUT_RECORD;
+      break;
+  }
+
+  fwrite(out->line, 1, p - out->line, out->fp);
+  out->rows++;
+}
+
+void rogg_output_skip(rogg_output *out, long long offset, long long bytes)
+{
+  char *p = out->line;
+
+  if (p == NULL || out->format != ROGG_OUTPUT_JSON) return;
+
+  p = put_str(p, "{\"file\":\"");
+  memcpy(p, out->name, out->name_len);
+  p += out->name_len;
+  p = put_str(p, "\",\"offset\":");
+  p = put_int(p, offset);
+  p = put_str(p, ",\"skipped\":");
+  p = put_int(p, bytes);
+  p = put_str(p, "}\n");
+  fwrite(out->line, 1, p - out->line, out->fp);
+}
+
+void rogg_output_finish(rogg_output *out)
+{
+  fflush(out->fp);
+  free(out->name);
+  out->name = NULL;
+  out->line = NULL;
+}
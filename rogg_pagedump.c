@@ -44,15 +44,55 @@
 
 #include <rogg.h>
 
-void print_header_info(FILE *out, rogg_page_header *header)
+int show_counters = 0;
+int format = ROGG_OUTPUT_TEXT;
+
+void print_usage(FILE *out, char *name)
 {
-  fprintf(out, " Ogg page serial %08x seq %d (%5d bytes)",
-	header->serialno, header->sequenceno, header->length);
-  fprintf(out, (header->continued) ? " c" : "  ");
-  fprintf(out, " granule %lld", (long long int)header->granulepos);
-  fprintf(out, (header->bos) ? " bos" : "");
-  fprintf(out, (header->eos) ? " eos" : "");
-  fprintf(out, "\n");
+  fprintf(stderr, "Dump the page headers of Ogg files\n");
+  fprintf(stderr, "%s [-o format] <file1.ogg> [<file2.ogg>...]\n",
+	name);
+  fprintf(stderr, "    -o format   text (default), json, csv or binary\n"
+		  "    -S          print library counters on exit\n");
+}
+
+int parse_args(int *argc, char *argv[])
+{
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'o':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+	      (format = rogg_output_format(argv[arg+1])) < 0) {
+	    fprintf(stderr, "Option -o requires one of text, json, csv or binary.\n");
+	    exit(1);
+	  }
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
 }
 
 int main(int argc, char *argv[])
@@ -61,6 +101,18 @@ int main(int argc, char *argv[])
   unsigned char *p, *q, *o, *e;
   struct stat s;
   rogg_page_header header;
+  rogg_output out;
+  /* free form messages only go with the text format */
+  FILE *msg;
+
+  parse_args(&argc, argv);
+  if (argc < 2) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+
+  rogg_output_init(&out, stdout, format);
+  msg = (format == ROGG_OUTPUT_TEXT) ? stdout : stderr;
 
   for (i = 1; i < argc; i++) {
     f = open(argv[i], O_RDONLY);
@@ -79,31 +131,41 @@ int main(int argc, char *argv[])
 	close(f);
 	continue;
     }
-    fprintf(stdout, "Dumping Ogg file '%s'\n", argv[i]);
+    if (format == ROGG_OUTPUT_TEXT) {
+      fprintf(stdout, "Dumping Ogg file '%s'\n", argv[i]);
+    }
+    if (rogg_output_begin(&out, argv[i])) {
+	fprintf(stderr, "couldn't allocate output buffer\n");
+	exit(1);
+    }
     e = p + s.st_size;
     q = rogg_scan(p, s.st_size);
     if (q == NULL) {
-	fprintf(stdout, "couldn't find ogg data!\n");
+	fprintf(msg, "couldn't find ogg data!\n");
     } else {
       if (q > p) {
-	fprintf(stdout, "Skipped %ld garbage bytes at the start\n", (long)(q-p));
+	fprintf(msg, "Skipped %ld garbage bytes at the start\n", (long)(q-p));
+	rogg_output_skip(&out, 0, q-p);
       }
       while (q < e) {
-	o = rogg_scan(q, e-q);
+	o = rogg_page_next(q, e, &header);
 	if (o > q) {
-	  fprintf(stdout, "Hole in data! skipped %ld bytes\n", (long)(o-q));
+	  fprintf(msg, "Hole in data! skipped %ld bytes\n", (long)(o-q));
+	  rogg_output_skip(&out, q-p, o-q);
 	   q = o;
 	} else if (o == NULL) {
-	  fprintf(stdout, "Skipped %ld garbage bytes as the end\n", (long)(e-q));
+	  fprintf(msg, "Skipped %ld garbage bytes as the end\n", (long)(e-q));
+	  rogg_output_skip(&out, q-p, e-q);
 	  break;
 	}
-	rogg_page_parse(q, &header);
-	print_header_info(stdout, &header);
+	rogg_output_page(&out, q-p, &header);
 	q += header.length;
       }
     }
     munmap(p, s.st_size);
     close(f);
   }
+  rogg_output_finish(&out);
+  if (show_counters) rogg_counters_report(stderr);
   return 0;
 }
@@ -0,0 +1,642 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* streaming page framer and batch file reader for the rogg library */
+
+/* The framer turns an arbitrary sequence of buffers into complete
+   pages, so files can be read with plain read()s instead of mmap().
+   The reader keeps a fixed pool of buffers busy across many files,
+   either through io_uring or a pool of threads doing pread(). */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#ifdef ROGG_HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#include "rogg.h"
+
+/* the carry buffer must hold a page which started near the end of
+   the previous carry, plus the rest of that page */
+#define ROGG_FRAMER_CARRY (2*ROGG_PAGE_MAX)
+
+int rogg_framer_init(rogg_framer *framer, rogg_page_callback page, void *data)
+{
+  memset(framer, 0, sizeof(*framer));
+  framer->carry = malloc(ROGG_FRAMER_CARRY);
+  framer->page = page;
+  framer->data = data;
+
+  return (framer->carry == NULL) ? -1 : 0;
+}
+
+void rogg_framer_clear(rogg_framer *framer)
+{
+  free(framer->carry);
+  framer->carry = NULL;
+  framer->fill = 0;
+}
+
+/* return nonzero if the len bytes at p could begin a capture pattern */
+static int rogg_framer_prefix(unsigned char *p, long len)
+{
+  static const char capture[] = "OggS";
+
+  return len < 4 && !memcmp(p, capture, len);
+}
+
+/* hand every complete page in buf to the callback; returns the
+   number of bytes consumed, or -1 if the callback asked to stop */
+static long rogg_framer_pages(rogg_framer *framer, unsigned char *buf,
+	long len, long long offset)
+{
+  unsigned char *q = buf;
+  unsigned char *e = buf + len;
+  unsigned char *o;
+  rogg_page_header header;
+  long tail, length = 0;
+
+  while (q < e) {
+    /* skip capture patterns which don't start a valid header */
+    o = rogg_scan(q, e - q);
+    while (o != NULL && (length = rogg_page_check(o, e - o)) < 0)
+      o = rogg_scan(o + 1, e - o - 1);
+    if (o == NULL) {
+      /* keep a few bytes in case they start a capture pattern */
+      tail = (e - q < 3) ? e - q : 3;
+      while (tail > 0 && !rogg_framer_prefix(e - tail, tail)) tail--;
+      if (e - tail > q) {
+        framer->garbage += e - tail - q;
+        framer->holes++;
+      }
+      return e - tail - buf;
+    }
+    if (o > q) {
+      framer->garbage += o - q;
+      framer->holes++;
+      q = o;
+    }
+    if (length == 0) break;	/* wait for the rest of the page */
+    rogg_page_parse(q, &header);
+    framer->pages++;
+    if (framer->page(framer->data, offset + (q - buf), &header)) return -1;
+    q += length;
+  }
+
+  return q - buf;
+}
+
+int rogg_framer_feed(rogg_framer *framer, unsigned char *buf, long len)
+{
+  long used, n;
+  int fill;
+
+  if (framer->fill > 0) {
+    /* complete the page held over from the last buffer */
+    fill = framer->fill;
+    n = ROGG_FRAMER_CARRY - fill;
+    if (n > len) n = len;
+    memcpy(framer->carry + fill, buf, n);
+    used = rogg_framer_pages(framer, framer->carry, fill + n, framer->offset);
+    if (used < 0) return 1;
+    if (used < fill) {
+      /* still incomplete, so everything we copied stays carried */
+      memmove(framer->carry, framer->carry + used, fill + n - used);
+      framer->fill = fill + n - used;
+      framer->offset += used;
+      return 0;
+    }
+    buf += used - fill;
+    len -= used - fill;
+    framer->offset += used;
+    framer->fill = 0;
+  }
+
+  /* parse pages straight out of the caller's buffer */
+  used = rogg_framer_pages(framer, buf, len, framer->offset);
+  if (used < 0) return 1;
+  memcpy(framer->carry, buf + used, len - used);
+  framer->fill = len - used;
+  framer->offset += used;
+
+  return 0;
+}
+
+void rogg_framer_finish(rogg_framer *framer)
+{
+  if (framer->fill > 0) {
+    framer->garbage += framer->fill;
+    framer->offset += framer->fill;
+    framer->fill = 0;
+  }
+}
+
+void rogg_reader_init(rogg_reader *reader)
+{
+  memset(reader, 0, sizeof(*reader));
+  reader->backend = ROGG_READER_AUTO;
+  reader->depth = 16;
+  reader->chunk = 1024*1024;
+}
+
+/* callback shim giving the framer callback its file index */
+typedef struct {
+  rogg_reader *reader;
+  int file;
+} rogg_reader_ref;
+
+static int rogg_reader_page(void *data, long long offset,
+	rogg_page_header *header)
+{
+  rogg_reader_ref *ref = data;
+
+  return ref->reader->page(ref->reader->data, ref->file, offset, header);
+}
+
+/* open a file for streaming, returns an errno value on failure */
+static int rogg_reader_open(char *name, int *fd, long long *size)
+{
+  struct stat s;
+
+  *fd = open(name, O_RDONLY);
+  if (*fd < 0) return errno;
+  if (fstat(*fd, &s) < 0) {
+    int error = errno;
+    close(*fd);
+    return error;
+  }
+  *size = s.st_size;
+#ifdef POSIX_FADV_SEQUENTIAL
+  posix_fadvise(*fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  return 0;
+}
+
+/* thread pool backend: each worker owns one buffer and
+   pulls whole files off a shared list */
+
+typedef struct {
+  rogg_reader *reader;
+  char **names;
+  int count;
+  int next;
+  pthread_mutex_t lock;
+} rogg_reader_pool;
+
+static void *rogg_reader_worker(void *data)
+{
+  rogg_reader_pool *pool = data;
+  rogg_reader *reader = pool->reader;
+  rogg_reader_ref ref;
+  rogg_framer framer;
+  unsigned char *buf;
+  long long size = 0, offset;
+  ssize_t got;
+  int fd, error, stop;
+
+  buf = malloc(reader->chunk);
+  if (buf == NULL) return NULL;
+  ref.reader = reader;
+
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    ref.file = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+    if (ref.file >= pool->count) break;
+
+    if (rogg_framer_init(&framer, rogg_reader_page, &ref)) {
+      reader->done(reader->data, ref.file, &framer, ENOMEM);
+      continue;
+    }
+    error = rogg_reader_open(pool->names[ref.file], &fd, &size);
+    if (!error) {
+      offset = 0;
+      stop = 0;
+      while (offset < size && !stop) {
+        got = pread(fd, buf, reader->chunk, offset);
+        if (got < 0) {
+          if (errno == EINTR) continue;
+          error = errno;
+          break;
+        }
+        if (got == 0) break;
+        offset += got;
+        stop = rogg_framer_feed(&framer, buf, got);
+      }
+      close(fd);
+    }
+    rogg_framer_finish(&framer);
+    reader->done(reader->data, ref.file, &framer, error);
+    rogg_framer_clear(&framer);
+  }
+
+  free(buf);
+  rogg_counters_merge();
+  return NULL;
+}
+
+static int rogg_reader_threads(rogg_reader *reader, int count, char **names)
+{
+  rogg_reader_pool pool;
+  pthread_t *threads;
+  int i, n;
+
+  n = (reader->depth < count) ? reader->depth : count;
+  if (n < 1) n = 1;
+  threads = malloc(n * sizeof(*threads));
+  if (threads == NULL) return -1;
+
+  pool.reader = reader;
+  pool.names = names;
+  pool.count = count;
+  pool.next = 0;
+  pthread_mutex_init(&pool.lock, NULL);
+
+  for (i = 0; i < n; i++) {
+    if (pthread_create(&threads[i], NULL, rogg_reader_worker, &pool)) break;
+  }
+  if (i == 0) {
+    /* no threads at all; do the work ourselves */
+    rogg_reader_worker(&pool);
+  }
+  n = i;
+  for (i = 0; i < n; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  pthread_mutex_destroy(&pool.lock);
+  free(threads);
+
+  return ROGG_READER_THREADS;
+}
+
+#ifdef ROGG_HAVE_IO_URING
+
+/* io_uring backend, talking to the kernel directly so we don't
+   depend on liburing. One thread submits reads for up to
+   ROGG_URING_AHEAD chunks of each open file and feeds completed
+   chunks to that file's framer in order. */
+
+#define ROGG_URING_AHEAD 4
+
+typedef struct {
+  int fd;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq_ring, *cq_ring;
+  size_t sq_size, cq_size, sqes_size;
+} rogg_uring;
+
+typedef struct {
+  int index;			/* position in the name list */
+  int fd;
+  int error;
+  long long size;
+  long long submitted;		/* offset of the next read to queue */
+  long long consumed;		/* offset of the next byte to frame */
+  int inflight;
+  int ready[ROGG_URING_AHEAD];	/* completed buffer per slot, or -1 */
+  long ready_len[ROGG_URING_AHEAD];
+  rogg_reader_ref ref;
+  rogg_framer framer;
+  int stop;
+} rogg_uring_file;
+
+typedef struct {
+  rogg_uring_file *file;
+  long long offset;
+  long filled;			/* bytes read so far, short reads resume */
+} rogg_uring_req;
+
+/* returned when the ring fails after files were started, so we
+   mustn't fall back and read them again */
+#define ROGG_URING_FAILED -2
+
+static int rogg_uring_setup(rogg_uring *ring, unsigned entries)
+{
+  struct io_uring_params params;
+
+  memset(ring, 0, sizeof(*ring));
+  memset(&params, 0, sizeof(params));
+  ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0) return -1;
+
+  ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_size = params.cq_off.cqes +
+	params.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  ring->sq_ring = mmap(0, ring->sq_size, PROT_READ|PROT_WRITE,
+	MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  ring->cq_ring = mmap(0, ring->cq_size, PROT_READ|PROT_WRITE,
+	MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+  ring->sqes = mmap(0, ring->sqes_size, PROT_READ|PROT_WRITE,
+	MAP_SHARED|MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED ||
+      ring->sqes == MAP_FAILED) {
+    if (ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_size);
+    if (ring->cq_ring != MAP_FAILED) munmap(ring->cq_ring, ring->cq_size);
+    if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    close(ring->fd);
+    return -1;
+  }
+
+  ring->sq_head = (unsigned *)((char *)ring->sq_ring + params.sq_off.head);
+  ring->sq_tail = (unsigned *)((char *)ring->sq_ring + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)((char *)ring->sq_ring + params.sq_off.array);
+  ring->cq_head = (unsigned *)((char *)ring->cq_ring + params.cq_off.head);
+  ring->cq_tail = (unsigned *)((char *)ring->cq_ring + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring +
+	params.cq_off.cqes);
+
+  return 0;
+}
+
+static void rogg_uring_teardown(rogg_uring *ring)
+{
+  munmap(ring->sq_ring, ring->sq_size);
+  munmap(ring->cq_ring, ring->cq_size);
+  munmap(ring->sqes, ring->sqes_size);
+  close(ring->fd);
+}
+
+/* queue a read; the caller guarantees there's room in the ring */
+static void rogg_uring_read(rogg_uring *ring, int fd, void *buf,
+	unsigned len, long long offset, uint64_t user_data)
+{
+  unsigned tail = *ring->sq_tail;
+  unsigned index = tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = (uintptr_t)buf;
+  sqe->len = len;
+  sqe->off = offset;
+  sqe->user_data = user_data;
+  ring->sq_array[index] = index;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* set up an idle slot for a file, ready to open or to report */
+static int rogg_uring_start(rogg_reader *reader, rogg_uring_file *file,
+	int index)
+{
+  int i;
+
+  memset(file, 0, sizeof(*file));
+  file->index = index;
+  file->fd = -1;
+  for (i = 0; i < ROGG_URING_AHEAD; i++) file->ready[i] = -1;
+  file->ref.reader = reader;
+  file->ref.file = index;
+  if (rogg_framer_init(&file->framer, rogg_reader_page, &file->ref)) {
+    file->error = ENOMEM;
+    return -1;
+  }
+
+  return 0;
+}
+
+/* open the next file on the list into an idle slot */
+static int rogg_uring_open(rogg_reader *reader, rogg_uring_file *file,
+	int index, char **names)
+{
+  if (rogg_uring_start(reader, file, index)) return -1;
+  file->error = rogg_reader_open(names[index], &file->fd, &file->size);
+
+  return file->error ? -1 : 0;
+}
+
+static void rogg_uring_close(rogg_reader *reader, rogg_uring_file *file)
+{
+  if (file->fd >= 0) close(file->fd);
+  rogg_framer_finish(&file->framer);
+  reader->done(reader->data, file->index, &file->framer, file->error);
+  rogg_framer_clear(&file->framer);
+  file->index = -1;
+}
+
+static int rogg_reader_uring(rogg_reader *reader, int count, char **names)
+{
+  rogg_uring ring;
+  rogg_uring_file *files;
+  rogg_uring_req *reqs;
+  unsigned char *pool;
+  int *idle, nidle;
+  int nfiles, active, next, pending;
+  int i, b, slot, error = 0;
+  unsigned head, tail;
+  long len;
+
+  if (rogg_uring_setup(&ring, reader->depth)) return -1;
+
+  nfiles = (reader->depth + ROGG_URING_AHEAD - 1) / ROGG_URING_AHEAD;
+  files = malloc(nfiles * sizeof(*files));
+  reqs = malloc(reader->depth * sizeof(*reqs));
+  idle = malloc(reader->depth * sizeof(*idle));
+  pool = malloc((size_t)reader->depth * reader->chunk);
+  if (files == NULL || reqs == NULL || idle == NULL || pool == NULL) {
+    free(files);
+    free(reqs);
+    free(idle);
+    free(pool);
+    rogg_uring_teardown(&ring);
+    return -1;
+  }
+  for (i = 0; i < reader->depth; i++) idle[i] = i;
+  nidle = reader->depth;
+  for (i = 0; i < nfiles; i++) files[i].index = -1;
+
+  next = 0;
+  active = 0;
+  pending = 0;
+  for (;;) {
+    /* fill idle file slots and queue reads while we have buffers */
+    for (i = 0; i < nfiles; i++) {
+      rogg_uring_file *file = &files[i];
+      while (file->index < 0 && next < count) {
+        if (rogg_uring_open(reader, file, next++, names) == 0) {
+          active++;
+          break;
+        }
+        rogg_uring_close(reader, file);
+      }
+      if (file->index < 0) continue;
+      while (nidle > 0 && !file->stop && !file->error &&
+          file->submitted < file->size &&
+          file->inflight < ROGG_URING_AHEAD) {
+        b = idle[--nidle];
+        reqs[b].file = file;
+        reqs[b].offset = file->submitted;
+        reqs[b].filled = 0;
+        len = reader->chunk;
+        if (len > file->size - file->submitted)
+          len = file->size - file->submitted;
+        rogg_uring_read(&ring, file->fd, pool + (size_t)b * reader->chunk,
+		len, file->submitted, b);
+        file->submitted += len;
+        file->inflight++;
+        pending++;
+      }
+    }
+    if (pending == 0 && active == 0 && next >= count) break;
+
+    /* submit everything queued and wait for at least one completion */
+    if (pending > 0 && syscall(__NR_io_uring_enter, ring.fd,
+        *ring.sq_tail - *ring.sq_head, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0
+        && errno != EINTR) {
+      error = errno;
+      break;
+    }
+
+    head = *ring.cq_head;
+    tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+      struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cq_mask];
+      rogg_uring_file *file;
+      b = cqe->user_data;
+      file = reqs[b].file;
+      slot = (reqs[b].offset / reader->chunk) % ROGG_URING_AHEAD;
+      len = reader->chunk;
+      if (len > file->size - reqs[b].offset)
+        len = file->size - reqs[b].offset;
+      head++;
+      if (cqe->res < 0) {
+        if (!file->error) file->error = -cqe->res;
+      } else if (cqe->res == 0) {
+        /* the file shrank under us */
+        if (reqs[b].filled < len && !file->error) file->error = EIO;
+      } else {
+        reqs[b].filled += cqe->res;
+        if (reqs[b].filled < len && !file->error) {
+          /* short read, queue the rest of the chunk */
+          rogg_uring_read(&ring, file->fd,
+		pool + (size_t)b * reader->chunk + reqs[b].filled,
+		len - reqs[b].filled, reqs[b].offset + reqs[b].filled, b);
+          continue;
+        }
+      }
+      file->ready[slot] = b;
+      file->ready_len[slot] = reqs[b].filled;
+      pending--;
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+    /* frame completed chunks in file order, recycling buffers */
+    for (i = 0; i < nfiles; i++) {
+      rogg_uring_file *file = &files[i];
+      if (file->index < 0) continue;
+      for (;;) {
+        slot = (file->consumed / reader->chunk) % ROGG_URING_AHEAD;
+        b = file->ready[slot];
+        if (b < 0 || reqs[b].offset != file->consumed) break;
+        if (!file->stop && !file->error) {
+          file->stop = rogg_framer_feed(&file->framer,
+		pool + (size_t)b * reader->chunk, file->ready_len[slot]);
+        }
+        len = reader->chunk;
+        if (len > file->size - file->consumed)
+          len = file->size - file->consumed;
+        file->consumed += len;
+        file->ready[slot] = -1;
+        file->inflight--;
+        idle[nidle++] = b;
+      }
+      if (file->inflight == 0 && (file->stop || file->error ||
+          file->consumed >= file->size)) {
+        rogg_uring_close(reader, file);
+        active--;
+      }
+    }
+  }
+
+  /* reads may still be in flight after a failure, so the ring has
+     to go before the buffers they point at */
+  rogg_uring_teardown(&ring);
+  if (error) {
+    for (i = 0; i < nfiles; i++) {
+      if (files[i].index < 0) continue;
+      if (!files[i].error) files[i].error = error;
+      rogg_uring_close(reader, &files[i]);
+    }
+    while (next < count) {
+      rogg_uring_start(reader, &files[0], next++);
+      files[0].error = error;
+      rogg_uring_close(reader, &files[0]);
+    }
+  }
+  free(files);
+  free(reqs);
+  free(idle);
+  free(pool);
+
+  return error ? ROGG_URING_FAILED : ROGG_READER_URING;
+}
+
+#endif /* ROGG_HAVE_IO_URING */
+
+int rogg_reader_run(rogg_reader *reader, int count, char **names)
+{
+  int ret = -1;
+
+  if (reader->depth < 1) reader->depth = 1;
+  if (reader->chunk < ROGG_PAGE_MAX) reader->chunk = ROGG_PAGE_MAX;
+
+#ifdef ROGG_HAVE_IO_URING
+  if (reader->backend != ROGG_READER_THREADS) {
+    ret = rogg_reader_uring(reader, count, names);
+    if (ret == ROGG_URING_FAILED) return -1;
+    if (ret >= 0 || reader->backend == ROGG_READER_URING) return ret;
+  }
+#endif
+  if (reader->backend != ROGG_READER_URING) {
+    ret = rogg_reader_threads(reader, count, names);
+  }
+
+  return ret;
+}
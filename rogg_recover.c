@@ -0,0 +1,571 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* salvage what can be read from a damaged ogg file */
+
+/* compile with
+   gcc -O2 -g -Wall -I. -o rogg_recover rogg.c rogg_writer.c \
+	rogg_recover.c -lpthread
+*/
+
+/* Recovery takes three passes. The first finds every page with a
+   valid crc, in byte ranges split between threads. Each range keeps
+   the chain of pages rogg_page_find gives from its start, along with
+   where each search began, so when the ranges are joined a page can
+   be taken as is whenever the joined walk is somewhere between that
+   start and the page. Anywhere else, such as a range starting inside
+   a page, the walk searches for itself until it meets a chain again.
+
+   The second pass works out what to keep. Sequence numbers show where
+   pages of a stream went missing, and the pieces of packets cut by a
+   loss are dropped: a packet is kept only if its first page has the
+   start and every following page is present up to the one finishing
+   it. Pages left without a finished packet get a granulepos of -1.
+
+   The last pass writes the pages with fresh sequence numbers,
+   continued flags matching what was kept, and the eos flag on the
+   last page of each stream and only there. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include <rogg.h>
+
+/* smallest range worth a thread of its own */
+#define CHUNK_MIN (1024*1024)
+
+/* a valid page, and where the search which found it started */
+typedef struct {
+  long long offset, from;
+} found_page;
+
+/* one thread's share of the file */
+typedef struct {
+  unsigned char *p, *start, *end, *e;
+  found_page *pages;
+  long count, room;
+  int failed;
+} chunk;
+
+/* what to do with a page */
+typedef struct {
+  long long offset;
+  long prev, next;		/* neighbouring pages of the stream */
+  int stream;
+  int lead, last;		/* range of lacing values to keep */
+  char keep;
+  char starts_ok;		/* the last packet's start is present */
+  char completes;		/* the last packet's end is present */
+} salvage_page;
+
+typedef struct {
+  uint32_t serialno;
+  long first, last;		/* pages */
+  long kept;			/* last page written, or -1 */
+  uint32_t sequenceno;		/* next to write */
+} salvage_stream;
+
+int show_counters = 0;
+int threads = 0;
+int report_only = 0;
+char *output = NULL;
+
+void print_usage(FILE *out, char *name)
+{
+  fprintf(out, "Recover the readable parts of damaged Ogg files\n");
+  fprintf(out, "%s [-o out.ogg] [-n] [-j threads] <file1.ogg> [<file2.ogg>...]\n",
+	name);
+  fprintf(out,
+		  "    -o out.ogg  where to write the recovered file, only with a\n"
+		  "                single input (default: the input name plus .recovered)\n"
+		  "    -n          only report what would be recovered\n"
+		  "    -j threads  threads to search each file with (default one per cpu)\n"
+		  "    -S          print library counters on exit\n"
+		  "\n");
+}
+
+int parse_args(int *argc, char *argv[])
+{
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'n':
+	  report_only = 1;
+	  shift = 1;
+	  break;
+	case 'o':
+	  shift = 2;
+	  if (*argc - arg - shift < 0) {
+	    fprintf(stderr, "Option -o requires an output file.\n");
+	    exit(1);
+	  }
+	  output = argv[arg+1];
+	  break;
+	case 'j':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%d", &threads) != 1 || threads < 1) {
+	    fprintf(stderr, "Option -j requires a number of threads.\n");
+	    exit(1);
+	  }
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
+}
+
+int chunk_add(chunk *c, long long offset, long long from)
+{
+  if (c->count == c->room) {
+    found_page *pages;
+    c->room = c->room * 2 + 1024;
+    pages = realloc(c->pages, c->room * sizeof(*pages));
+    if (pages == NULL) return -1;
+    c->pages = pages;
+  }
+  c->pages[c->count].offset = offset;
+  c->pages[c->count++].from = from;
+  return 0;
+}
+
+/* find the pages starting in one range of the file */
+void *chunk_work(void *data)
+{
+  chunk *c = data;
+  rogg_page_header header;
+  unsigned char *q = c->start, *o;
+
+  while (q < c->end) {
+    o = rogg_page_find(q, c->e, &header);
+    if (o == NULL || o >= c->end) break;
+    if (chunk_add(c, o - c->p, q - c->p) < 0) {
+      c->failed = 1;
+      break;
+    }
+    q = o + header.length;
+  }
+
+  rogg_counters_merge();
+  return NULL;
+}
+
+/* every page of the file in order, as a walk with rogg_page_find from
+   the start would find them; returns the count or -1 */
+long find_pages(unsigned char *p, long len, salvage_page **out,
+	long long *garbage, long *holes)
+{
+  rogg_page_header header;
+  salvage_page *pages = NULL;
+  chunk *chunks;
+  pthread_t *tids;
+  long long pos = 0, offset;
+  long count = 0, room = 0, k;
+  int n = threads, i, started, failed = 0;
+
+  if (len / n < CHUNK_MIN) n = len / CHUNK_MIN + 1;
+  chunks = calloc(n, sizeof(*chunks));
+  tids = calloc(n, sizeof(*tids));
+  if (chunks == NULL || tids == NULL) {
+    free(chunks);
+    free(tids);
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    chunks[i].p = p;
+    chunks[i].start = p + len / n * i;
+    chunks[i].end = (i == n - 1) ? p + len : p + len / n * (i + 1);
+    chunks[i].e = p + len;
+  }
+  for (started = 1; started < n; started++) {
+    if (pthread_create(&tids[started], NULL, chunk_work, &chunks[started]))
+      break;
+  }
+  chunk_work(&chunks[0]);
+  for (i = 1; i < started; i++) pthread_join(tids[i], NULL);
+  for (; i < n; i++) chunk_work(&chunks[i]);
+
+  /* join the chains */
+  *garbage = 0;
+  *holes = 0;
+  i = 0;
+  k = 0;
+  while (pos < len && !failed) {
+    /* the first page of any chain at or after pos */
+    while (i < n && (k >= chunks[i].count || chunks[i].pages[k].offset < pos)) {
+      if (k >= chunks[i].count) {
+	i++;
+	k = 0;
+      } else {
+	k++;
+      }
+    }
+    if (i < n && chunks[i].pages[k].from <= pos) {
+      offset = chunks[i].pages[k].offset;
+      rogg_page_parse(p + offset, &header);
+    } else {
+      unsigned char *o = rogg_page_find(p + pos, p + len, &header);
+      if (o == NULL) break;
+      offset = o - p;
+    }
+    if (offset > pos) {
+      *garbage += offset - pos;
+      (*holes)++;
+    }
+    if (count == room) {
+      salvage_page *more;
+      room = room * 2 + 1024;
+      more = realloc(pages, room * sizeof(*pages));
+      if (more == NULL) {
+	failed = 1;
+	break;
+      }
+      pages = more;
+    }
+    pages[count++].offset = offset;
+    pos = offset + header.length;
+  }
+  if (pos < len) {
+    *garbage += len - pos;
+    (*holes)++;
+  }
+
+  for (i = 0; i < n; i++) {
+    if (chunks[i].failed) failed = 1;
+    free(chunks[i].pages);
+  }
+  free(chunks);
+  free(tids);
+  if (failed) {
+    free(pages);
+    return -1;
+  }
+  *out = pages;
+  return count;
+}
+
+/* whether a packet runs on from page i of a stream to page next:
+   i ends part way through one, next continues it, and no page was
+   lost in between */
+int joined(unsigned char *p, salvage_page *pages, long i, long next)
+{
+  rogg_page_header a, b;
+
+  if (i < 0 || next < 0) return 0;
+  rogg_page_parse(p + pages[i].offset, &a);
+  rogg_page_parse(p + pages[next].offset, &b);
+  return a.segments && a.lacing[a.segments - 1] == 255 && b.continued &&
+	b.sequenceno == a.sequenceno + 1;
+}
+
+/* index of the first lacing value ending a packet, or -1 */
+int first_end(rogg_page_header *header)
+{
+  int i;
+
+  for (i = 0; i < header->segments; i++) {
+    if (header->lacing[i] < 255) return i;
+  }
+  return -1;
+}
+
+/* index of the last lacing value ending a packet, or -1 */
+int last_end(rogg_page_header *header)
+{
+  int i;
+
+  for (i = header->segments - 1; i >= 0; i--) {
+    if (header->lacing[i] < 255) return i;
+  }
+  return -1;
+}
+
+/* sort the pages into streams and decide which lacing values of each
+   to keep; returns the number of streams or -1 */
+int plan(unsigned char *p, salvage_page *pages, long count,
+	salvage_stream **out)
+{
+  rogg_page_header header, next;
+  salvage_stream *streams = NULL, *st;
+  long i;
+  int j, nstreams = 0, end, lead_ok;
+
+  for (i = 0; i < count; i++) {
+    rogg_page_parse(p + pages[i].offset, &header);
+    /* a bos page for a serial seen before starts a new link */
+    for (j = nstreams - 1; j >= 0; j--) {
+      if (streams[j].serialno == header.serialno) break;
+    }
+    if (j < 0 || header.bos) {
+      st = realloc(streams, (nstreams + 1) * sizeof(*st));
+      if (st == NULL) {
+	free(streams);
+	return -1;
+      }
+      streams = st;
+      j = nstreams++;
+      streams[j].serialno = header.serialno;
+      streams[j].first = i;
+      streams[j].last = -1;
+      streams[j].kept = -1;
+    }
+    pages[i].stream = j;
+    pages[i].prev = streams[j].last;
+    pages[i].next = -1;
+    if (streams[j].last >= 0) pages[streams[j].last].next = i;
+    streams[j].last = i;
+  }
+
+  /* whether the packet left unfinished at the end of each page has
+     its start, going forwards */
+  for (i = 0; i < count; i++) {
+    long prev = pages[i].prev;
+    rogg_page_parse(p + pages[i].offset, &header);
+    pages[i].starts_ok = !header.continued || first_end(&header) >= 0 ||
+	(joined(p, pages, prev, i) && pages[prev].starts_ok);
+  }
+
+  /* and whether it has its end, going backwards */
+  for (i = count - 1; i >= 0; i--) {
+    long nx = pages[i].next;
+    pages[i].completes = 0;
+    if (joined(p, pages, i, nx)) {
+      rogg_page_parse(p + pages[nx].offset, &next);
+      pages[i].completes = first_end(&next) >= 0 || pages[nx].completes;
+    }
+  }
+
+  for (i = 0; i < count; i++) {
+    long prev = pages[i].prev;
+    rogg_page_parse(p + pages[i].offset, &header);
+    lead_ok = joined(p, pages, prev, i) && pages[prev].starts_ok;
+    end = first_end(&header);
+    pages[i].lead = 0;
+    pages[i].last = header.segments;
+    if (end < 0) {
+      /* one packet passes through or starts on this page */
+      if (!pages[i].completes || (header.continued && !lead_ok))
+	pages[i].last = 0;
+    } else {
+      if (header.continued && !lead_ok) pages[i].lead = end + 1;
+      if (header.lacing[header.segments - 1] == 255 && !pages[i].completes)
+	pages[i].last = last_end(&header) + 1;
+    }
+    /* pages without packets are kept, but not ones emptied here */
+    pages[i].keep = pages[i].last > pages[i].lead || !header.segments;
+  }
+
+  *out = streams;
+  return nstreams;
+}
+
+/* write the kept pages; returns -1 on a write error */
+int salvage(int fd, unsigned char *p, salvage_page *pages, long count,
+	salvage_stream *streams, int nstreams, long *written, long *trimmed,
+	int *eos_fixed)
+{
+  rogg_writer w;
+  rogg_page_header header;
+  salvage_stream *st;
+  long i, k;
+  int j, body, finishes;
+
+  /* the last page written for each stream gets the eos flag */
+  for (i = 0; i < count; i++) {
+    if (pages[i].keep) streams[pages[i].stream].kept = i;
+  }
+  for (j = 0; j < nstreams; j++) {
+    /* numbering carries on from the first page found */
+    rogg_read_uint32(p + pages[streams[j].first].offset +
+	ROGG_OFFSET_SEQUENCENO, &streams[j].sequenceno);
+    i = streams[j].kept;
+    if (i < 0) continue;
+    rogg_page_parse(p + pages[i].offset, &header);
+    if (!header.eos) (*eos_fixed)++;
+  }
+
+  if (fd >= 0) rogg_writer_init(&w, fd);
+  for (i = 0; i < count; i++) {
+    if (!pages[i].keep) continue;
+    rogg_page_parse(p + pages[i].offset, &header);
+    st = &streams[pages[i].stream];
+    if (pages[i].lead || pages[i].last < header.segments) (*trimmed)++;
+    body = 0;
+    for (k = 0; k < pages[i].lead; k++) body += header.lacing[k];
+    finishes = 0;
+    header.length = ROGG_OFFSET_LACING + pages[i].last - pages[i].lead;
+    for (k = pages[i].lead; k < pages[i].last; k++) {
+      header.length += header.lacing[k];
+      if (header.lacing[k] < 255) finishes = 1;
+    }
+    header.data += body;
+    header.lacing += pages[i].lead;
+    header.segments = pages[i].last - pages[i].lead;
+    if (pages[i].lead) header.flags &= ~0x01;
+    if (!finishes) header.granulepos = -1;
+    header.flags &= ~0x04;
+    if (i == st->kept) header.flags |= 0x04;
+    header.sequenceno = st->sequenceno++;
+    (*written)++;
+    if (fd >= 0 && rogg_writer_page(&w, &header)) return -1;
+  }
+  if (fd >= 0 && rogg_writer_flush(&w)) return -1;
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  int f, o, i, nstreams, eos_fixed;
+  unsigned char *p;
+  struct stat s;
+  salvage_page *pages;
+  salvage_stream *streams;
+  long count, written, trimmed, holes;
+  long long garbage;
+  char *path;
+
+  parse_args(&argc, argv);
+  if (argc < 2 || (output != NULL && argc > 2)) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+  if (!threads) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? cpus : 1;
+  }
+
+  for (i = 1; i < argc; i++) {
+    f = open(argv[i], O_RDONLY);
+    if (f < 0) {
+	fprintf(stderr, "couldn't open '%s'\n", argv[i]);
+	continue;
+    }
+    if (fstat(f, &s) < 0 || s.st_size == 0) {
+	fprintf(stderr, "couldn't stat '%s'\n", argv[i]);
+	close(f);
+	continue;
+    }
+    p = mmap(0, s.st_size, PROT_READ, MAP_SHARED, f, 0);
+    if (p == MAP_FAILED) {
+	fprintf(stderr, "couldn't mmap '%s'\n", argv[i]);
+	close(f);
+	continue;
+    }
+    fprintf(stdout, "Checking Ogg file '%s'\n", argv[i]);
+    count = find_pages(p, s.st_size, &pages, &garbage, &holes);
+    if (count <= 0) {
+      fprintf(stdout, count < 0 ? "  out of memory\n" :
+	"  couldn't find ogg data!\n");
+      munmap(p, s.st_size);
+      close(f);
+      continue;
+    }
+    nstreams = plan(p, pages, count, &streams);
+    if (nstreams < 0) {
+      fprintf(stdout, "  out of memory\n");
+      free(pages);
+      munmap(p, s.st_size);
+      close(f);
+      continue;
+    }
+
+    o = -1;
+    path = NULL;
+    if (!report_only) {
+      if (output != NULL) {
+	path = strdup(output);
+      } else if ((path = malloc(strlen(argv[i]) + 11)) != NULL) {
+	sprintf(path, "%s.recovered", argv[i]);
+      }
+      if (path != NULL)
+	o = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+      if (o < 0) {
+	fprintf(stderr, "couldn't open '%s' for writing\n",
+		path != NULL ? path : "output");
+	free(path);
+	free(streams);
+	free(pages);
+	munmap(p, s.st_size);
+	close(f);
+	continue;
+      }
+    }
+    written = trimmed = 0;
+    eos_fixed = 0;
+    if (salvage(o, p, pages, count, streams, nstreams,
+		&written, &trimmed, &eos_fixed) < 0)
+      fprintf(stderr, "couldn't write '%s'\n", path);
+
+    fprintf(stdout, "  %ld valid pages in %d streams", count, nstreams);
+    if (garbage)
+      fprintf(stdout, ", skipped %lld bytes in %ld holes", garbage, holes);
+    fprintf(stdout, "\n  %ld pages %s, %ld trimmed to whole packets, "
+	"%d missing eos\n", written, report_only ? "to keep" : "written",
+	trimmed, eos_fixed);
+    if (o >= 0) {
+      fprintf(stdout, "  recovered to '%s'\n", path);
+      close(o);
+    }
+    free(path);
+    free(streams);
+    free(pages);
+    munmap(p, s.st_size);
+    close(f);
+  }
+  if (show_counters) rogg_counters_report(stderr);
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* correcting bit errors in ogg pages from their crc */
+
+/* The page crc is the page times x^32 modulo the polynomial, so a
+   flipped bit n places from the end of the page changes it by
+   x^(n+32). The difference between the stored and computed crcs,
+   the syndrome, is therefore x^(n+32) for a single bit error, and
+   the sum of two such terms for a double. One table of syndromes for
+   every bit position up to the longest possible page, sorted so it
+   can be searched by value, finds a single error directly and a
+   double one with a search per position.
+
+   The polynomial keeps single bit syndromes distinct at any page
+   length, but only separates every pair of bits on pages up to about
+   11 KB. Two bit corrections are only made when exactly one pair
+   explains the syndrome. Bits in the capture pattern and segment
+   table aren't considered, as the page couldn't have been found
+   with those damaged. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "rogg.h"
+
+/* bits in the longest possible page */
+#define ROGG_REPAIR_BITS (8 * (ROGG_OFFSET_LACING + 255 + 255*255))
+
+typedef struct {
+  uint32_t syndrome;
+  uint32_t n;			/* bits from the end of the page */
+} repair_entry;
+
+static repair_entry *repair_table = NULL;
+static pthread_once_t repair_once = PTHREAD_ONCE_INIT;
+
+/* multiply by x modulo the crc polynomial */
+static uint32_t repair_shift(uint32_t v)
+{
+  return (v << 1) ^ ((v & 0x80000000) ? 0x04c11db7 : 0);
+}
+
+static int repair_compare(const void *a, const void *b)
+{
+  const repair_entry *x = a, *y = b;
+
+  if (x->syndrome != y->syndrome) return x->syndrome < y->syndrome ? -1 : 1;
+  return 0;
+}
+
+static void repair_init(void)
+{
+  repair_entry *table = malloc(ROGG_REPAIR_BITS * sizeof(*table));
+  uint32_t v = 0x04c11db7;	/* x^32 */
+  long n;
+
+  if (table == NULL) return;
+  for (n = 0; n < ROGG_REPAIR_BITS; n++) {
+    table[n].syndrome = v;
+    table[n].n = n;
+    v = repair_shift(v);
+  }
+  qsort(table, ROGG_REPAIR_BITS, sizeof(*table), repair_compare);
+  repair_table = table;
+}
+
+/* bit position for a syndrome, or -1 */
+static long repair_find(uint32_t syndrome)
+{
+  long lo = 0, hi = ROGG_REPAIR_BITS;
+
+  while (lo < hi) {
+    long mid = lo + (hi - lo) / 2;
+    if (repair_table[mid].syndrome < syndrome) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo < ROGG_REPAIR_BITS && repair_table[lo].syndrome == syndrome)
+    return repair_table[lo].n;
+  return -1;
+}
+
+/* whether a bit n places from the end of a page of the given length
+   could have been flipped without losing the page, giving its
+   position as byte * 8 + bit */
+static int repair_allowed(rogg_page_header *header, long n, long *position)
+{
+  long byte;
+
+  if (n < 0 || n >= 8L * header->length) return 0;
+  byte = header->length - 1 - n / 8;
+  *position = byte * 8 + n % 8;
+  return (byte >= 4 && byte < ROGG_OFFSET_CRC) ||
+	byte >= ROGG_OFFSET_LACING + header->segments;
+}
+
+static int bit_count(uint32_t v)
+{
+  int count = 0;
+
+  for (; v; v &= v - 1) count++;
+  return count;
+}
+
+int rogg_page_repair(unsigned char *p, int max_bits, long *positions)
+{
+  rogg_page_header header;
+  uint32_t stored, syndrome, v;
+  long found[2], pos, at, other, n;
+  int i, bits = 0, solutions = 0;
+
+  rogg_page_parse(p, &header);
+  rogg_read_uint32(p + ROGG_OFFSET_CRC, &stored);
+  syndrome = stored ^ rogg_page_crc(p);
+  if (!syndrome) return 0;
+  if (max_bits < 1) return -1;
+
+  pthread_once(&repair_once, repair_init);
+  if (repair_table == NULL) return -1;
+
+  if (bit_count(syndrome) == 1) {
+    /* the crc itself was hit */
+    for (i = 0; !(syndrome & (1u << i)); i++);
+    found[bits++] = (ROGG_OFFSET_CRC + i / 8) * 8 + i % 8;
+  } else if (repair_allowed(&header, repair_find(syndrome), &pos)) {
+    found[bits++] = pos;
+  } else if (max_bits >= 2) {
+    /* both in the crc */
+    if (bit_count(syndrome) == 2) {
+      for (i = 0; i < 32; i++) {
+	if (syndrome & (1u << i))
+	  found[bits++] = (ROGG_OFFSET_CRC + i / 8) * 8 + i % 8;
+      }
+      solutions++;
+    }
+    /* one in the crc and one in the page */
+    for (i = 0; i < 32; i++) {
+      if (repair_allowed(&header, repair_find(syndrome ^ (1u << i)), &pos)) {
+	if (!solutions++) {
+	  bits = 2;
+	  found[0] = (ROGG_OFFSET_CRC + i / 8) * 8 + i % 8;
+	  found[1] = pos;
+	}
+      }
+    }
+    /* both in the page, taking each pair once */
+    v = 0x04c11db7;
+    for (n = 0; n < 8L * header.length && solutions < 2; n++) {
+      if (repair_allowed(&header, n, &pos)) {
+	other = repair_find(syndrome ^ v);
+	if (other > n && repair_allowed(&header, other, &at)) {
+	  if (!solutions++) {
+	    bits = 2;
+	    found[0] = pos;
+	    found[1] = at;
+	  }
+	}
+      }
+      v = repair_shift(v);
+    }
+    if (solutions != 1) return -1;
+  }
+  if (!bits) return -1;
+  if (bits == 2 && found[0] > found[1]) {
+    pos = found[0];
+    found[0] = found[1];
+    found[1] = pos;
+  }
+
+  for (i = 0; i < bits; i++) {
+    p[found[i] / 8] ^= 1 << (found[i] % 8);
+    if (positions != NULL) positions[i] = found[i];
+  }
+  return bits;
+}
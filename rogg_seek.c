@@ -0,0 +1,260 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* bisection seeking in an Ogg file held in memory */
+
+/* For codecs with a keyframe granule shift, granulepos counts packets:
+   the high bits are the number of the last keyframe and the low bits
+   the frames since. To find where to start decoding for a time we
+   bisect for the last page finishing a frame at or before it, take
+   the keyframe number from its granulepos, and bisect again for the
+   page before that keyframe. A short walk over the packets from there
+   finds the page the keyframe actually starts on, and whether a later
+   keyframe precedes the target frame. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rogg.h"
+
+/* below this many bytes we scan forward instead of bisecting */
+#define ROGG_SEEK_LINEAR 65536
+
+/* packet walking state */
+typedef struct {
+  unsigned char *page;		/* current page */
+  rogg_page_header header;
+  int seg;			/* next lacing value to look at */
+  unsigned char *data;		/* body data for seg */
+} seek_cursor;
+
+/* find the next intact page of the stream starting at or after p */
+static unsigned char *seek_next(unsigned char *p, unsigned char *e,
+	uint32_t serialno, rogg_page_header *header)
+{
+  while ((p = rogg_page_find(p, e, header)) != NULL) {
+    if (header->serialno == serialno) return p;
+    p += header->length;
+  }
+
+  return NULL;
+}
+
+/* frame count from a granulepos, like rogg_stream_frames without
+   the base and preskip adjustments */
+static int64_t seek_count(rogg_stream_info *info, int64_t granulepos)
+{
+  if (!info->shift) return granulepos;
+  return (granulepos >> info->shift) +
+	(granulepos & (((int64_t)1 << info->shift) - 1));
+}
+
+/* last page of the stream starting in [lo, hi) with a granulepos
+   whose frame count is below bound, or NULL if there isn't one */
+static unsigned char *seek_before(unsigned char *lo, unsigned char *hi,
+	unsigned char *e, rogg_stream_info *info, int64_t bound)
+{
+  rogg_page_header header;
+  unsigned char *best = NULL;
+  unsigned char *mid, *q;
+
+  while (hi - lo > ROGG_SEEK_LINEAR) {
+    mid = lo + (hi - lo) / 2;
+    q = seek_next(mid, e, info->serialno, &header);
+    while (q != NULL && q < hi && (int64_t)header.granulepos == -1)
+      q = seek_next(q + header.length, e, info->serialno, &header);
+    if (q == NULL || q >= hi) {
+      hi = mid;
+    } else if (seek_count(info, header.granulepos) < bound) {
+      best = q;
+      lo = q + header.length;
+    } else {
+      hi = mid;
+    }
+  }
+
+  q = seek_next(lo, e, info->serialno, &header);
+  while (q != NULL && q < hi) {
+    if ((int64_t)header.granulepos != -1) {
+      if (seek_count(info, header.granulepos) >= bound) break;
+      best = q;
+    }
+    q = seek_next(q + header.length, e, info->serialno, &header);
+  }
+
+  return best;
+}
+
+/* position a cursor on a page, at lacing value seg */
+static void seek_cursor_init(seek_cursor *c, unsigned char *page, int seg)
+{
+  int i;
+
+  c->page = page;
+  rogg_page_parse(page, &c->header);
+  c->seg = seg;
+  c->data = c->header.data;
+  for (i = 0; i < seg; i++) c->data += c->header.lacing[i];
+}
+
+/* position a cursor after the last packet to finish on a page */
+static void seek_cursor_after(seek_cursor *c, unsigned char *page)
+{
+  int i;
+
+  seek_cursor_init(c, page, 0);
+  for (i = c->header.segments - 1; i >= 0; i--) {
+    if (c->header.lacing[i] < 255) break;
+  }
+  seek_cursor_init(c, page, i + 1);
+}
+
+/* advance to the next packet starting in the stream, returning the
+   page it starts on and its first lacing segment, NULL at the end */
+static unsigned char *seek_packet(seek_cursor *c, unsigned char *e,
+	unsigned char **data, int *len)
+{
+  unsigned char *page;
+  int n;
+
+  while (c->seg >= c->header.segments) {
+    page = seek_next(c->page + c->header.length, e,
+	c->header.serialno, &c->header);
+    if (page == NULL) return NULL;
+    c->page = page;
+    c->seg = 0;
+    c->data = c->header.data;
+    /* skip the tail of a packet from the previous page */
+    if (c->header.continued) {
+      while (c->seg < c->header.segments) {
+	n = c->header.lacing[c->seg++];
+	c->data += n;
+	if (n < 255) break;
+      }
+    }
+  }
+
+  *data = c->data;
+  *len = c->header.lacing[c->seg];
+  while (c->seg < c->header.segments) {
+    n = c->header.lacing[c->seg++];
+    c->data += n;
+    if (n < 255) break;
+  }
+
+  return c->page;
+}
+
+long long rogg_seek_keyframe(unsigned char *p, long len,
+	rogg_stream_info *info, double t, int64_t *keyframe)
+{
+  const rogg_codec *codec = info->codec;
+  unsigned char *e = p + len;
+  unsigned char *q, *page, *start, *data;
+  seek_cursor cursor, first;
+  int64_t target, count, kq, next;
+  int i, n;
+
+  if (codec == NULL || info->headers < 0 ||
+	info->rate_num <= 0 || info->rate_den <= 0 || t < 0) return -1;
+
+  /* skip the header packets to find where the data starts */
+  q = seek_next(p, e, info->serialno, &cursor.header);
+  if (q == NULL) return -1;
+  seek_cursor_init(&cursor, q, 0);
+  for (i = 0; i < info->headers; i++) {
+    if (seek_packet(&cursor, e, &data, &n) == NULL) return -1;
+  }
+  first = cursor;
+  start = first.page;
+  if (first.seg >= first.header.segments) {
+    /* headers end the page, so data starts on the next one */
+    start = seek_next(start + first.header.length, e,
+	info->serialno, &first.header);
+    if (start == NULL) return -1;
+    seek_cursor_init(&first, start, 0);
+  }
+
+  /* granule count for the frame displayed at t */
+  target = (int64_t)(t * info->rate_num / info->rate_den);
+  target += 1 - info->frame_base + info->preskip;
+
+  if (codec->keyframe == NULL) {
+    /* every packet stands alone: start on the last page finishing
+       a packet before the target */
+    q = seek_before(start, e, e, info, target);
+    if (keyframe != NULL) *keyframe = -1;
+    return (q ? q : start) - p;
+  }
+
+  /* the keyframe of the last page finishing a frame by the target */
+  q = seek_before(start, e, e, info, target + 1);
+  if (q != NULL) {
+    rogg_page_header header;
+    rogg_page_parse(q, &header);
+    kq = seek_count(info, rogg_stream_keyframe(info, header.granulepos));
+  } else {
+    kq = 1 - info->frame_base;
+  }
+
+  /* the page before that keyframe */
+  q = seek_before(start, q ? q : start, e, info, kq);
+  if (codec->packet_keyframe == NULL) {
+    /* granules don't count packets, so that's as close as we get */
+    if (keyframe != NULL) *keyframe = kq << info->shift;
+    return (q ? q : start) - p;
+  }
+
+  /* walk the packets from there to find where the keyframe starts */
+  if (q != NULL) {
+    rogg_page_header header;
+    rogg_page_parse(q, &header);
+    seek_cursor_after(&cursor, q);
+    next = seek_count(info, header.granulepos) + 1;
+  } else {
+    cursor = first;
+    next = 1 - info->frame_base;
+  }
+  page = NULL;
+  count = kq;
+  while (next <= target) {
+    unsigned char *at = seek_packet(&cursor, e, &data, &n);
+    if (at == NULL) break;
+    if (next == kq || (next > kq && codec->packet_keyframe != NULL &&
+	codec->packet_keyframe(data, n))) {
+      page = at;
+      count = next;
+    }
+    next++;
+  }
+  if (page == NULL) return -1;
+
+  if (keyframe != NULL) *keyframe = count << info->shift;
+  return page - p;
+}
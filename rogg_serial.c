@@ -29,13 +29,21 @@
 /* ogg logical stream serial number mod script using the rogg library */
 
 /* compile with
-   gcc -O2 -g -Wall -I. -o rogg_serial rogg.c rogg_serial.c
+   gcc -O2 -g -Wall -I. -o rogg_serial rogg.c rogg_arena.c rogg_codec.c \
+	rogg_fix.c rogg_serial.c -lpthread
 */
 
+/* Any number of serial numbers are changed in one pass over each
+   file by rogg_serial_remap, which splits the file between threads.
+   Random and sequential renumbering work out the new serials from the
+   bos pages at the start of the file, and streams which only start in
+   a later link of a chained file get a second pass of their own. */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -45,40 +53,145 @@
 
 #include <rogg.h>
 
-unsigned int old_serial = 0;
-unsigned int new_serial = 0;
+/* the pairs given with -s and -m */
+typedef struct {
+  rogg_serial_pair *pairs;
+  int count, room;
+} serial_map;
+
+int show_counters = 0;
+int mode = ROGG_SERIAL_MAP;
+int threads = 0;
+uint32_t next_serial = 0;
+serial_map map;
 
 void print_usage(FILE *out, char *name)
 {
   fprintf(stderr, "Script for editing ogg headers\n");
-  fprintf(stderr, "%s [-s old:new] <file1.ogg> [<file2.ogg>...]\n",
-	name);
+  fprintf(stderr, "%s [-s old:new]... [-m map] [-r] [-n first] [-j threads] "
+	"<file1.ogg> [<file2.ogg>...]\n", name);
   fprintf(stderr,
 		  "    -s old:new  change the serial numer of a logical stream from old to new\n"
-		  "                (use hex values, e.g. 0x89ab4567:0x0123cdef)\n"
+		  "                (use hex values, e.g. 0x89ab4567:0x0123cdef); may be repeated\n"
+		  "    -m map      read old:new pairs from a file, one per line\n"
+		  "    -r          give every stream a new random serial number\n"
+		  "    -n first    number the streams in order, starting from first (hex)\n"
+		  "    -j threads  threads to split each file between (default one per cpu)\n"
+		  "    -S          print library counters on exit\n"
 		  "\n");
 }
 
+rogg_serial_pair *map_find(serial_map *m, uint32_t serial)
+{
+  int i;
+
+  for (i = 0; i < m->count; i++) {
+    if (m->pairs[i].old_serial == serial) return &m->pairs[i];
+  }
+  return NULL;
+}
+
+int map_add(serial_map *m, uint32_t old_serial, uint32_t new_serial)
+{
+  rogg_serial_pair *pair = map_find(m, old_serial);
+
+  if (pair != NULL) {
+    pair->new_serial = new_serial;
+    return 0;
+  }
+  if (m->count == m->room) {
+    m->room = m->room * 2 + 16;
+    pair = realloc(m->pairs, m->room * sizeof(*pair));
+    if (pair == NULL) return -1;
+    m->pairs = pair;
+  }
+  m->pairs[m->count].old_serial = old_serial;
+  m->pairs[m->count++].new_serial = new_serial;
+  return 0;
+}
+
+int map_read(const char *path)
+{
+  FILE *in = fopen(path, "r");
+  char line[256];
+  unsigned int old_serial, new_serial;
+  int lineno = 0;
+
+  if (in == NULL) {
+    fprintf(stderr, "couldn't open '%s'\n", path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), in) != NULL) {
+    lineno++;
+    if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') continue;
+    if (sscanf(line, "%x%*[: \t]%x", &old_serial, &new_serial) != 2) {
+      fprintf(stderr, "%s:%d: couldn't parse serial numbers\n", path, lineno);
+      fclose(in);
+      return -1;
+    }
+    if (map_add(&map, old_serial, new_serial) < 0) {
+      fclose(in);
+      return -1;
+    }
+  }
+  fclose(in);
+  return 0;
+}
+
 int parse_args(int *argc, char *argv[])
 {
   int arg = 1;
   int shift;
+  unsigned int old_serial, new_serial;
 
   while (arg < *argc) {
     shift = 0;
     if (argv[arg][0] == '-') {
       switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
 	case 's':
+	  shift = 2;
 	  /* read serial numbers from the next arg */
-	  if (sscanf(argv[arg+1], "%x:%x", &old_serial, &new_serial) !=2 ) {
-	    fprintf(stderr, "Could not parse serial numbers '%s'.\n", argv[arg+1]);
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%x:%x", &old_serial, &new_serial) != 2) {
+	    fprintf(stderr, "Could not parse serial numbers '%s'.\n",
+		*argc - arg - shift < 0 ? "" : argv[arg+1]);
 	    fprintf(stderr, "Try something like 0x89ab4567:0x0123cdef\n\n");
-	    old_serial = 0;
-	    new_serial = 0;
-	  } else {
-	    fprintf(stdout, "Changing serial 0x%08x to 0x%08x\n", old_serial, new_serial);
+	    exit(1);
+	  }
+	  fprintf(stdout, "Changing serial 0x%08x to 0x%08x\n", old_serial, new_serial);
+	  if (map_add(&map, old_serial, new_serial) < 0) exit(1);
+	  break;
+	case 'm':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 || map_read(argv[arg+1]) < 0) {
+	    fprintf(stderr, "Option -m requires a file of old:new pairs.\n");
+	    exit(1);
+	  }
+	  break;
+	case 'r':
+	  mode = ROGG_SERIAL_RANDOM;
+	  shift = 1;
+	  break;
+	case 'n':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%x", &next_serial) != 1) {
+	    fprintf(stderr, "Option -n requires a first serial number.\n");
+	    exit(1);
 	  }
+	  mode = ROGG_SERIAL_SEQUENTIAL;
+	  break;
+	case 'j':
 	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%d", &threads) != 1 || threads < 1) {
+	    fprintf(stderr, "Option -j requires a number of threads.\n");
+	    exit(1);
+	  }
 	  break;
       }
     }
@@ -94,23 +207,40 @@ int parse_args(int *argc, char *argv[])
       arg++;
     }
   }
+  if (mode != ROGG_SERIAL_MAP && map.count) {
+    fprintf(stderr, "Serial number pairs can't be combined with -r or -n.\n");
+    exit(1);
+  }
 
   return 0;
 }
 
 int main(int argc, char *argv[])
 {
-  int f, i;
-  unsigned char *p, *q, *o, *e;
+  int f, i, j;
+  unsigned char *p;
   struct stat s;
-  rogg_page_header header;
-  uint32_t serial;
+  rogg_serial_options opts;
+  rogg_serial_result result;
+  rogg_arena arena;
 
   parse_args(&argc, argv);
   if (argc < 2) {
     print_usage(stderr, argv[0]);
     exit(1);
   }
+  if (!threads) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? cpus : 1;
+  }
+  srandom(time(NULL) ^ getpid());
+  rogg_arena_init(&arena, 0);
+  memset(&opts, 0, sizeof(opts));
+  opts.mode = mode;
+  opts.pairs = map.pairs;
+  opts.count = map.count;
+  opts.first = next_serial;
+  opts.threads = threads;
 
   for (i = 1; i < argc; i++) {
     f = open(argv[i], O_RDWR);
@@ -118,7 +248,7 @@ int main(int argc, char *argv[])
 	fprintf(stderr, "couldn't open '%s'\n", argv[i]);
 	continue;
     }
-    if (fstat(f, &s) < 0) {
+    if (fstat(f, &s) < 0 || s.st_size == 0) {
 	fprintf(stderr, "couldn't stat '%s'\n", argv[i]);
 	close(f);
 	continue;
@@ -131,34 +261,26 @@ int main(int argc, char *argv[])
 	continue;
     }
     fprintf(stdout, "Checking Ogg file '%s'\n", argv[i]);
-    e = p + s.st_size; /* pointer to the end of the file */
-    q = rogg_scan(p, s.st_size); /* scan for an Ogg page */
-    if (q == NULL) {
-	fprintf(stdout, "couldn't find ogg data!\n");
+    /* a fresh sequence of random serials for each file */
+    opts.seed = ((uint64_t)random() << 32) ^ (uint64_t)random();
+    if (rogg_serial_remap(p, s.st_size, &opts, &arena, &result) < 0) {
+	fprintf(stderr, "couldn't plan the new serial numbers\n");
     } else {
-      if (q > p) {
-	fprintf(stdout, "Skipped %d garbage bytes at the start\n", (int)(q-p));
-      }
-      while (q < e) {
-	o = rogg_scan(q, e-q); /* find the next Ogg page */
-	if (o > q) {
-	  fprintf(stdout, "Hole in data! skipped %d bytes\n", (int)(o-q));
-	   q = o;
-	} else if (o == NULL) {
-	  fprintf(stdout, "Skipped %d garbage bytes as the end\n", (int)(e-q));
-	  break;
-	}
-	rogg_page_parse(q, &header);
-	rogg_read_uint32(&q[ROGG_OFFSET_SERIALNO], &serial);
-	if (serial == old_serial) {
-          rogg_write_uint32(&q[ROGG_OFFSET_SERIALNO], new_serial);
-          rogg_page_update_crc(q);
-	}
-	q += header.length;
-      }
+      for (j = 0; j < result.count; j++)
+	fprintf(stdout, "  serial 0x%08x is now 0x%08x\n",
+		result.assigned[j].old_serial, result.assigned[j].new_serial);
+      fprintf(stdout, "  %ld of %ld pages changed", result.changed,
+	result.pages);
+      if (result.garbage)
+	fprintf(stdout, ", skipped %lld garbage bytes", result.garbage);
+      fprintf(stdout, "\n");
     }
+    rogg_arena_reset(&arena);
     munmap(p, s.st_size);
     close(f);
   }
+  rogg_arena_clear(&arena);
+  free(map.pairs);
+  if (show_counters) rogg_counters_report(stderr);
   return 0;
 }
@@ -0,0 +1,787 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* ogg skeleton index generation and checking using the rogg library */
+
+/* compile with
+   gcc -O2 -g -Wall -I. -o rogg_skeleton rogg.c rogg_codec.c rogg_writer.c \
+	rogg_arena.c rogg_skeleton.c -lm
+*/
+
+/* A Skeleton 4.0 index lists, for each stream, keypoints giving the
+   offset of a page where decoding can start and the presentation time
+   of the first thing decoded there. One walk over the file finds the
+   candidates: pages starting a packet for codecs where every packet
+   stands alone, and pages starting a keyframe packet for those which
+   can tell, timed once a later granulepos says which frame it was.
+
+   The skeleton goes in front of the file: the fishead bos page first,
+   the other bos pages as they were, then the fisbone and index
+   packets and the skeleton eos page, and then the rest of the file
+   copied across. Keypoint offsets depend on the size of the index
+   itself, so it is built until the size stops changing. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <math.h>
+
+#include <rogg.h>
+
+/* keypoint times are in milliseconds */
+#define INDEX_DENOMINATOR 1000
+
+int show_counters = 0;
+int verbose = 0;
+int check = 0;
+double interval = 2.0;
+char *output = NULL;
+
+/* the streams and their keypoints, and the skeleton's packets, which
+   are rebuilt as the index size settles; both are reset per file */
+rogg_arena arena;
+rogg_arena packet_arena;
+
+typedef struct {
+  long long offset;		/* from the start of the first page */
+  double time;
+} keypoint;
+
+/* a keyframe packet waiting for a granulepos to time it */
+typedef struct {
+  long packet;
+  long long offset;
+} pending;
+
+typedef struct _stream {
+  uint32_t serialno;
+  rogg_stream_info info;
+  int indexed;			/* whether we can find keypoints */
+  long packets;			/* packets started, headers included */
+  long done;			/* packets finished */
+  int64_t last;			/* last granulepos seen */
+  keypoint *points;
+  long count, room;
+  pending *waiting;
+  long waits, wait_room;
+  struct _stream *next;
+} stream;
+
+/* the result of walking the file */
+typedef struct {
+  stream *streams;
+  stream *skeleton;		/* an existing skeleton stream */
+  unsigned char *first;		/* first page */
+  unsigned char *bos_end;	/* end of the leading bos pages */
+  long long content;		/* first page with data, -1 if none */
+} layout;
+
+void print_usage(FILE *out, char *name)
+{
+  fprintf(out, "Add or check an Ogg Skeleton 4.0 keypoint index.\n");
+  fprintf(out, "%s [-v] [-i seconds] [-o out.ogg] <file.ogg>\n", name);
+  fprintf(out, "%s -c [-v] <file1.ogg> [<file2.ogg>...]\n", name);
+  fprintf(out, "    -i seconds  time between keypoints (default %.0f)\n"
+		  "    -o out.ogg  write a new file instead of replacing the input\n"
+		  "    -c          check existing indexes against the pages\n"
+		  "    -v          print the keypoints\n"
+		  "    -S          print library counters on exit\n", interval);
+}
+
+int parse_args(int *argc, char *argv[])
+{
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'v':
+	  verbose = 1;
+	  shift = 1;
+	  break;
+	case 'c':
+	  check = 1;
+	  shift = 1;
+	  break;
+	case 'i':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%lf", &interval) != 1 || interval < 0) {
+	    fprintf(stderr, "Option -i requires a keypoint interval in seconds.\n");
+	    exit(1);
+	  }
+	  break;
+	case 'o':
+	  shift = 2;
+	  if (*argc - arg - shift < 0) {
+	    fprintf(stderr, "Option -o requires an output file.\n");
+	    exit(1);
+	  }
+	  output = argv[arg+1];
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
+}
+
+/* little endian output for the skeleton packets */
+void put64(unsigned char *p, int64_t v)
+{
+  rogg_write_uint64(p, (uint64_t)v);
+}
+
+/* keypoint fields are 7 bits a byte, the top bit marking the last */
+unsigned char *put_vlen(unsigned char *p, uint64_t v)
+{
+  while (v >= 0x80) {
+    *p++ = v & 0x7f;
+    v >>= 7;
+  }
+  *p++ = v | 0x80;
+  return p;
+}
+
+unsigned char *get_vlen(unsigned char *p, unsigned char *e, uint64_t *v)
+{
+  int shift = 0;
+
+  *v = 0;
+  while (p < e && shift < 64) {
+    *v |= (uint64_t)(*p & 0x7f) << shift;
+    if (*p++ & 0x80) return p;
+    shift += 7;
+  }
+  return NULL;
+}
+
+int add_keypoint(stream *s, long long offset, double time, double gap)
+{
+  keypoint *k;
+
+  if (s->count && time < s->points[s->count-1].time + gap) return 0;
+  if (s->count == s->room) {
+    k = rogg_arena_grow(&arena, s->points, s->room * sizeof(*k),
+	(s->room * 2 + 64) * sizeof(*k));
+    if (k == NULL) return -1;
+    s->points = k;
+    s->room = s->room * 2 + 64;
+  }
+  s->points[s->count].offset = offset;
+  s->points[s->count++].time = time;
+
+  return 0;
+}
+
+int add_pending(stream *s, long packet, long long offset)
+{
+  pending *w;
+
+  if (s->waits == s->wait_room) {
+    w = rogg_arena_grow(&arena, s->waiting, s->wait_room * sizeof(*w),
+	(s->wait_room * 2 + 16) * sizeof(*w));
+    if (w == NULL) return -1;
+    s->waiting = w;
+    s->wait_room = s->wait_room * 2 + 16;
+  }
+  s->waiting[s->waits].packet = packet;
+  s->waiting[s->waits++].offset = offset;
+
+  return 0;
+}
+
+/* time the keyframes up to the last packet finished on this page */
+int resolve_pending(stream *s, int64_t granulepos, double gap)
+{
+  long last = s->done - 1 - s->info.headers;
+  int64_t frames = rogg_stream_frames(&s->info, granulepos);
+  long i, j;
+
+  for (i = 0; i < s->waits && s->waiting[i].packet <= last; i++) {
+    /* frame counts are one more than the frame's start */
+    double t = (double)(frames - (last - s->waiting[i].packet) - 1) *
+	s->info.rate_den / s->info.rate_num;
+    if (t < 0) t = 0;
+    if (add_keypoint(s, s->waiting[i].offset, t, gap) < 0) return -1;
+  }
+  for (j = 0; i < s->waits; i++, j++) s->waiting[j] = s->waiting[i];
+  s->waits = j;
+
+  return 0;
+}
+
+/* find every stream's keypoints, at least gap seconds apart */
+int walk(unsigned char *p, unsigned char *e, layout *l, double gap)
+{
+  rogg_page_header header;
+  unsigned char *q, *data;
+  stream *s, **tail;
+  long long offset;
+  int i, starts;
+
+  memset(l, 0, sizeof(*l));
+  l->content = -1;
+  l->first = q = rogg_page_find(p, e, &header);
+  if (q == NULL) {
+    fprintf(stderr, "couldn't find ogg data\n");
+    return -1;
+  }
+  while (q != NULL) {
+    offset = q - l->first;
+    tail = &l->streams;
+    for (s = l->streams; s != NULL && s->serialno != header.serialno;
+	s = s->next) tail = &s->next;
+    if (header.bos) {
+      if (s != NULL || l->bos_end != NULL) {
+	fprintf(stderr, "chained files aren't supported\n");
+	return -1;
+      }
+      s = rogg_arena_calloc(&arena, 1, sizeof(*s));
+      if (s == NULL) return -1;
+      *tail = s;
+      s->serialno = header.serialno;
+      rogg_stream_info_init(&s->info, &header);
+      s->indexed = s->info.codec != NULL && s->info.headers > 0 &&
+	s->info.rate_num > 0 && s->info.rate_den > 0 &&
+	(s->info.codec->keyframe == NULL ||
+	 s->info.codec->packet_keyframe != NULL);
+      if (s->info.codec != NULL &&
+	  s->info.codec->id == ROGG_CODEC_SKELETON) l->skeleton = s;
+    } else {
+      if (l->bos_end == NULL) l->bos_end = q;
+      if (s == NULL) {
+	fprintf(stderr, "page of unknown stream %08x at %lld\n",
+		header.serialno, (long long)(q - p));
+	q = rogg_page_find(q + header.length, e, &header);
+	continue;
+      }
+    }
+
+    data = header.data;
+    for (i = 0; i < header.segments; i++) {
+      starts = i ? header.lacing[i-1] < 255 : !header.continued;
+      if (starts) {
+	if (s->info.headers >= 0 && s->packets >= s->info.headers) {
+	  if (l->content < 0) l->content = offset;
+	  if (s->indexed && s->info.codec->packet_keyframe != NULL) {
+	    if (s->info.codec->packet_keyframe(data, header.lacing[i]) &&
+		add_pending(s, s->packets - s->info.headers, offset) < 0)
+	      return -1;
+	  } else if (s->indexed && i == 0) {
+	    if (add_keypoint(s, offset, rogg_stream_time(&s->info,
+		s->last), gap) < 0) return -1;
+	  }
+	}
+	s->packets++;
+      }
+      if (header.lacing[i] < 255) s->done++;
+      data += header.lacing[i];
+    }
+    if ((int64_t)header.granulepos != -1) {
+      if (s->waits && resolve_pending(s, header.granulepos, gap) < 0)
+	return -1;
+      s->last = header.granulepos;
+    }
+    q = rogg_page_find(q + header.length, e, &header);
+  }
+  if (l->bos_end == NULL) l->bos_end = e;
+
+  return 0;
+}
+
+/* bytes taken by a packet paged on its own */
+long packet_size(long len)
+{
+  long lacing = len / 255 + 1;
+
+  return len + lacing + ROGG_OFFSET_LACING * ((lacing + 254) / 255);
+}
+
+const char *content_type(int codec)
+{
+  switch (codec) {
+    case ROGG_CODEC_VORBIS: return "audio/vorbis";
+    case ROGG_CODEC_OPUS: return "audio/opus";
+    case ROGG_CODEC_THEORA: return "video/theora";
+    case ROGG_CODEC_KATE: return "application/x-kate";
+    case ROGG_CODEC_SPEEX: return "audio/speex";
+    case ROGG_CODEC_FLAC: return "audio/flac";
+  }
+  return "application/octet-stream";
+}
+
+/* decoder pre-roll in packets, as the skeleton spec gives them */
+int preroll(int codec)
+{
+  switch (codec) {
+    case ROGG_CODEC_VORBIS: return 2;
+    case ROGG_CODEC_SPEEX: return 3;
+    case ROGG_CODEC_OPUS: return 4;
+  }
+  return 0;
+}
+
+/* the skeleton's packets, fishead first and the empty eos last */
+typedef struct {
+  int count, room;
+  unsigned char **data;
+  long *lengths;
+} packets;
+
+void packets_free(packets *k)
+{
+  rogg_arena_reset(&packet_arena);
+  memset(k, 0, sizeof(*k));
+}
+
+unsigned char *packets_add(packets *k, long len)
+{
+  unsigned char **data;
+  long *lengths;
+
+  if (k->count == k->room) {
+    data = rogg_arena_grow(&packet_arena, k->data,
+	k->room * sizeof(*data), (k->room * 2 + 16) * sizeof(*data));
+    if (data == NULL) return NULL;
+    k->data = data;
+    lengths = rogg_arena_grow(&packet_arena, k->lengths,
+	k->room * sizeof(*lengths), (k->room * 2 + 16) * sizeof(*lengths));
+    if (lengths == NULL) return NULL;
+    k->lengths = lengths;
+    k->room = k->room * 2 + 16;
+  }
+  k->data[k->count] = rogg_arena_calloc(&packet_arena, 1, len);
+  if (k->data[k->count] == NULL) return NULL;
+  k->lengths[k->count] = len;
+  return k->data[k->count++];
+}
+
+/* build the skeleton for a file of len bytes whose pages after the
+   bos ones move by delta. Returns the bytes the skeleton takes. */
+long long build(layout *l, long long len, long long delta, packets *k)
+{
+  unsigned char *d, *o;
+  long long size = 0, at;
+  stream *s;
+  char type[64];
+  int i;
+
+  packets_free(k);
+
+  /* fishead */
+  if ((d = packets_add(k, 80)) == NULL) return -1;
+  memcpy(d, "fishead\0", 8);
+  rogg_write_uint16(d + 8, 4);
+  rogg_write_uint16(d + 10, 0);
+  put64(d + 20, INDEX_DENOMINATOR);	/* presentation time 0 */
+  put64(d + 36, INDEX_DENOMINATOR);	/* base time 0 */
+  put64(d + 64, len + delta);
+  put64(d + 72, l->content < 0 ? len + delta : l->content + delta);
+
+  /* fisbones */
+  for (s = l->streams; s != NULL; s = s->next) {
+    i = snprintf(type, sizeof(type), "Content-Type: %s\r\n",
+	content_type(s->info.codec ? s->info.codec->id : 0));
+    if ((d = packets_add(k, 52 + i)) == NULL) return -1;
+    memcpy(d, "fisbone\0", 8);
+    rogg_write_uint32(d + 8, 44);
+    rogg_write_uint32(d + 12, s->serialno);
+    rogg_write_uint32(d + 16, s->info.headers > 0 ? s->info.headers : 0);
+    put64(d + 20, s->info.rate_num);
+    put64(d + 28, s->info.rate_den);
+    put64(d + 36, s->info.preskip);
+    rogg_write_uint32(d + 44, preroll(s->info.codec ? s->info.codec->id : 0));
+    d[48] = s->info.shift;
+    memcpy(d + 52, type, i);
+  }
+
+  /* indexes, with offsets and times as deltas from the last */
+  for (s = l->streams; s != NULL; s = s->next) {
+    if (!s->count) continue;
+    if ((d = packets_add(k, 42 + 20 * s->count)) == NULL) return -1;
+    memcpy(d, "index\0", 6);
+    rogg_write_uint32(d + 6, s->serialno);
+    put64(d + 10, s->count);
+    put64(d + 18, INDEX_DENOMINATOR);
+    put64(d + 26, llround(s->points[0].time * INDEX_DENOMINATOR));
+    put64(d + 34, llround(rogg_stream_time(&s->info, s->last) *
+	INDEX_DENOMINATOR));
+    o = d + 42;
+    at = 0;
+    {
+      int64_t t = 0, kt;
+      long j;
+      for (j = 0; j < s->count; j++) {
+	o = put_vlen(o, s->points[j].offset + delta - at);
+	at = s->points[j].offset + delta;
+	kt = llround(s->points[j].time * INDEX_DENOMINATOR);
+	o = put_vlen(o, kt - t);
+	t = kt;
+      }
+    }
+    k->lengths[k->count - 1] = o - d;
+  }
+
+  /* eos */
+  if (packets_add(k, 0) == NULL) return -1;
+
+  for (i = 0; i < k->count; i++) size += packet_size(k->lengths[i]);
+  return size;
+}
+
+uint32_t pick_serial(layout *l)
+{
+  uint32_t serialno = 0x736b656c;	/* 'skel' */
+  stream *s;
+
+  for (s = l->streams; s != NULL; s = s->next) {
+    if (s->serialno == serialno) {
+      serialno++;
+      s = l->streams;
+    }
+  }
+  return serialno;
+}
+
+int add_index(const char *path, int f, unsigned char *p, long long len)
+{
+  unsigned char *e = p + len;
+  layout l;
+  packets k = { 0, 0, NULL, NULL };
+  rogg_writer w;
+  long long delta = 0, size;
+  long long head, bos;
+  uint32_t serialno, sequenceno = 0;
+  struct stat st;
+  char *tmp = NULL;
+  int o = -1, i, tries, ret = -1;
+  stream *s;
+
+  if (walk(p, e, &l, interval) < 0) goto out;
+  if (l.skeleton != NULL) {
+    fprintf(stderr, "'%s' already has a skeleton track\n", path);
+    goto out;
+  }
+  head = l.first - p;
+  bos = l.bos_end - l.first;
+  len -= head;
+  if (l.content >= 0 && l.content < bos) {
+    fprintf(stderr, "data starts before the last bos page\n");
+    goto out;
+  }
+
+  /* keypoint offsets depend on how big the index is */
+  for (tries = 0; tries < 16; tries++) {
+    size = build(&l, len, delta, &k);
+    if (size < 0) goto out;
+    if (size == delta) break;
+    delta = size;
+  }
+  if (size != delta) {
+    fprintf(stderr, "couldn't settle the index size\n");
+    goto out;
+  }
+  if (verbose) {
+    for (s = l.streams; s != NULL; s = s->next) {
+      fprintf(stdout, "stream %08x %s: %ld keypoints\n", s->serialno,
+	rogg_codec_name(s->info.codec), s->count);
+      for (i = 0; i < s->count; i++)
+	fprintf(stdout, "  %12lld %10.3lf\n", s->points[i].offset + delta,
+		s->points[i].time);
+    }
+  }
+
+  if (output != NULL) {
+    o = open(output, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  } else {
+    tmp = malloc(strlen(path) + 8);
+    if (tmp == NULL) goto out;
+    sprintf(tmp, "%s.XXXXXX", path);
+    o = mkstemp(tmp);
+    if (o >= 0 && (fstat(f, &st) < 0 || fchmod(o, st.st_mode & 07777) < 0)) {
+      close(o);
+      unlink(tmp);
+      o = -1;
+    }
+  }
+  if (o < 0) {
+    fprintf(stderr, "couldn't create the output for '%s'\n", path);
+    goto out;
+  }
+
+  serialno = pick_serial(&l);
+  rogg_writer_init(&w, o);
+  if (rogg_writer_packet(&w, k.data[0], k.lengths[0], 0x02, 0,
+	serialno, &sequenceno) ||
+      rogg_writer_data(&w, l.first, bos)) goto fail;
+  for (i = 1; i < k.count; i++) {
+    if (rogg_writer_packet(&w, k.data[i], k.lengths[i],
+	i == k.count - 1 ? 0x04 : 0, 0, serialno, &sequenceno)) goto fail;
+  }
+  if (rogg_writer_copy(&w, f, p, head + bos, len - bos) ||
+      rogg_writer_flush(&w)) goto fail;
+  if (tmp != NULL && (fsync(o) < 0 || rename(tmp, path) < 0)) goto fail;
+  fprintf(stdout, "%s: skeleton %08x, %lld bytes of index\n",
+	output ? output : path, serialno, delta);
+  ret = 0;
+
+fail:
+  if (ret) {
+    fprintf(stderr, "couldn't write the new file for '%s'\n", path);
+    if (tmp != NULL) unlink(tmp);
+  }
+  close(o);
+out:
+  free(tmp);
+  packets_free(&k);
+  return ret;
+}
+
+/* collect the packets of the skeleton stream */
+int read_skeleton(unsigned char *e, layout *l, packets *k)
+{
+  rogg_page_header header;
+  unsigned char *q, *data, *d, *cur = NULL;
+  long len = 0, room = 0;
+  int i;
+
+  for (q = rogg_page_find(l->first, e, &header); q != NULL;
+	q = rogg_page_find(q + header.length, e, &header)) {
+    if (header.serialno != l->skeleton->serialno) continue;
+    data = header.data;
+    for (i = 0; i < header.segments; i++) {
+      if (len + header.lacing[i] > room) {
+	d = rogg_arena_grow(&arena, cur, len, room * 2 + 4096);
+	if (d == NULL) return -1;
+	cur = d;
+	room = room * 2 + 4096;
+      }
+      memcpy(cur + len, data, header.lacing[i]);
+      len += header.lacing[i];
+      data += header.lacing[i];
+      if (header.lacing[i] < 255) {
+	if ((d = packets_add(k, len)) == NULL) return -1;
+	memcpy(d, cur, len);
+	len = 0;
+      }
+    }
+    if (header.eos) break;
+  }
+
+  return 0;
+}
+
+/* the candidate keypoint at offset, or NULL */
+keypoint *find_keypoint(stream *s, long long offset)
+{
+  long lo = 0, hi = s->count, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (s->points[mid].offset < offset) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo < s->count && s->points[lo].offset == offset) return &s->points[lo];
+  return NULL;
+}
+
+/* check one index packet, returns the number of problems */
+long check_packet(layout *l, unsigned char *d, long len)
+{
+  unsigned char *q = d + 42, *e = d + len;
+  uint64_t count, den, offset = 0, time = 0, v;
+  uint32_t serialno;
+  long bad = 0;
+  keypoint *kp;
+  stream *s;
+  uint64_t i;
+
+  rogg_read_uint32(d + 6, &serialno);
+  rogg_read_uint64(d + 10, &count);
+  rogg_read_uint64(d + 18, &den);
+  for (s = l->streams; s != NULL && s->serialno != serialno; s = s->next);
+  if (s == NULL || !s->indexed) {
+    fprintf(stdout, "  index for %s stream %08x\n",
+	s ? "unindexable" : "unknown", serialno);
+    return 1;
+  }
+  if ((int64_t)den <= 0) {
+    fprintf(stdout, "  stream %08x: bad timestamp denominator\n", s->serialno);
+    return 1;
+  }
+  for (i = 0; i < count; i++) {
+    if ((q = get_vlen(q, e, &v)) == NULL) break;
+    offset += v;
+    if ((q = get_vlen(q, e, &v)) == NULL) break;
+    time += v;
+    kp = find_keypoint(s, offset);
+    if (kp == NULL) {
+      if (verbose) fprintf(stdout, "  %08x: no keypoint at %llu\n",
+	s->serialno, (unsigned long long)offset);
+      bad++;
+    } else if (fabs(kp->time - (double)time / den) > 1.0 / den + 1e-6) {
+      if (verbose) fprintf(stdout, "  %08x: keypoint at %llu is %.3lf s, "
+	"not %.3lf s\n", s->serialno, (unsigned long long)offset, kp->time,
+	(double)time / den);
+      bad++;
+    }
+  }
+  if (i < count) {
+    fprintf(stdout, "  stream %08x: index truncated after %llu of %llu "
+	"keypoints\n", s->serialno, (unsigned long long)i,
+	(unsigned long long)count);
+    bad++;
+  }
+  fprintf(stdout, "  stream %08x %s: %llu keypoints, %ld bad\n", s->serialno,
+	rogg_codec_name(s->info.codec), (unsigned long long)count, bad);
+
+  return bad;
+}
+
+/* compare an existing index with the pages, returns nonzero on mismatch */
+int check_index(const char *path, unsigned char *p, long long len)
+{
+  unsigned char *e = p + len, *d;
+  layout l;
+  packets k = { 0, 0, NULL, NULL };
+  uint64_t v;
+  long problems = 0;
+  int i, indexes = 0, ret = -1;
+
+  fprintf(stdout, "Checking Ogg file '%s'\n", path);
+  if (walk(p, e, &l, 0) < 0) goto out;
+  if (l.skeleton == NULL) {
+    fprintf(stdout, "  no skeleton track\n");
+    goto out;
+  }
+  if (read_skeleton(e, &l, &k) < 0) goto out;
+  d = k.count ? k.data[0] : NULL;
+  if (d == NULL || k.lengths[0] < 80 || d[8] + (d[9] << 8) < 4) {
+    fprintf(stdout, "  skeleton %08x is too old to have an index\n",
+	l.skeleton->serialno);
+    goto out;
+  }
+  rogg_read_uint64(d + 64, &v);
+  if (v != (uint64_t)(e - l.first)) {
+    fprintf(stdout, "  segment length %llu, file has %lld bytes\n",
+	(unsigned long long)v, (long long)(e - l.first));
+    problems++;
+  }
+  rogg_read_uint64(d + 72, &v);
+  if (l.content >= 0 && v != (uint64_t)l.content) {
+    fprintf(stdout, "  content offset %llu, data starts at %lld\n",
+	(unsigned long long)v, l.content);
+    problems++;
+  }
+  for (i = 1; i < k.count; i++) {
+    if (k.lengths[i] < 42 || memcmp(k.data[i], "index\0", 6)) continue;
+    problems += check_packet(&l, k.data[i], k.lengths[i]);
+    indexes++;
+  }
+  if (!indexes) fprintf(stdout, "  no index packets\n");
+  ret = (problems || !indexes) ? -1 : 0;
+
+out:
+  packets_free(&k);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  int f, i, ret = 0;
+  unsigned char *p;
+  struct stat s;
+
+  parse_args(&argc, argv);
+  if (argc < 2 || (!check && argc != 2)) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+  rogg_arena_init(&arena, 0);
+  rogg_arena_init(&packet_arena, 0);
+
+  for (i = 1; i < argc; i++) {
+    f = open(argv[i], O_RDONLY);
+    if (f < 0) {
+      fprintf(stderr, "couldn't open '%s'\n", argv[i]);
+      ret = 1;
+      continue;
+    }
+    if (fstat(f, &s) < 0 || s.st_size == 0) {
+      fprintf(stderr, "couldn't stat '%s'\n", argv[i]);
+      close(f);
+      ret = 1;
+      continue;
+    }
+    p = mmap(0, s.st_size, PROT_READ, MAP_SHARED, f, 0);
+    if (p == MAP_FAILED) {
+      fprintf(stderr, "couldn't mmap '%s'\n", argv[i]);
+      close(f);
+      ret = 1;
+      continue;
+    }
+    if (check) {
+      if (check_index(argv[i], p, s.st_size) < 0) ret = 1;
+    } else {
+      if (add_index(argv[i], f, p, s.st_size) < 0) ret = 1;
+    }
+    rogg_arena_reset(&arena);
+    munmap(p, s.st_size);
+    close(f);
+  }
+  rogg_arena_clear(&arena);
+  rogg_arena_clear(&packet_arena);
+
+  if (show_counters) rogg_counters_report(stderr);
+  return ret;
+}
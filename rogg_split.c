@@ -0,0 +1,518 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* ogg file splitting at time boundaries using the rogg library */
+
+/* compile with
+   gcc -O2 -g -Wall -I. -o rogg_split rogg.c rogg_codec.c rogg_writer.c \
+	rogg_split.c
+*/
+
+/* The file is read once, front to back. Header pages of each stream
+   are kept aside, and data pages are collected for the current
+   segment until a page of the key stream, the first video stream or
+   else the first stream we know the timing of, starts at or after the
+   next boundary. Video cuts only where a keyframe packet starts on
+   the page and audio where a packet does. Other streams can't choose
+   their pages, so those after a stream's last page ending a packet
+   are carried over into the next segment rather than leaving a packet
+   split between the two. The finished segment is
+   written as a complete file: every stream's header pages, then its
+   data pages with sequence numbers following on from the headers and
+   eos set on each stream's last page. Page bodies are written straight
+   from the mapping with new crcs over the rewritten headers.
+
+   Granule positions are kept, so later segments carry on the original
+   timestamps the way a stream joined part way through does. Opus
+   pre-skip is cleared after the first segment since the samples it
+   would drop are real audio there. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <rogg.h>
+
+int show_counters = 0;
+int verbose = 0;
+double duration = 600;
+char *pattern = NULL;
+
+typedef struct _stream {
+  uint32_t serialno;
+  rogg_stream_info info;
+  int skip;			/* not copied to the segments */
+  int in_headers;		/* still reading header pages */
+  int finished;			/* header packets finished so far */
+  unsigned char **hpages;	/* header pages, bos first */
+  int hcount;
+  int64_t last;			/* last granulepos seen, or -1 */
+  int last_page;		/* its last page in the segment, or -1 */
+  int clean_page;		/* the last one ending a packet, or -1 */
+  int cut_page;			/* the last one to write out, or -1 */
+  uint32_t sequenceno;		/* next sequence number in the segment */
+  struct _stream *next;
+} stream;
+
+/* a data page waiting for its segment to be written */
+typedef struct {
+  rogg_page_header header;
+  stream *s;
+} seg_page;
+
+typedef struct {
+  stream *streams;
+  stream *key;
+  seg_page *pages;
+  long count, room;
+  int index;			/* segment number */
+  double next;			/* time of the next cut, or -1 before the first */
+} splitter;
+
+void print_usage(FILE *out, char *name)
+{
+  fprintf(out, "Split an Ogg file into segments of a given duration.\n");
+  fprintf(out, "%s [-v] [-d seconds] [-o pattern] <file.ogg>\n", name);
+  fprintf(out, "    -d seconds  length of each segment (default %.0f)\n"
+		  "    -o pattern  output file names, with one %%d for the segment\n"
+		  "                number (default <file>-%%03d.ogg)\n"
+		  "    -v          print where each segment starts\n"
+		  "    -S          print library counters on exit\n", duration);
+}
+
+int parse_args(int *argc, char *argv[])
+{
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'v':
+	  verbose = 1;
+	  shift = 1;
+	  break;
+	case 'd':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+		sscanf(argv[arg+1], "%lf", &duration) != 1 || duration <= 0) {
+	    fprintf(stderr, "Option -d requires a segment length in seconds.\n");
+	    exit(1);
+	  }
+	  break;
+	case 'o':
+	  shift = 2;
+	  if (*argc - arg - shift < 0) {
+	    fprintf(stderr, "Option -o requires a file name pattern.\n");
+	    exit(1);
+	  }
+	  pattern = argv[arg+1];
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
+}
+
+/* the pattern must have exactly one integer conversion */
+int pattern_ok(const char *p)
+{
+  int conversions = 0;
+
+  while ((p = strchr(p, '%')) != NULL) {
+    p++;
+    if (*p == '%') {
+      p++;
+      continue;
+    }
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p != 'd') return 0;
+    conversions++;
+  }
+  return conversions == 1;
+}
+
+/* the default pattern, the input name without .ogg and a number */
+char *default_pattern(const char *name)
+{
+  size_t n = strlen(name);
+  char *p = malloc(2 * n + 16);
+  char *o = p;
+
+  if (p == NULL) return NULL;
+  if (n > 4 && !strcmp(name + n - 4, ".ogg")) n -= 4;
+  while (n--) {
+    if (*name == '%') *o++ = '%';
+    *o++ = *name++;
+  }
+  strcpy(o, "-%03d.ogg");
+  return p;
+}
+
+void stream_free(stream *s)
+{
+  stream *next;
+
+  while (s != NULL) {
+    next = s->next;
+    free(s->hpages);
+    free(s);
+    s = next;
+  }
+}
+
+stream *stream_add(splitter *sp, rogg_page_header *header)
+{
+  stream *s, **tail = &sp->streams;
+
+  while (*tail != NULL) tail = &(*tail)->next;
+  s = calloc(1, sizeof(*s));
+  if (s == NULL) return NULL;
+  s->serialno = header->serialno;
+  rogg_stream_info_init(&s->info, header);
+  s->in_headers = 1;
+  s->last = -1;
+  s->last_page = -1;
+  s->clean_page = -1;
+  if (s->info.codec != NULL && s->info.codec->id == ROGG_CODEC_SKELETON) {
+    /* its index would be wrong for the segments */
+    s->skip = 1;
+    if (verbose) fprintf(stdout, "dropping skeleton stream %08x\n",
+	s->serialno);
+  }
+  *tail = s;
+
+  /* prefer video for the cuts, then anything with a timebase */
+  if (s->skip || s->info.codec == NULL || s->info.headers <= 0 ||
+	s->info.rate_num <= 0 || s->info.rate_den <= 0) return s;
+  if (sp->key == NULL || (s->info.codec->packet_keyframe != NULL &&
+	sp->key->info.codec->packet_keyframe == NULL)) sp->key = s;
+
+  return s;
+}
+
+int add_header_page(stream *s, unsigned char *q, rogg_page_header *header)
+{
+  unsigned char **pages = realloc(s->hpages, (s->hcount + 1) * sizeof(*pages));
+
+  if (pages == NULL) return -1;
+  s->hpages = pages;
+  s->hpages[s->hcount++] = q;
+  s->finished += rogg_page_packets_ending(header);
+  if (s->info.headers < 0) {
+    /* without a count only the bos page can be told apart */
+    s->in_headers = 0;
+  } else if (s->finished >= s->info.headers) {
+    s->in_headers = 0;
+  }
+
+  return 0;
+}
+
+/* time a cut before this key stream page would start at, or -1 if
+   decoding can't start on it */
+double cut_time(stream *s, rogg_page_header *header)
+{
+  rogg_stream_info *info = &s->info;
+  int64_t count;
+  int i, ends = 0;
+  unsigned char *data = header->data;
+
+  if (info->codec->packet_keyframe == NULL) {
+    if (header->continued) return -1;
+    if (s->last < 0) return 0;
+    return rogg_stream_time(info, s->last);
+  }
+
+  /* frame count of the last frame before this page */
+  if (s->last < 0) {
+    count = -info->frame_base;
+  } else if (info->shift) {
+    count = (s->last >> info->shift) +
+	(s->last & (((int64_t)1 << info->shift) - 1));
+  } else {
+    count = s->last;
+  }
+  for (i = 0; i < header->segments; i++) {
+    if ((i ? header->lacing[i-1] < 255 : !header->continued) &&
+	info->codec->packet_keyframe(data, header->lacing[i])) {
+      count += ends + 1;
+      return (double)(count - 1 + info->frame_base) *
+	info->rate_den / info->rate_num;
+    }
+    if (header->lacing[i] < 255) ends++;
+    data += header->lacing[i];
+  }
+
+  return -1;
+}
+
+/* write the collected segment out as a file of its own */
+int write_segment(splitter *sp, const char *name)
+{
+  rogg_page_header header;
+  rogg_writer w;
+  stream *s;
+  unsigned char *page;
+  unsigned char **copies = NULL;
+  int ncopies = 0, o, i, ret = -1;
+  long j;
+
+  o = open(name, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+  if (o < 0) {
+    fprintf(stderr, "couldn't create '%s'\n", name);
+    return -1;
+  }
+  rogg_writer_init(&w, o);
+
+  /* bos pages first, then the rest of the headers */
+  for (i = 0; ; i++) {
+    int more = 0;
+    for (s = sp->streams; s != NULL; s = s->next) {
+      if (s->skip || i >= s->hcount) continue;
+      more = 1;
+      page = s->hpages[i];
+      if (i == 0 && sp->index > 0 && s->info.codec != NULL &&
+	  s->info.codec->id == ROGG_CODEC_OPUS) {
+	unsigned char **c = realloc(copies, (ncopies + 1) * sizeof(*c));
+	int length;
+	if (c == NULL) goto out;
+	copies = c;
+	rogg_page_get_length(page, &length);
+	if ((copies[ncopies] = malloc(length)) == NULL) goto out;
+	memcpy(copies[ncopies], page, length);
+	page = copies[ncopies++];
+	rogg_page_parse(page, &header);
+	rogg_write_uint16(header.data + 10, 0);
+      }
+      rogg_page_parse(page, &header);
+      header.flags &= ~0x04;
+      if (i == s->hcount - 1 && s->cut_page < 0) header.flags |= 0x04;
+      if (rogg_writer_page(&w, &header)) goto out;
+      s->sequenceno = header.sequenceno + 1;
+    }
+    if (!more) break;
+  }
+
+  for (j = 0; j < sp->count; j++) {
+    seg_page *g = &sp->pages[j];
+    if (j > g->s->cut_page) continue;
+    g->header.sequenceno = g->s->sequenceno++;
+    g->header.flags &= ~0x04;
+    if (j == g->s->cut_page) g->header.flags |= 0x04;
+    if (rogg_writer_page(&w, &g->header)) goto out;
+  }
+  if (rogg_writer_flush(&w)) goto out;
+  ret = 0;
+
+out:
+  if (ret) fprintf(stderr, "couldn't write '%s'\n", name);
+  close(o);
+  for (i = 0; i < ncopies; i++) free(copies[i]);
+  free(copies);
+  return ret;
+}
+
+/* note the page as the last of its stream in the segment */
+void seg_mark(splitter *sp, long j)
+{
+  seg_page *g = &sp->pages[j];
+
+  g->s->last_page = j;
+  if (g->header.segments > 0 &&
+	g->header.lacing[g->header.segments - 1] < 255)
+    g->s->clean_page = j;
+}
+
+/* write the segment, keeping any pages carried over for the next;
+   the last segment takes everything */
+int finish_segment(splitter *sp, const char *fmt, double t, int last)
+{
+  char name[4096];
+  stream *s;
+  long j, kept = 0;
+  int ret;
+
+  for (s = sp->streams; s != NULL; s = s->next) {
+    s->cut_page = (last || s == sp->key) ? s->last_page : s->clean_page;
+  }
+  snprintf(name, sizeof(name), fmt, sp->index);
+  ret = write_segment(sp, name);
+  for (s = sp->streams; s != NULL; s = s->next) {
+    s->last_page = -1;
+    s->clean_page = -1;
+  }
+  for (j = 0; j < sp->count; j++) {
+    if (j <= sp->pages[j].s->cut_page) continue;
+    sp->pages[kept] = sp->pages[j];
+    seg_mark(sp, kept++);
+  }
+  if (verbose) fprintf(stdout, "%s: %ld pages from %.3lf s\n", name,
+	sp->count - kept, t);
+  sp->count = kept;
+  sp->index++;
+
+  return ret;
+}
+
+int split(unsigned char *p, unsigned char *e, const char *fmt)
+{
+  rogg_page_header header;
+  splitter sp;
+  stream *s;
+  unsigned char *q;
+  double t, seg_start = 0;
+  int ret = -1;
+
+  memset(&sp, 0, sizeof(sp));
+  sp.next = -1;
+  for (q = rogg_page_find(p, e, &header); q != NULL;
+	q = rogg_page_find(q + header.length, e, &header)) {
+    for (s = sp.streams; s != NULL && s->serialno != header.serialno;
+	s = s->next);
+    if (header.bos) {
+      if (s != NULL || sp.count || sp.index) {
+	fprintf(stderr, "chained files aren't supported\n");
+	goto out;
+      }
+      if ((s = stream_add(&sp, &header)) == NULL) goto out;
+    } else if (s == NULL) {
+      fprintf(stderr, "skipping page of unknown stream %08x\n",
+	header.serialno);
+      continue;
+    }
+    if (s->skip) continue;
+    if (s->in_headers) {
+      if (add_header_page(s, q, &header) < 0) goto out;
+      continue;
+    }
+
+    if (s == sp.key && (t = cut_time(s, &header)) >= 0) {
+      if (sp.next < 0) {
+	sp.next = t + duration;
+	seg_start = t;
+      } else if (sp.count && t >= sp.next) {
+	if (finish_segment(&sp, fmt, seg_start, 0) < 0) goto out;
+	seg_start = t;
+	/* skip boundaries with nothing to cut at */
+	while (t >= sp.next) sp.next += duration;
+      }
+    }
+    if (sp.count == sp.room) {
+      seg_page *g;
+      sp.room = sp.room * 2 + 1024;
+      g = realloc(sp.pages, sp.room * sizeof(*g));
+      if (g == NULL) goto out;
+      sp.pages = g;
+    }
+    sp.pages[sp.count].header = header;
+    sp.pages[sp.count].s = s;
+    seg_mark(&sp, sp.count++);
+    if ((int64_t)header.granulepos != -1) s->last = header.granulepos;
+  }
+  if (sp.streams == NULL) {
+    fprintf(stderr, "couldn't find ogg data\n");
+    goto out;
+  }
+  if (sp.key == NULL) {
+    fprintf(stderr, "no stream to time the cuts by\n");
+    goto out;
+  }
+  ret = finish_segment(&sp, fmt, seg_start, 1);
+
+out:
+  free(sp.pages);
+  stream_free(sp.streams);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  int f, ret;
+  unsigned char *p;
+  struct stat s;
+  char *fmt;
+
+  parse_args(&argc, argv);
+  if (argc != 2) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+  fmt = pattern ? pattern : default_pattern(argv[1]);
+  if (fmt == NULL || !pattern_ok(fmt)) {
+    fprintf(stderr, "output pattern needs exactly one %%d\n");
+    exit(1);
+  }
+
+  f = open(argv[1], O_RDONLY);
+  if (f < 0) {
+    fprintf(stderr, "couldn't open '%s'\n", argv[1]);
+    exit(1);
+  }
+  if (fstat(f, &s) < 0 || s.st_size == 0) {
+    fprintf(stderr, "couldn't stat '%s'\n", argv[1]);
+    close(f);
+    exit(1);
+  }
+  p = mmap(0, s.st_size, PROT_READ, MAP_SHARED, f, 0);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "couldn't mmap '%s'\n", argv[1]);
+    close(f);
+    exit(1);
+  }
+  ret = split(p, p + s.st_size, fmt) < 0;
+
+  munmap(p, s.st_size);
+  close(f);
+  if (fmt != pattern) free(fmt);
+  if (show_counters) rogg_counters_report(stderr);
+  return ret;
+}
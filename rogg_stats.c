@@ -28,7 +28,8 @@
 /* Ogg statistics reporter */
 
 /* compile with
-   gcc -O2 -g -Wall -I. -o rogg_stats rogg.c rogg_stats.c
+   gcc -O2 -g -Wall -I. -o rogg_stats rogg.c rogg_codec.c rogg_output.c \
+	rogg_arena.c rogg_streamstats.c rogg_stats.c
 */
 
 #include <stdio.h>
@@ -44,25 +45,104 @@
 
 #include <rogg.h>
 
+int show_counters = 0;
 int verbose = 0;
+int format = ROGG_OUTPUT_TEXT;
+double window = 1.0;
 
-void print_header_info(FILE *out, rogg_page_header *header)
+/* per file state, reset after each report */
+rogg_arena arena;
+
+/* where the walk reports skipped bytes and pages */
+typedef struct {
+  rogg_output *out;
+  FILE *msg;
+  long long len;
+} walk_report;
+
+void report_skip(void *data, long long offset, long long len)
+{
+  walk_report *r = data;
+
+  if (offset == 0)
+    fprintf(r->msg, "Skipped %d garbage bytes at the start\n", (int)len);
+  else if (offset + len == r->len)
+    fprintf(r->msg, "Skipped %d garbage bytes as the end\n", (int)len);
+  else
+    fprintf(r->msg, "Hole in data! skipped %d bytes\n", (int)len);
+  rogg_output_skip(r->out, offset, len);
+}
+
+void report_page(void *data, long long offset, rogg_page_header *header)
+{
+  walk_report *r = data;
+
+  rogg_output_page(r->out, offset, header);
+}
+
+void print_stream_stats(FILE *out, rogg_stream_stats *st)
 {
-  fprintf(out, " Ogg page serial %08x seq %d (%5d bytes)",
-	header->serialno, header->sequenceno, header->length);
-  fprintf(out, (header->continued) ? " c" : "  ");
-  fprintf(out, " %lld", (long long int)header->granulepos);
-  fprintf(out, (header->bos) ? " bos" : "");
-  fprintf(out, (header->eos) ? " eos" : "");
+  double duration = st->duration;
+  int i;
+
+  fprintf(out, "stream %08x %s: %ld pages, %ld header bytes, %ld data bytes",
+	st->serialno, rogg_codec_name(st->info.codec), st->pages, st->hbytes, st->dbytes);
+  if (st->hbytes + st->dbytes > 0) {
+    fprintf(out, " (%.3lf%% overhead)",
+	100.0*st->hbytes/(st->hbytes + st->dbytes));
+  }
   fprintf(out, "\n");
+  if (duration > 0) {
+    fprintf(out, "  duration %.3lf s, average bitrate %.1lf kbit/s,"
+	" peak %.1lf kbit/s over %.3lf s\n", duration,
+	(st->hbytes + st->dbytes) * 8.0 / duration / 1000.0,
+	st->peak / 1000.0, window);
+    fprintf(out, "  max granule gap %.3lf s\n", st->max_gap);
+  } else {
+    fprintf(out, "  last granulepos %lld, no time mapping\n",
+	(long long)st->last_granule);
+  }
+  fprintf(out, "  page sizes:");
+  for (i = 0; i < ROGG_STATS_SIZES - 1; i++) {
+    fprintf(out, " <%d:%ld", 128 << i, st->sizes[i]);
+  }
+  fprintf(out, " >=%d:%ld\n", 128 << (ROGG_STATS_SIZES - 2), st->sizes[i]);
+}
+
+/* one json line per stream, tagged with the already quoted file name */
+void print_stream_json(FILE *out, rogg_output *records,
+	rogg_stream_stats *st)
+{
+  double duration = st->duration;
+  int i;
+
+  fprintf(out, "{\"file\":\"%.*s\",\"serialno\":%u,\"codec\":\"%s\","
+	"\"pages\":%ld,\"header_bytes\":%ld,\"data_bytes\":%ld,"
+	"\"granulepos\":%lld",
+	records->name_len, records->name, st->serialno, rogg_codec_name(st->info.codec),
+	st->pages, st->hbytes, st->dbytes, (long long)st->last_granule);
+  if (duration > 0) {
+    fprintf(out, ",\"duration\":%.6lf,\"bitrate\":%.1lf,\"peak_bitrate\":%.1lf,"
+	"\"window\":%.6lf,\"max_granule_gap\":%.6lf", duration,
+	(st->hbytes + st->dbytes) * 8.0 / duration, st->peak, window,
+	st->max_gap);
+  }
+  fprintf(out, ",\"page_sizes\":[");
+  for (i = 0; i < ROGG_STATS_SIZES; i++) {
+    fprintf(out, (i > 0) ? ",%ld" : "%ld", st->sizes[i]);
+  }
+  fprintf(out, "]}\n");
 }
 
 void print_usage(FILE *out, char *name)
 {
-  fprintf(stderr, "Reporter for encapsulation overhead\n");
-  fprintf(stderr, "%s [-v] <file1.ogg> [<file2.ogg>...]\n",
+  fprintf(stderr, "Reporter for encapsulation overhead and stream statistics\n");
+  fprintf(stderr, "%s [-v] [-w seconds] [-o format] <file1.ogg> [<file2.ogg>...]\n",
 	name);
-  fprintf(stderr, "    -v          print more information\n");
+  fprintf(stderr, "    -v          print more information\n"
+		  "    -w seconds  sliding window for the peak bitrate (default 1)\n"
+		  "    -o format   text (default) or json\n"
+		  "    -S          print library counters on exit\n");
 }
 
 int parse_args(int *argc, char *argv[])
@@ -74,10 +154,31 @@ int parse_args(int *argc, char *argv[])
     shift = 0;
     if (argv[arg][0] == '-') {
       switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
 	case 'v':
 	  verbose = 1;
 	  shift = 1;
 	  break;
+	case 'o':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+	      (format = rogg_output_format(argv[arg+1])) < 0 ||
+	      (format != ROGG_OUTPUT_TEXT && format != ROGG_OUTPUT_JSON)) {
+	    fprintf(stderr, "Option -o requires either text or json.\n");
+	    exit(1);
+	  }
+	  break;
+	case 'w':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 ||
+	      sscanf(argv[arg+1], "%lf", &window) != 1 || window <= 0) {
+	    fprintf(stderr, "Option -w requires a window length in seconds.\n");
+	    exit(1);
+	  }
+	  break;
       }
     }
     if (shift) {
@@ -98,10 +199,14 @@ int parse_args(int *argc, char *argv[])
 
 int main(int argc, char *argv[])
 {
-  int f, i;
-  unsigned char *p, *q, *o, *e;
+  int f, i, j, ret;
+  unsigned char *p;
   struct stat s;
-  rogg_page_header header;
+  rogg_stats_options opts;
+  rogg_stats_result result;
+  rogg_output out;
+  walk_report report;
+  FILE *msg;
   long hbytes = 0;
   long dbytes = 0;
 
@@ -111,6 +216,18 @@ int main(int argc, char *argv[])
     exit(1);
   }
 
+  /* keep stdout parseable when writing json */
+  rogg_output_init(&out, stdout, format);
+  msg = (format == ROGG_OUTPUT_TEXT) ? stdout : stderr;
+  rogg_arena_init(&arena, 4096);
+  memset(&opts, 0, sizeof(opts));
+  opts.window = window;
+  opts.hooks.skip = report_skip;
+  if (verbose) opts.hooks.page = report_page;
+  opts.hooks.data = &report;
+  report.out = &out;
+  report.msg = msg;
+
   for (i = 1; i < argc; i++) {
     f = open(argv[i], O_RDONLY);
     if (f < 0) {
@@ -128,37 +245,38 @@ int main(int argc, char *argv[])
 	close(f);
 	continue;
     }
-    fprintf(stdout, "Checking Ogg file '%s'\n", argv[i]);
-    e = p + s.st_size; /* pointer to the end of the file */
-    q = rogg_scan(p, s.st_size); /* scan for an Ogg page */
-    if (q == NULL) {
-	fprintf(stdout, "couldn't find ogg data!\n");
+    fprintf(msg, "Checking Ogg file '%s'\n", argv[i]);
+    if (rogg_output_begin(&out, argv[i])) {
+	fprintf(stderr, "couldn't allocate output buffer\n");
+	exit(1);
+    }
+    report.len = s.st_size;
+    ret = rogg_stats_collect(p, s.st_size, &opts, &arena, &result);
+    if (ret == ROGG_NO_PAGES) {
+	fprintf(msg, "couldn't find ogg data!\n");
+    } else if (ret < 0) {
+	fprintf(stderr, "couldn't allocate stream statistics\n");
+	exit(1);
     } else {
-      if (q > p) {
-	fprintf(stdout, "Skipped %d garbage bytes at the start\n", (int)(q-p));
-      }
-      while (q < e) {
-	o = rogg_scan(q, e-q); /* find the next Ogg page */
-	if (o > q) {
-	  fprintf(stdout, "Hole in data! skipped %d bytes\n", (int)(o-q));
-	   q = o;
-	} else if (o == NULL) {
-	  fprintf(stdout, "Skipped %d garbage bytes as the end\n", (int)(e-q));
-	  break;
-	}
-	rogg_page_parse(q, &header);
-	hbytes += 27 + header.segments;
-        dbytes += header.length;
-	if (verbose) {
-	  print_header_info(stdout, &header);
-	}
-	q += header.length;
+      hbytes += result.hbytes;
+      dbytes += result.dbytes;
+      for (j = 0; j < result.count; j++) {
+	if (format == ROGG_OUTPUT_JSON)
+	  print_stream_json(stdout, &out, &result.streams[j]);
+	else
+	  print_stream_stats(stdout, &result.streams[j]);
       }
     }
+    rogg_arena_reset(&arena);
     munmap(p, s.st_size);
     close(f);
   }
-  fprintf(stdout, "total overhead: %ld/%ld bytes (%02.3lf%%)\n",
-	hbytes, dbytes, 100.0*hbytes/dbytes);
+  rogg_arena_clear(&arena);
+  if (hbytes + dbytes > 0) {
+    fprintf(msg, "total overhead: %ld/%ld bytes (%02.3lf%%)\n",
+	hbytes, hbytes + dbytes, 100.0*hbytes/(hbytes + dbytes));
+  }
+  rogg_output_finish(&out);
+  if (show_counters) rogg_counters_report(stderr);
   return 0;
 }
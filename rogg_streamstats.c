@@ -0,0 +1,163 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* per stream page, overhead and bitrate statistics */
+
+/* Peak bitrates come from a sliding window of byte counts by page
+   timestamp. Bytes on pages without a granulepos wait for the next
+   page which has one, and late timestamps count towards the newest
+   slot, so a window never runs backwards. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rogg.h"
+
+/* number of slots in the sliding bitrate window */
+#define WINDOW_SLOTS 16
+
+/* a stream's statistics with the window state behind the peak */
+typedef struct _stats_stream {
+  rogg_stream_stats st;
+  double last_time;
+  long pending;			/* bytes waiting for a timestamp */
+  long slots[WINDOW_SLOTS];
+  int64_t slot;			/* index of the newest slot */
+  long window_bytes;
+  struct _stats_stream *next;
+} stats_stream;
+
+static stats_stream *stats_get(rogg_arena *arena, stats_stream **head,
+	rogg_page_header *header)
+{
+  stats_stream *s;
+
+  /* keep the list in order of appearance for the report */
+  while (*head != NULL) {
+    if ((*head)->st.serialno == header->serialno) return *head;
+    head = &(*head)->next;
+  }
+
+  s = rogg_arena_calloc(arena, 1, sizeof(*s));
+  if (s == NULL) return NULL;
+  s->st.serialno = header->serialno;
+  s->st.last_granule = -1;
+  s->last_time = -1;
+  rogg_stream_info_init(&s->st.info, header);
+  *head = s;
+
+  return s;
+}
+
+/* add a page's bytes to the sliding window at time t */
+static void stats_window(stats_stream *s, double window, double t, long bytes)
+{
+  int64_t slot = (int64_t)(t * WINDOW_SLOTS / window);
+
+  if (slot > s->slot) {
+    /* expire the slots we've moved past */
+    while (s->slot < slot) {
+      s->slot++;
+      s->window_bytes -= s->slots[s->slot % WINDOW_SLOTS];
+      s->slots[s->slot % WINDOW_SLOTS] = 0;
+      if (slot - s->slot > WINDOW_SLOTS) {
+	memset(s->slots, 0, sizeof(s->slots));
+	s->window_bytes = 0;
+	s->slot = slot;
+      }
+    }
+  }
+  s->slots[s->slot % WINDOW_SLOTS] += bytes;
+  s->window_bytes += bytes;
+  if (s->window_bytes * 8.0 / window > s->st.peak)
+    s->st.peak = s->window_bytes * 8.0 / window;
+}
+
+static void stats_page(stats_stream *s, double window,
+	rogg_page_header *header)
+{
+  rogg_stream_stats *st = &s->st;
+  long hbytes = ROGG_OFFSET_LACING + header->segments;
+  long dbytes = header->length - hbytes;
+  int64_t granulepos = (int64_t)header->granulepos;
+  double t;
+  int bucket = 0;
+
+  st->pages++;
+  st->hbytes += hbytes;
+  st->dbytes += dbytes;
+  while (bucket < ROGG_STATS_SIZES - 1 && header->length >= (128 << bucket))
+    bucket++;
+  st->sizes[bucket]++;
+
+  s->pending += header->length;
+  if (granulepos == -1) return;
+  t = rogg_stream_time(&st->info, granulepos);
+  st->last_granule = granulepos;
+  if (t < 0) return;
+  if (s->last_time >= 0 && t - s->last_time > st->max_gap)
+    st->max_gap = t - s->last_time;
+  s->last_time = t;
+  stats_window(s, window, t, s->pending);
+  s->pending = 0;
+}
+
+int rogg_stats_collect(unsigned char *p, long len,
+	const rogg_stats_options *opts, rogg_arena *arena,
+	rogg_stats_result *result)
+{
+  unsigned char *q = p, *e = p + len;
+  rogg_page_header header;
+  stats_stream *streams = NULL, *s;
+  double window = opts->window > 0 ? opts->window : 1.0;
+  int i;
+
+  memset(result, 0, sizeof(*result));
+  while ((q = rogg_page_walk(p, q, e, &header, &opts->hooks)) != NULL) {
+    result->hbytes += ROGG_OFFSET_LACING + header.segments;
+    result->dbytes += header.length - ROGG_OFFSET_LACING - header.segments;
+    s = stats_get(arena, &streams, &header);
+    if (s == NULL) return -1;
+    stats_page(s, window, &header);
+    q += header.length;
+  }
+  if (streams == NULL) return ROGG_NO_PAGES;
+
+  for (s = streams; s != NULL; s = s->next) result->count++;
+  result->streams = rogg_arena_alloc(arena,
+	result->count * sizeof(*result->streams));
+  if (result->streams == NULL) return -1;
+  for (s = streams, i = 0; s != NULL; s = s->next, i++) {
+    result->streams[i] = s->st;
+    result->streams[i].duration =
+	rogg_stream_time(&s->st.info, s->st.last_granule);
+  }
+
+  return 0;
+}
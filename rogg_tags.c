@@ -0,0 +1,398 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* list and edit vorbis comment tags using the rogg library */
+
+/* compile with
+   gcc -O2 -g -Wall -I. -o rogg_tags rogg.c rogg_codec.c rogg_header.c \
+	rogg_comment.c rogg_arena.c rogg_tags.c
+*/
+
+/* Edits are written back over the old comment packet whenever they
+   fit, with the slack kept as padding for next time. When they don't,
+   the packet grows by the requested padding plus enough to make the
+   size change a whole number of filesystem blocks, so the rest of the
+   file can usually be shifted without being copied. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <rogg.h>
+
+int show_counters = 0;
+int verbose = 0;
+long padding = 1024;
+/* edits in the order given: "KEY" to delete, "KEY=value" to set or add */
+char **edits = NULL;
+char *edit_ops = NULL;
+int edit_count = 0;
+
+/* header packets and their copies, reset after each stream */
+rogg_arena arena;
+
+void print_usage(FILE *out, char *name)
+{
+  fprintf(out, "List and edit comment tags in Ogg Vorbis, Opus, Theora and FLAC files.\n");
+  fprintf(out, "%s [-v] [-s KEY=value] [-a KEY=value] [-d KEY] [-p bytes] <file1.ogg> [<file2.ogg>...]\n",
+	name);
+  fprintf(out, "    -v            print more information\n"
+		  "    -s KEY=value  replace any KEY tags with this one\n"
+		  "    -a KEY=value  add a tag, keeping any others with the same key\n"
+		  "    -d KEY        delete all KEY tags\n"
+		  "    -p bytes      padding to leave when a header has to grow\n"
+		  "                  (default 1024)\n"
+		  "    -S            print library counters on exit\n"
+		  "  With no edits, the tags in each file are listed.\n");
+}
+
+/* check the key part of a tag is printable ascii without '=' */
+int valid_key(const char *tag)
+{
+  const char *c;
+
+  for (c = tag; *c && *c != '='; c++) {
+    if (*c < 0x20 || *c > 0x7d) return 0;
+  }
+  return c > tag;
+}
+
+int parse_args(int *argc, char *argv[])
+{
+  int arg = 1;
+  int shift;
+
+  edits = malloc(*argc * sizeof(*edits));
+  edit_ops = malloc(*argc);
+  if (edits == NULL || edit_ops == NULL) {
+    fprintf(stderr, "couldn't allocate edit list\n");
+    exit(1);
+  }
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'v':
+	  verbose = 1;
+	  shift = 1;
+	  break;
+	case 's':
+	case 'a':
+	case 'd':
+	  shift = 2;
+	  if (*argc - arg < 2) {
+	    fprintf(stderr, "Option -%c requires a tag.\n", argv[arg][1]);
+	    exit(1);
+	  }
+	  if (!valid_key(argv[arg+1]) ||
+	      (argv[arg][1] == 'd') != (strchr(argv[arg+1], '=') == NULL)) {
+	    fprintf(stderr, "Could not parse tag '%s'.\n", argv[arg+1]);
+	    exit(1);
+	  }
+	  edit_ops[edit_count] = argv[arg][1];
+	  edits[edit_count++] = argv[arg+1];
+	  break;
+	case 'p':
+	  shift = 2;
+	  if (*argc - arg < 2 || sscanf(argv[arg+1], "%ld", &padding) != 1
+	      || padding < 0) {
+	    fprintf(stderr, "Option -p requires a number of bytes.\n");
+	    exit(1);
+	  }
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
+}
+
+/* apply the edit list, returns non-zero if anything changed, or
+   -1 if we ran out of memory */
+int comments_edit(rogg_comments *c)
+{
+  int changed = 0;
+  int k, m;
+
+  for (k = 0; k < edit_count; k++) {
+    if (edit_ops[k] == 's' || edit_ops[k] == 'd') {
+      /* a set replaces earlier tags, but not ones added by
+	 earlier sets of the same key */
+      for (m = 0; m < k; m++) {
+	if (edit_ops[m] == 's' && rogg_comments_match(
+		(unsigned char *)edits[m], strlen(edits[m]), edits[k])) break;
+      }
+      if (m == k || edit_ops[k] == 'd') {
+	if (rogg_comments_delete(c, edits[k]) > 0) changed = 1;
+      }
+      if (edit_ops[k] == 'd') continue;
+    }
+    if (rogg_comments_add(c, (unsigned char *)edits[k], strlen(edits[k])) < 0)
+      return -1;
+    changed = 1;
+  }
+
+  return changed;
+}
+
+void comments_print(FILE *out, rogg_comments *c)
+{
+  uint32_t i;
+
+  fprintf(out, "  vendor '%.*s'\n", (int)c->vendor_len, c->vendor);
+  for (i = 0; i < c->count; i++) {
+    fprintf(out, "  %.*s\n", (int)c->lengths[i], c->entries[i]);
+  }
+}
+
+/* size for a grown packet: at least the padding, and rounded so the
+   header region changes by whole filesystem blocks */
+long grow_size(long old_len, long need, long blksize)
+{
+  long len = need + padding;
+  long i;
+
+  for (i = 0; i < blksize + 2; i++, len++) {
+    long delta = (len + len / 255) - (old_len + old_len / 255);
+    if (delta % blksize == 0) return len;
+  }
+  return need + padding;
+}
+
+/* edit or list the tags of one stream; returns 1 if the file was
+   rewritten and must be mapped again, -1 on error */
+int process_stream(char *name, int f, unsigned char *p, long len,
+	rogg_stream_info *info)
+{
+  int codec = info->codec->id;
+  rogg_headers headers;
+  rogg_comments c;
+  unsigned char **data;
+  long *lengths;
+  int pad = -1;			/* flac padding packet */
+  int i, ret = -1;
+  long need, size;
+  struct stat st;
+
+  if (info->headers < 2) {
+    fprintf(stderr, "stream %08x: unknown number of headers\n", info->serialno);
+    return -1;
+  }
+  if (rogg_headers_read_arena(&headers, &arena, p, len, info->serialno,
+	info->headers) < 0) {
+    fprintf(stderr, "stream %08x: couldn't read the headers\n", info->serialno);
+    return -1;
+  }
+  data = rogg_arena_calloc(&arena, headers.count, sizeof(*data));
+  lengths = rogg_arena_calloc(&arena, headers.count, sizeof(*lengths));
+  if (data == NULL || lengths == NULL) goto out;
+  for (i = 0; i < headers.count; i++) {
+    lengths[i] = headers.packets[i].length;
+    data[i] = rogg_arena_alloc(&arena, lengths[i]);
+    if (data[i] == NULL) goto out;
+    rogg_packet_copy(&headers.packets[i], data[i]);
+    if (codec == ROGG_CODEC_FLAC && i > 1 && lengths[i] >= 4 &&
+	(data[i][0] & 0x7f) == 1) pad = i;
+  }
+  if (rogg_comments_parse(&c, codec, data[1], lengths[1]) < 0) {
+    fprintf(stderr, "stream %08x: couldn't parse the comment header\n",
+	info->serialno);
+    rogg_comments_clear(&c);
+    goto out;
+  }
+
+  fprintf(stdout, "stream %08x %s:\n", info->serialno,
+	rogg_codec_name(info->codec));
+  if (!edit_count) {
+    comments_print(stdout, &c);
+    ret = 0;
+    goto clear;
+  }
+  switch (comments_edit(&c)) {
+    case 0:
+      fprintf(stdout, "  no changes\n");
+      ret = 0;
+      goto clear;
+    case -1:
+      fprintf(stderr, "couldn't allocate tag list\n");
+      goto clear;
+  }
+
+  need = rogg_comments_size(&c);
+  if (fstat(f, &st) < 0) goto clear;
+  if (codec == ROGG_CODEC_FLAC) {
+    /* trade space with the padding block */
+    size = need;
+    if (pad > 0) {
+      long room = lengths[1] + lengths[pad] - 4 - need;
+      if (room >= 0) {
+	unsigned char *d = rogg_arena_grow(&arena, data[pad],
+		lengths[pad], room + 4);
+	if (d == NULL) goto clear;
+	data[pad] = d;
+	memset(d + 1, 0, room + 3);
+	d[1] = (room >> 16) & 0xFF;
+	d[2] = (room >> 8) & 0xFF;
+	d[3] = room & 0xFF;
+	lengths[pad] = room + 4;
+      }
+    }
+  } else if (need <= lengths[1] && !c.extra_len) {
+    /* fits in the old packet, keep the rest as padding */
+    size = lengths[1];
+  } else if (c.extra_len) {
+    size = need;
+  } else {
+    size = grow_size(lengths[1], need, st.st_blksize);
+  }
+  {
+    unsigned char *d = rogg_arena_alloc(&arena, size);
+    if (d == NULL) goto clear;
+    rogg_comments_write(&c, d, size);
+    data[1] = d;
+    lengths[1] = size;
+  }
+  if (verbose) comments_print(stdout, &c);
+
+  ret = rogg_headers_write(&headers, name, f, p, len, data, lengths);
+  if (ret < 0) {
+    fprintf(stderr, "stream %08x: couldn't write the new headers\n",
+	info->serialno);
+  } else if (ret == 0) {
+    fprintf(stdout, "  updated in place\n");
+  } else {
+    fprintf(stdout, "  resized the headers\n");
+  }
+
+clear:
+  rogg_comments_clear(&c);
+out:
+  rogg_headers_clear(&headers);
+  rogg_arena_reset(&arena);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  int f, i, j, ret;
+  unsigned char *p, *q, *e;
+  struct stat s;
+  rogg_page_header header;
+  rogg_stream_info info;
+  uint32_t *done, *d;
+  int done_count;
+
+  parse_args(&argc, argv);
+  if (argc < 2) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+  rogg_arena_init(&arena, 0);
+
+  for (i = 1; i < argc; i++) {
+    f = open(argv[i], edit_count ? O_RDWR : O_RDONLY);
+    if (f < 0) {
+	fprintf(stderr, "couldn't open '%s'\n", argv[i]);
+	continue;
+    }
+    fprintf(stdout, "Checking Ogg file '%s'\n", argv[i]);
+    done = NULL;
+    done_count = 0;
+  restart:
+    if (fstat(f, &s) < 0) {
+	fprintf(stderr, "couldn't stat '%s'\n", argv[i]);
+	close(f);
+	free(done);
+	continue;
+    }
+    p = mmap(0, s.st_size, edit_count ? PROT_READ|PROT_WRITE : PROT_READ,
+	MAP_SHARED, f, 0);
+    if (p == MAP_FAILED) {
+	fprintf(stderr, "couldn't mmap '%s'\n", argv[i]);
+	close(f);
+	free(done);
+	continue;
+    }
+    e = p + s.st_size;
+    q = p;
+    /* the bos pages all come first */
+    while ((q = rogg_page_find(q, e, &header)) != NULL && header.bos) {
+      q += header.length;
+      if (rogg_stream_info_init(&info, &header) < 0) continue;
+      if (!rogg_comments_supported(info.codec->id)) continue;
+      for (j = 0; j < done_count; j++) if (done[j] == info.serialno) break;
+      if (j < done_count) continue;
+      d = realloc(done, (done_count + 1) * sizeof(*done));
+      if (d == NULL) break;
+      done = d;
+      done[done_count++] = info.serialno;
+      ret = process_stream(argv[i], f, p, s.st_size, &info);
+      if (ret > 0) {
+	/* the file was replaced or shifted under our mapping */
+	munmap(p, s.st_size);
+	close(f);
+	f = open(argv[i], O_RDWR);
+	if (f < 0) {
+	  fprintf(stderr, "couldn't reopen '%s'\n", argv[i]);
+	  break;
+	}
+	goto restart;
+      }
+    }
+    if (f >= 0) {
+      munmap(p, s.st_size);
+      close(f);
+    }
+    free(done);
+  }
+  rogg_arena_clear(&arena);
+  if (show_counters) rogg_counters_report(stderr);
+  return 0;
+}
@@ -25,10 +25,13 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-/* theora header modification script using the rogg library */
+/* theora header modification script using the rogg library; the
+   edits are made by rogg_theora_edit */
 
 /* compile with
-   gcc -O2 -g -Wall -I. -o rogg_theora rogg.c rogg_theora.c
+   gcc -O2 -g -Wall -I. -o rogg_theora rogg.c rogg_codec.c rogg_output.c \
+	rogg_seek.c rogg_arena.c rogg_edit.c rogg_header.c rogg_comment.c \
+	rogg_theora.c
 */
 
 #include <stdio.h>
@@ -44,6 +47,7 @@
 
 #include <rogg.h>
 
+int show_counters = 0;
 int verbose = 0;
 int aspect_set = 0;
 int aspect_num = 0;
@@ -51,6 +55,8 @@ int aspect_den = 0;
 int fps_set = 0;
 int fps_num = 0;
 int fps_den = 0;
+int seek_set = 0;
+double seek_time = 0;
 int crop_set = 0;
 int crop_width = 0;
 int crop_height = 0;
@@ -59,73 +65,83 @@ char crop_yorigin = 0;
 int crop_xoffset = 0;
 int crop_yoffset = 0;
 
-/* big endian accessors for the theora header data */
-int get16(unsigned char *data)
+void print_theora_info(FILE *out, rogg_theora_info *info)
 {
-  return (data[0] << 8) | data[1];
-}
-int get24(unsigned char *data)
-{
-  return (data[0] << 16) | (data[1] << 8) | data[2];
-}
-int get32(unsigned char *data)
-{
-  return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
-}
-void put16(unsigned char *data, int v)
-{
-  data[0] = (v >> 8) & 0xFF;
-  data[1] = v & 0xFF;
-}
-void put24(unsigned char *data, int v)
-{
-  data[0] = (v >> 16) & 0xFF;
-  data[1] = (v >>  8) & 0xFF;
-  data[2] = v & 0xFF;
+  fprintf(out, "  Theora info header version %d %d %d\n",
+	info->version[0], info->version[1], info->version[2]);
+  fprintf(out, "   encoded image %dx%d\n",
+	info->full_width, info->full_height);
+  fprintf(out, "   display image %dx%d at (%d,%d)\n",
+	info->width, info->height, info->x, info->y);
+  fprintf(out, "   frame rate %d:%d\n", info->fps_num, info->fps_den);
+  fprintf(out, "   pixel aspect %d:%d\n", info->aspect_num, info->aspect_den);
+  fprintf(out, "   colour space %d\n", info->colorspace);
+  fprintf(out, "   target bitrate %d\n", info->bitrate);
+  fprintf(out, "   quality %d\n", info->quality);
+  fprintf(out, "   keyframe granule shift %d\n", info->shift);
 }
-void put32(unsigned char *data, int v)
+
+/* dump the bos pages as they're looked at */
+void dump_page(void *data, long long offset, rogg_page_header *header)
 {
-  data[0] = (v >> 24) & 0xFF;
-  data[1] = (v >> 16) & 0xFF;
-  data[2] = (v >>  8) & 0xFF;
-  data[3] = v & 0xFF;
+  int j;
+
+  if (!header->bos) return;
+  rogg_page_print(stdout, header);
+  for (j = 0; j < header->length; j++) {
+    fprintf(stdout, " %02x", header->data[j]);
+    if (!((j+1)%4)) fprintf(stdout, " ");
+    if (!((j+1)%16)) fprintf(stdout, "\n");
+  }
+  fprintf(stdout, "\n");
 }
 
-void print_header_info(FILE *out, rogg_page_header *header)
+/* the file being checked, for messages about skipped bytes */
+typedef struct {
+  FILE *out;
+  long long len;
+} skip_report;
+
+void report_skip(void *data, long long offset, long long len)
 {
-  fprintf(out, " Ogg page serial %08x seq %d (%5d bytes)",
-	header->serialno, header->sequenceno, header->length);
-  fprintf(out, (header->continued) ? " c" : "  ");
-  fprintf(out, " %lld", (long long int)header->granulepos);
-  fprintf(out, (header->bos) ? " bos" : "");
-  fprintf(out, (header->eos) ? " eos" : "");
-  fprintf(out, "\n");
+  skip_report *r = data;
+
+  if (offset == 0)
+    fprintf(r->out, "Skipped %d garbage bytes at the start\n", (int)len);
+  else if (offset + len == r->len)
+    fprintf(r->out, "Skipped %d garbage bytes as the end\n", (int)len);
+  else
+    fprintf(r->out, "Hole in data! skipped %d bytes\n", (int)len);
 }
 
-void print_theora_info(FILE *out, unsigned char *data)
+/* report the keyframe to start decoding from for seek_time */
+void seek_report(unsigned char *p, long len, long long bos)
 {
-  int full_width = get16(data+10)<<4;
-  int full_height = get16(data+12)<<4;
-  int disp_width = get24(data+14);
-  int disp_height = get24(data+17);
-  fprintf(out, "  Theora info header version %d %d %d\n",
-	data[7], data[8], data[9]);
-  fprintf(out, "   encoded image %dx%d\n", 
-	full_width, full_height);
-  fprintf(out, "   display image %dx%d at (%d,%d)\n",
-	disp_width, disp_height, data[20],
-	full_height - disp_height - data[21]);
-  fprintf(out, "   frame rate %d:%d\n", get32(data+22), get32(data+26));
-  fprintf(out, "   pixel aspect %d:%d\n", get24(data+30), get24(data+33));
-  fprintf(out, "   colour space %d\n", data[36]);
-  fprintf(out, "   target bitrate %d\n", get24(data+37));
-  fprintf(out, "   quality %d\n", data[40] >> 2);
+  rogg_page_header header;
+  rogg_stream_info info;
+  int64_t keyframe;
+  long long offset;
+  double start;
+
+  rogg_page_parse(p + bos, &header);
+  rogg_stream_info_init(&info, &header);
+  offset = rogg_seek_keyframe(p, len, &info, seek_time, &keyframe);
+  if (offset < 0) {
+    fprintf(stdout, "  couldn't find a keyframe for %.3f s\n", seek_time);
+    return;
+  }
+  /* granule times mark the end of a frame */
+  start = rogg_stream_time(&info, keyframe) -
+	(double)info.rate_den / info.rate_num;
+  fprintf(stdout, "  keyframe %lld at %.3f s for %.3f s "
+	"starts on the page at offset %lld\n",
+	(long long)(keyframe >> info.shift), start, seek_time, offset);
 }
 
 void print_usage(FILE *out, char *name)
 {
   fprintf(stderr, "Script for editing theora headers, in place.\n");
-  fprintf(stderr, "%s [-v] [-a num:den] [-f num:den] <file1.ogg> [<file2.ogg>...]\n",
+  fprintf(stderr, "%s [-v] [-a num:den] [-f num:den] [-t seconds] <file1.ogg> [<file2.ogg>...]\n",
 	name);
   fprintf(stderr, "    -v          print more information\n"
 		  "    -a num:den  set the pixel aspect ratio\n"
@@ -140,7 +156,9 @@ void print_usage(FILE *out, char *name)
 		  "                        25:1 PAL\n"
 		  "                     30000:1001 NTSC\n"
 		  "                        24:1 film\n"
-		  "    -c wxh+x+y  set the crop region\n");
+		  "    -c wxh+x+y  set the crop region\n"
+		  "    -t seconds  find the keyframe to decode from for a time\n"
+		  "    -S          print library counters on exit\n");
 }
 
 int parse_args(int *argc, char *argv[])
@@ -153,6 +171,10 @@ int parse_args(int *argc, char *argv[])
     shift = 0;
     if (argv[arg][0] == '-') {
       switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
 	case 'v':
 	  verbose = 1;
 	  shift = 1;
@@ -177,6 +199,17 @@ int parse_args(int *argc, char *argv[])
 	  }
 	  shift = 2;
 	  break;
+	case 't':
+	  seek_set = 1;
+	  /* read the seek time from the next arg */
+	  if (*argc - arg < 2 || sscanf(argv[arg+1], "%lf", &seek_time) != 1
+	      || seek_time < 0) {
+	    fprintf(stderr, "Could not parse seek time '%s'.\n",
+		*argc - arg < 2 ? "" : argv[arg+1]);
+	    seek_set = 0;
+	  }
+	  shift = 2;
+	  break;
 	case 'c':
 	  crop_set = 1;
 	  /* read crop region from the next arg */
@@ -211,16 +244,39 @@ int parse_args(int *argc, char *argv[])
 
 int main(int argc, char *argv[])
 {
-  int f, i;
-  unsigned char *p, *q, *o, *e;
+  int f, i, j;
+  unsigned char *p;
   struct stat s;
-  rogg_page_header header;
+  rogg_theora_options opts;
+  rogg_theora_result result;
+  rogg_theora_stream *st;
+  rogg_arena arena;
+  skip_report report;
 
   parse_args(&argc, argv);
   if (argc < 2) {
     print_usage(stderr, argv[0]);
     exit(1);
   }
+  rogg_arena_init(&arena, 4096);
+  memset(&opts, 0, sizeof(opts));
+  opts.aspect_set = aspect_set;
+  opts.aspect_num = aspect_num;
+  opts.aspect_den = aspect_den;
+  opts.fps_set = fps_set;
+  opts.fps_num = fps_num;
+  opts.fps_den = fps_den;
+  opts.crop_set = crop_set;
+  opts.crop_width = crop_width;
+  opts.crop_height = crop_height;
+  opts.crop_xorigin = crop_xorigin;
+  opts.crop_yorigin = crop_yorigin;
+  opts.crop_xoffset = crop_xoffset;
+  opts.crop_yoffset = crop_yoffset;
+  opts.hooks.skip = report_skip;
+  if (verbose) opts.hooks.page = dump_page;
+  opts.hooks.data = &report;
+  report.out = stdout;
 
   for (i = 1; i < argc; i++) {
     f = open(argv[i], O_RDWR);
@@ -241,85 +297,37 @@ int main(int argc, char *argv[])
 	continue;
     }
     fprintf(stdout, "Checking Ogg file '%s'\n", argv[i]);
-    e = p + s.st_size; /* pointer to the end of the file */
-    q = rogg_scan(p, s.st_size); /* scan for an Ogg page */
-    if (q == NULL) {
+    report.len = s.st_size;
+    if (rogg_scan(p, s.st_size) == NULL)
 	fprintf(stdout, "couldn't find ogg data!\n");
-    } else {
-      if (q > p) {
-	fprintf(stdout, "Skipped %d garbage bytes at the start\n", (int)(q-p));
-      }
-      while (q < e) {
-	o = rogg_scan(q, e-q); /* find the next Ogg page */
-	if (o > q) {
-	  fprintf(stdout, "Hole in data! skipped %d bytes\n", (int)(o-q));
-	   q = o;
-	} else if (o == NULL) {
-	  fprintf(stdout, "Skipped %d garbage bytes as the end\n", (int)(e-q));
-	  break;
-	}
-	rogg_page_parse(q, &header);
-	if (!header.bos) break; /* only look at the initial bos pages */
-	if (verbose) {
-	  print_header_info(stdout, &header);
-	  int j;
-	  for (j = 0; j < header.length; j++) {
-	    fprintf(stdout, " %02x", header.data[j]);
-	    if (!((j+1)%4)) fprintf(stdout, " ");
-	    if (!((j+1)%16)) fprintf(stdout, "\n");
-	  }
-	  fprintf(stdout, "\n");
-	}
-	if (!memcmp(header.data, "\x80theora", 7)) {
-	  print_theora_info(stdout, header.data);
-	  if (crop_set) {
-	    int full_width = get16(header.data+10)<<4;
-	    int full_height = get16(header.data+12)<<4;
-	    if (crop_xorigin == '-')
-	      crop_xoffset = full_width - crop_width - crop_xoffset;
-	    if (crop_yorigin == '-')
-	      crop_yoffset = full_height - crop_height - crop_yoffset;
-	    if (crop_xoffset < 0 || crop_xoffset + crop_width > full_width
-		|| crop_yoffset < 0 || crop_yoffset + crop_height > full_height) {
-	      fprintf(stderr, "Crop window is not within encoded window.\n");
-	      break;
-	    }
-	    fprintf(stdout, "Setting crop region to %dx%d at (%d,%d)\n",
-		crop_width, crop_height, crop_xoffset, crop_yoffset);
-	    put24(header.data+14, crop_width);
-	    put24(header.data+17, crop_height);
-	    header.data[20] = crop_xoffset;
-	    header.data[21] = full_height - crop_height - crop_yoffset;
-	    /* Put these back so the origin is correct for the next image,
-	       whatever its encoded dimensions. */
-	    if (crop_xorigin == '-')
-	      crop_xoffset = full_width - crop_width - crop_xoffset;
-	    if (crop_yorigin == '-')
-	      crop_yoffset = full_height - crop_height - crop_yoffset;
-	  }
-	  if (aspect_set) {
-	    fprintf(stdout, "Setting aspect ratio to %d:%d\n",
+    if (rogg_theora_edit(p, s.st_size, &opts, &arena, &result) < 0) {
+	fprintf(stderr, "couldn't allocate stream list\n");
+	exit(1);
+    }
+    for (j = 0; j < result.count; j++) {
+      st = &result.streams[j];
+      print_theora_info(stdout, &st->before);
+      if (st->bad_crop)
+	fprintf(stderr, "Crop window is not within encoded window.\n");
+      else if (crop_set)
+	fprintf(stdout, "Setting crop region to %dx%d at (%d,%d)\n",
+		st->after.width, st->after.height, st->after.x, st->after.y);
+      if (aspect_set)
+	fprintf(stdout, "Setting aspect ratio to %d:%d\n",
 		aspect_num, aspect_den);
-	    put24(header.data+30, aspect_num); /* numerator */
-	    put24(header.data+33, aspect_den); /* denominator */
-	  }
-	  if (fps_set) {
-	    fprintf(stdout, "Setting frame rate to %d:%d\n",
-		fps_num, fps_den);
-	    put32(header.data+22, fps_num); /* numerator */
-	    put32(header.data+26, fps_den); /* denominator */
-	  }
-	  if (aspect_set || fps_set || crop_set) {
-	    rogg_page_update_crc(q);
-	    fprintf(stdout, "New settings:\n");
-	    print_theora_info(stdout, header.data);
-	  }
-        }
-	q += header.length;
+      if (fps_set)
+	fprintf(stdout, "Setting frame rate to %d:%d\n", fps_num, fps_den);
+      if (st->changed) {
+	fprintf(stdout, "New settings:\n");
+	print_theora_info(stdout, &st->after);
       }
+      if (seek_set) seek_report(p, s.st_size, st->offset);
     }
+    rogg_arena_reset(&arena);
     munmap(p, s.st_size);
     close(f);
   }
+  rogg_arena_clear(&arena);
+  if (show_counters) rogg_counters_report(stderr);
   return 0;
 }
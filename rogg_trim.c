@@ -0,0 +1,393 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* sample accurate trimming of Opus and Vorbis files using the rogg library */
+
+/* compile with
+   gcc -O2 -g -Wall -I. -o rogg_trim rogg.c rogg_codec.c rogg_writer.c \
+	rogg_trim.c -lm
+*/
+
+/* Nothing is decoded: the output starts on a page boundary early
+   enough for the decoder to settle, and the exact start and end are
+   expressed through the stream's own trimming rules. For Opus that's
+   the pre-skip in the identification header plus granule positions
+   rebased to the first kept page. Vorbis has no pre-skip, so granule
+   positions are rebased to the start time itself, and the first page
+   ending before it isn't representable. Both end on a page whose
+   granule position is cut back to the end time, with eos set. Header
+   pages are copied as they are, and the other kept pages are
+   renumbered with their bodies written straight from the mapping. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <math.h>
+
+#include <rogg.h>
+
+/* decoder convergence before the start, as recommended for opus */
+#define OPUS_PREROLL 3840
+
+int show_counters = 0;
+int verbose = 0;
+double start = 0;
+double end = -1;
+
+/* a data page of the stream */
+typedef struct {
+  unsigned char *page;
+  int64_t base;			/* granulepos of the data before it */
+  int64_t granulepos;
+  int continued;
+} data_page;
+
+void print_usage(FILE *out, char *name)
+{
+  fprintf(out, "Cut an Ogg Opus or Vorbis file without decoding it.\n");
+  fprintf(out, "%s [-v] [-s start] [-e end] <in.ogg> <out.ogg>\n", name);
+  fprintf(out, "    -s start    seconds into the stream to start at\n"
+		  "    -e end      seconds into the stream to stop at\n"
+		  "    -v          print where the cuts were made\n"
+		  "    -S          print library counters on exit\n");
+}
+
+int parse_args(int *argc, char *argv[])
+{
+  int arg = 1;
+  int shift;
+
+  while (arg < *argc) {
+    shift = 0;
+    if (argv[arg][0] == '-') {
+      switch (argv[arg][1]) {
+	case 'S':
+	  show_counters = 1;
+	  shift = 1;
+	  break;
+	case 'v':
+	  verbose = 1;
+	  shift = 1;
+	  break;
+	case 's':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 || sscanf(argv[arg+1], "%lf", &start) != 1 ||
+		start < 0) {
+	    fprintf(stderr, "Option -s requires a start time in seconds.\n");
+	    exit(1);
+	  }
+	  break;
+	case 'e':
+	  shift = 2;
+	  if (*argc - arg - shift < 0 || sscanf(argv[arg+1], "%lf", &end) != 1 ||
+		end < 0) {
+	    fprintf(stderr, "Option -e requires an end time in seconds.\n");
+	    exit(1);
+	  }
+	  break;
+      }
+    }
+    if (shift) {
+      int left = *argc - arg - shift;
+      if (left < 0) {
+	fprintf(stderr, "Internal error parsing argument '%s'.\n", argv[arg]);
+	exit(1);
+      }
+      memmove(&argv[arg], &argv[arg+shift], left*sizeof(*argv));
+      *argc -= shift;
+    } else {
+      arg++;
+    }
+  }
+
+  return 0;
+}
+
+/* find the header pages and list the data pages of the only stream
+   in the file. Returns the number of data pages, or -1. */
+int scan_pages(unsigned char *p, unsigned char *e, rogg_stream_info *info,
+	unsigned char **data_start, data_page **pages)
+{
+  rogg_page_header header;
+  unsigned char *q;
+  int headers = 0, count = 0, room = 0;
+  int64_t base = 0;
+  data_page *d;
+
+  *pages = NULL;
+  q = rogg_page_find(p, e, &header);
+  if (q == NULL || rogg_stream_info_init(info, &header) < 0 ||
+	(info->codec->id != ROGG_CODEC_OPUS &&
+	 info->codec->id != ROGG_CODEC_VORBIS)) {
+    fprintf(stderr, "not an Ogg Opus or Vorbis file\n");
+    return -1;
+  }
+  *data_start = NULL;
+  while (q != NULL) {
+    if (header.serialno != info->serialno || header.bos != (q == p)) {
+      fprintf(stderr, "only files with a single stream can be trimmed\n");
+      goto fail;
+    }
+    if (headers < info->headers) {
+      headers += rogg_page_packets_ending(&header);
+      /* the last header packet has to finish its page */
+      if (headers > info->headers || (headers == info->headers &&
+		header.lacing[header.segments - 1] == 255)) {
+	fprintf(stderr, "data packets share a page with the headers\n");
+	goto fail;
+      }
+    } else {
+      if (*data_start == NULL) *data_start = q;
+      if (count == room) {
+	room = room * 2 + 256;
+	d = realloc(*pages, room * sizeof(*d));
+	if (d == NULL) goto fail;
+	*pages = d;
+      }
+      d = &(*pages)[count++];
+      d->page = q;
+      d->base = base;
+      d->granulepos = (int64_t)header.granulepos;
+      d->continued = header.continued;
+      if (d->granulepos != -1) base = d->granulepos;
+    }
+    q = rogg_page_find(q + header.length, e, &header);
+  }
+  if (!count) {
+    fprintf(stderr, "no audio data\n");
+    goto fail;
+  }
+
+  return count;
+
+fail:
+  free(*pages);
+  *pages = NULL;
+  return -1;
+}
+
+/* pick the page to start on: the last one starting a packet early
+   enough, keeping within what pre-skip can express for opus */
+int find_first(data_page *pages, int count, int64_t target, int64_t preroll,
+	int opus)
+{
+  int i, best = -1, fallback = -1;
+
+  for (i = 0; i < count; i++) {
+    if (pages[i].continued) continue;
+    if (pages[i].base > target) break;
+    if (opus && target - pages[i].base > 65535) continue;
+    fallback = i;
+    if (pages[i].base <= target - preroll) best = i;
+  }
+  if (best < 0 && fallback >= 0) {
+    /* nothing to miss if we're starting from the very beginning */
+    if (fallback > 0)
+      fprintf(stderr, "warning: less than %d samples of pre-roll\n",
+	(int)preroll);
+    best = fallback;
+  }
+
+  return best;
+}
+
+int main(int argc, char *argv[])
+{
+  int f, o, i, first, last, count, opus;
+  unsigned char *p, *e, *data_start, *bos = NULL;
+  struct stat s, os;
+  rogg_stream_info info;
+  rogg_page_header header;
+  rogg_writer w;
+  data_page *pages;
+  int64_t preskip, target, stop, origin, preroll;
+  uint32_t sequenceno;
+  int ret = 1;
+
+  parse_args(&argc, argv);
+  if (argc != 3) {
+    print_usage(stderr, argv[0]);
+    exit(1);
+  }
+  if (end >= 0 && end <= start) {
+    fprintf(stderr, "the end has to be after the start\n");
+    exit(1);
+  }
+
+  f = open(argv[1], O_RDONLY);
+  if (f < 0) {
+    fprintf(stderr, "couldn't open '%s'\n", argv[1]);
+    exit(1);
+  }
+  if (fstat(f, &s) < 0 || s.st_size == 0) {
+    fprintf(stderr, "couldn't stat '%s'\n", argv[1]);
+    close(f);
+    exit(1);
+  }
+  p = mmap(0, s.st_size, PROT_READ, MAP_SHARED, f, 0);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "couldn't mmap '%s'\n", argv[1]);
+    close(f);
+    exit(1);
+  }
+  e = p + s.st_size;
+  /* a leading bos page makes the page walk simpler */
+  p = rogg_page_find(p, e, &header);
+  if (p == NULL) {
+    fprintf(stderr, "couldn't find ogg data in '%s'\n", argv[1]);
+    goto unmap;
+  }
+
+  count = scan_pages(p, e, &info, &data_start, &pages);
+  if (count < 0) goto unmap;
+  opus = info.codec->id == ROGG_CODEC_OPUS;
+
+  /* start and end in granule units */
+  preskip = info.preskip;
+  target = (int64_t)llround(start * info.rate_num / info.rate_den) + preskip;
+  if (opus) {
+    preroll = OPUS_PREROLL;
+  } else {
+    /* the first packet only primes the overlap: allow a long block */
+    rogg_page_parse(p, &header);
+    preroll = (int64_t)1 << (header.data[28] >> 4);
+  }
+  last = count - 1;
+  while (last > 0 && pages[last].granulepos == -1) last--;
+  stop = pages[last].granulepos;
+  if (end >= 0) {
+    int64_t want = (int64_t)llround(end * info.rate_num / info.rate_den) +
+	preskip;
+    if (want < stop) {
+      stop = want;
+      for (last = 0; last < count; last++) {
+	if (pages[last].granulepos != -1 && pages[last].granulepos >= stop) break;
+      }
+    }
+  }
+  if (target >= stop) {
+    fprintf(stderr, "nothing to keep between %.3lf and %.3lf seconds\n",
+	start, end);
+    goto free;
+  }
+
+  first = find_first(pages, last + 1, target, preroll, opus);
+  if (first < 0) {
+    fprintf(stderr, "no page to start from before %.3lf seconds\n", start);
+    goto free;
+  }
+  if (opus) {
+    origin = pages[first].base;
+  } else {
+    int64_t granulepos = -1;
+    for (i = first; i <= last && granulepos == -1; i++)
+      granulepos = pages[i].granulepos;
+    origin = target;
+    if (granulepos < target) {
+      /* the first page would need a negative granulepos */
+      fprintf(stderr, "warning: starting %lld samples early\n",
+	(long long)(target - granulepos));
+      origin = granulepos;
+    }
+  }
+  if (verbose) {
+    fprintf(stdout, "keeping pages %d to %d of %d, %lld samples of pre-roll\n",
+	first, last, count, (long long)(target - pages[first].base));
+    fprintf(stdout, "granulepos %lld to %lld rebased by %lld\n",
+	(long long)target, (long long)stop, (long long)origin);
+  }
+
+  o = open(argv[2], O_WRONLY|O_CREAT, 0644);
+  if (o < 0) {
+    fprintf(stderr, "couldn't open '%s'\n", argv[2]);
+    goto free;
+  }
+  if (fstat(o, &os) < 0 || (os.st_dev == s.st_dev && os.st_ino == s.st_ino)) {
+    fprintf(stderr, "can't write '%s' over the input\n", argv[2]);
+    close(o);
+    goto free;
+  }
+  if (ftruncate(o, 0) < 0) {
+    fprintf(stderr, "couldn't truncate '%s'\n", argv[2]);
+    close(o);
+    goto free;
+  }
+  rogg_writer_init(&w, o);
+
+  /* the header pages, with the new pre-skip for opus */
+  if (opus) {
+    rogg_page_parse(p, &header);
+    bos = malloc(header.length);
+    if (bos == NULL) goto close;
+    memcpy(bos, p, header.length);
+    rogg_write_uint16(bos + (header.data - p) + 10, target - origin);
+    rogg_page_update_crc(bos);
+    if (rogg_writer_data(&w, bos, header.length)) goto close;
+    if (rogg_writer_data(&w, p + header.length,
+	data_start - p - header.length)) goto close;
+  } else {
+    if (rogg_writer_data(&w, p, data_start - p)) goto close;
+  }
+  rogg_page_parse(pages[0].page, &header);
+  sequenceno = header.sequenceno;
+
+  for (i = first; i <= last; i++) {
+    rogg_page_parse(pages[i].page, &header);
+    header.sequenceno = sequenceno++;
+    if (pages[i].granulepos != -1)
+      header.granulepos = pages[i].granulepos - origin;
+    header.flags &= ~0x04;
+    if (i == last) {
+      /* trim the end, and finish the stream here */
+      header.granulepos = stop - origin;
+      header.flags |= 0x04;
+    }
+    if (rogg_writer_page(&w, &header)) goto close;
+  }
+  if (rogg_writer_flush(&w)) goto close;
+  ret = 0;
+
+close:
+  if (ret) fprintf(stderr, "couldn't write '%s'\n", argv[2]);
+  close(o);
+  free(bos);
+free:
+  free(pages);
+unmap:
+  munmap(e - s.st_size, s.st_size);
+  close(f);
+  if (show_counters) rogg_counters_report(stderr);
+  return ret;
+}
@@ -0,0 +1,206 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* batched page output for the rogg utilities */
+
+/* Tools which copy pages from a mapped file with a few header fields
+   changed only need to rewrite the header; the body goes out straight
+   from the mapping. Headers are rebuilt in the writer's own buffer, the
+   crc is continued over the original body, and both are queued as
+   separate pieces so a run of pages costs one writev(). Long runs of
+   untouched data are copied between files with copy_file_range(),
+   which lets the filesystem share extents where it can. */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "rogg.h"
+
+void rogg_writer_init(rogg_writer *w, int fd)
+{
+  w->fd = fd;
+  w->offset = 0;
+  w->count = 0;
+  w->pages = 0;
+}
+
+/* make room for n more pieces */
+static int writer_room(rogg_writer *w, int n)
+{
+  if (w->count + n > 2*ROGG_WRITER_PAGES || w->pages >= ROGG_WRITER_PAGES)
+    return rogg_writer_flush(w);
+  return 0;
+}
+
+int rogg_writer_page(rogg_writer *w, rogg_page_header *header)
+{
+  unsigned char *out;
+  int hlen = ROGG_OFFSET_LACING + header->segments;
+  long blen = header->length - hlen;
+  uint32_t crc;
+
+  if (writer_room(w, 2)) return -1;
+  out = w->headers[w->pages++];
+  memcpy(out, "OggS", 4);
+  out[ROGG_OFFSET_VERSION] = 0;
+  out[ROGG_OFFSET_FLAGS] = header->flags;
+  rogg_write_uint64(out + ROGG_OFFSET_GRANULEPOS, header->granulepos);
+  rogg_write_uint32(out + ROGG_OFFSET_SERIALNO, header->serialno);
+  rogg_write_uint32(out + ROGG_OFFSET_SEQUENCENO, header->sequenceno);
+  rogg_write_uint32(out + ROGG_OFFSET_CRC, 0);
+  out[ROGG_OFFSET_SEGMENTS] = header->segments;
+  memcpy(out + ROGG_OFFSET_LACING, header->lacing, header->segments);
+  crc = rogg_crc_update(0, out, hlen);
+  crc = rogg_crc_update(crc, header->data, blen);
+  rogg_write_uint32(out + ROGG_OFFSET_CRC, crc);
+
+  w->base[w->count] = out;
+  w->len[w->count++] = hlen;
+  if (blen > 0) {
+    w->base[w->count] = header->data;
+    w->len[w->count++] = blen;
+  }
+  w->offset += header->length;
+
+  return 0;
+}
+
+int rogg_writer_data(rogg_writer *w, unsigned char *data, long len)
+{
+  if (len <= 0) return 0;
+  if (w->count && w->base[w->count-1] + w->len[w->count-1] == data) {
+    /* carries on from the last piece, as runs of copied pages do */
+    w->len[w->count-1] += len;
+    w->offset += len;
+    return 0;
+  }
+  if (writer_room(w, 1)) return -1;
+  w->base[w->count] = data;
+  w->len[w->count++] = len;
+  w->offset += len;
+
+  return 0;
+}
+
+int rogg_writer_packet(rogg_writer *w, unsigned char *data, long len,
+	int flags, int64_t granulepos, uint32_t serialno, uint32_t *sequenceno)
+{
+  rogg_page_header header;
+  unsigned char lacing[255];
+  long total = len / 255 + 1;	/* lacing values for the packet */
+  long done = 0;
+  int i;
+
+  header.serialno = serialno;
+  header.data = data;
+  header.lacing = lacing;
+  while (done < total) {
+    header.segments = total - done > 255 ? 255 : total - done;
+    header.length = ROGG_OFFSET_LACING + header.segments;
+    for (i = 0; i < header.segments; i++) {
+      lacing[i] = (done + i < total - 1) ? 255 : len % 255;
+      header.length += lacing[i];
+    }
+    header.flags = done ? 0x01 : (flags & 0x02);
+    done += header.segments;
+    if (done == total) {
+      /* the packet finishes here */
+      header.flags |= flags & 0x04;
+      header.granulepos = granulepos;
+    } else {
+      header.granulepos = -1;
+    }
+    header.sequenceno = (*sequenceno)++;
+    if (rogg_writer_page(w, &header)) return -1;
+    header.data += header.length - ROGG_OFFSET_LACING - header.segments;
+  }
+
+  return 0;
+}
+
+int rogg_writer_copy(rogg_writer *w, int fd, unsigned char *p,
+	long long offset, long long len)
+{
+  loff_t from = offset;
+  ssize_t ret;
+
+  if (rogg_writer_flush(w)) return -1;
+  w->offset += len;
+  while (len > 0) {
+    ret = copy_file_range(fd, &from, w->fd, NULL, len, 0);
+    if (ret <= 0) break;
+    len -= ret;
+  }
+  if (len > 0) {
+    /* fall back to writing from the mapping */
+    w->offset -= len;
+    if (rogg_writer_data(w, p + from, len)) return -1;
+    return rogg_writer_flush(w);
+  }
+
+  return 0;
+}
+
+int rogg_writer_flush(rogg_writer *w)
+{
+  struct iovec iov[2*ROGG_WRITER_PAGES];
+  int i, first = 0;
+  ssize_t ret;
+
+  for (i = 0; i < w->count; i++) {
+    iov[i].iov_base = w->base[i];
+    iov[i].iov_len = w->len[i];
+  }
+  while (first < w->count) {
+    ret = writev(w->fd, iov + first, w->count - first);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    /* skip whatever was written, allowing for partial pieces */
+    while (first < w->count && (size_t)ret >= iov[first].iov_len) {
+      ret -= iov[first++].iov_len;
+    }
+    if (first < w->count) {
+      iov[first].iov_base = (char *)iov[first].iov_base + ret;
+      iov[first].iov_len -= ret;
+    }
+  }
+  w->count = 0;
+  w->pages = 0;
+
+  return 0;
+}
@@ -0,0 +1,139 @@
+/*
+   Copyright (C) 2026 Xiph.org Foundation
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions
+   are met:
+
+   - Redistributions of source code must retain the above copyright
+   notice, this list of conditions and the following disclaimer.
+
+   - Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+   PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE ORGANISATION OR
+   CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+   EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+   PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/* regression check for renumbering chained streams in place */
+
+/* A chain whose second link uses the serial the first link is given
+   must still end up with one serial per link, and every page counted
+   once. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rogg.h"
+
+#define LINK_PAGES 5
+#define BODY 10
+
+/* write a page holding one small packet, returning its length */
+static int make_page(unsigned char *p, uint32_t serialno,
+	uint32_t sequenceno, unsigned char flags, uint64_t granulepos)
+{
+  memset(p, 0, ROGG_OFFSET_LACING + 1 + BODY);
+  memcpy(p, "OggS", 4);
+  p[ROGG_OFFSET_FLAGS] = flags;
+  rogg_write_uint64(p + ROGG_OFFSET_GRANULEPOS, granulepos);
+  rogg_write_uint32(p + ROGG_OFFSET_SERIALNO, serialno);
+  rogg_write_uint32(p + ROGG_OFFSET_SEQUENCENO, sequenceno);
+  p[ROGG_OFFSET_SEGMENTS] = 1;
+  p[ROGG_OFFSET_LACING] = BODY;
+  memset(p + ROGG_OFFSET_LACING + 1, 0x55, BODY);
+  rogg_page_update_crc(p);
+
+  return ROGG_OFFSET_LACING + 1 + BODY;
+}
+
+/* two links, each a stream of LINK_PAGES pages */
+static long make_chain(unsigned char *p, uint32_t first, uint32_t second)
+{
+  uint32_t serials[2] = { first, second };
+  long len = 0;
+  int i, j;
+
+  for (i = 0; i < 2; i++) {
+    for (j = 0; j < LINK_PAGES; j++) {
+      len += make_page(p + len, serials[i], j,
+	j == 0 ? 0x02 : j == LINK_PAGES - 1 ? 0x04 : 0, j);
+    }
+  }
+
+  return len;
+}
+
+static int check_chain(const char *name, int mode, uint32_t first,
+	uint32_t second, int threads)
+{
+  unsigned char buf[2 * LINK_PAGES * (ROGG_OFFSET_LACING + 1 + BODY)];
+  rogg_serial_options opts;
+  rogg_serial_result result;
+  rogg_page_header header;
+  rogg_arena arena;
+  uint32_t serials[2];
+  unsigned char *q, *e;
+  long len = make_chain(buf, first, second);
+  int n = 0, failed = 0;
+
+  memset(&opts, 0, sizeof(opts));
+  opts.mode = mode;
+  opts.first = 1;
+  opts.seed = 12345;
+  opts.threads = threads;
+  rogg_arena_init(&arena, 0);
+  if (rogg_serial_remap(buf, len, &opts, &arena, &result) < 0) {
+    fprintf(stderr, "%s: remap failed\n", name);
+    rogg_arena_clear(&arena);
+    return 1;
+  }
+
+  e = buf + len;
+  for (q = buf; (q = rogg_page_find(q, e, &header)) != NULL;
+	q += header.length) {
+    if (n % LINK_PAGES == 0) serials[n / LINK_PAGES] = header.serialno;
+    else if (header.serialno != serials[n / LINK_PAGES]) failed = 1;
+    n++;
+  }
+  if (n != 2 * LINK_PAGES || failed || serials[0] == serials[1]) {
+    fprintf(stderr, "%s: links don't have a serial each\n", name);
+    failed = 1;
+  }
+  if (result.pages != 2 * LINK_PAGES ||
+	result.changed > result.pages || result.count != 2 ||
+	result.assigned[0].new_serial != serials[0] ||
+	result.assigned[1].new_serial != serials[1]) {
+    fprintf(stderr, "%s: reported %ld of %ld pages changed, %d streams\n",
+	name, result.changed, result.pages, result.count);
+    failed = 1;
+  }
+  rogg_arena_clear(&arena);
+
+  return failed;
+}
+
+int main(int argc, char *argv[])
+{
+  int failed = 0;
+
+  /* -n 1 gives the first link the second link's old serial */
+  failed |= check_chain("sequential", ROGG_SERIAL_SEQUENTIAL, 0x64, 0x1, 1);
+  failed |= check_chain("sequential, threaded", ROGG_SERIAL_SEQUENTIAL,
+	0x64, 0x1, 4);
+  failed |= check_chain("random", ROGG_SERIAL_RANDOM, 0x64, 0x1, 1);
+
+  return failed;
+}